@@ -0,0 +1,105 @@
+#include "adaptive_execution.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <map>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    // Лучший из нескольких повторов: калибровку не должны искажать случайные паузы
+    template <typename Function>
+    double MeasureBestNs(int repetitions, Function function) {
+        double best = numeric_limits<double>::max();
+        for (int i = 0; i < repetitions; ++i) {
+            const auto start = chrono::steady_clock::now();
+            function();
+            best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+}
+
+AdaptiveExecutionPolicy::AdaptiveExecutionPolicy(size_t max_parallelism)
+    : AdaptiveExecutionPolicy(Calibrate(), max_parallelism) {
+}
+
+AdaptiveExecutionPolicy::AdaptiveExecutionPolicy(const Calibration& calibration, size_t max_parallelism)
+    : calibration_(calibration)
+    , max_parallelism_(max(max_parallelism, size_t{ 1 })) {
+}
+
+AdaptiveExecutionPolicy::Calibration AdaptiveExecutionPolicy::Calibrate() {
+    static constexpr int REPETITIONS = 5;
+    Calibration calibration;
+
+    // Постинг — шаг по std::map документов с накоплением вклада в плотный массив, как при обходе по словам
+    static constexpr int POSTING_COUNT = 1 << 15;
+    map<int, double> postings;
+    for (int i = 0; i < POSTING_COUNT; ++i) {
+        postings.emplace(i * 3, 1.0 / (i + 1));
+    }
+    vector<double> relevances(POSTING_COUNT * 3);
+    const double postings_ns = MeasureBestNs(REPETITIONS, [&] {
+        for (const auto [document_id, term_freq] : postings) {
+            relevances[document_id] += term_freq * 1.5;
+        }
+        });
+    calibration.nanoseconds_per_cost_unit = postings_ns / POSTING_COUNT;
+
+    // Части запускаются так же, как при параллельном обходе: std::async и ожидание всех
+    static constexpr int TASK_COUNT = 4;
+    const double tasks_ns = MeasureBestNs(REPETITIONS, [] {
+        vector<future<int>> futures;
+        for (int i = 0; i < TASK_COUNT; ++i) {
+            futures.push_back(async([i] { return i; }));
+        }
+        for (auto& task : futures) {
+            task.get();
+        }
+        });
+    calibration.task_overhead_ns = tasks_ns / TASK_COUNT;
+
+    // не даём компилятору выбросить обход
+    volatile double sink = relevances[3];
+    static_cast<void>(sink);
+    return calibration;
+}
+
+AdaptiveExecutionPolicy::Lease::Lease(atomic<size_t>& active_queries, size_t parallelism)
+    : active_queries_(active_queries)
+    , parallelism_(parallelism) {
+}
+
+AdaptiveExecutionPolicy::Lease::~Lease() {
+    active_queries_.fetch_sub(1, memory_order_relaxed);
+}
+
+AdaptiveExecutionPolicy::Lease AdaptiveExecutionPolicy::Acquire(double estimated_cost) const {
+    const size_t active_queries = active_queries_.fetch_add(1, memory_order_relaxed) + 1;
+    const size_t share = max(max_parallelism_ / active_queries, size_t{ 1 });
+    return Lease(active_queries_, min(ChooseParallelism(estimated_cost), share));
+}
+
+size_t AdaptiveExecutionPolicy::ChooseParallelism(double estimated_cost) const {
+    const double parts = sqrt(estimated_cost * calibration_.nanoseconds_per_cost_unit / calibration_.task_overhead_ns);
+    // Сравнение ложно и для NaN
+    if (!(parts >= 2.0)) {
+        return 1;
+    }
+    return parts >= max_parallelism_ ? max_parallelism_ : static_cast<size_t>(parts);
+}
+
+const AdaptiveExecutionPolicy& AdaptiveExecutionPolicy::Default() {
+    static const AdaptiveExecutionPolicy policy;
+    return policy;
+}
+
+size_t AdaptiveExecutionPolicy::GetHardwareParallelism() {
+    return max(thread::hardware_concurrency(), 1u);
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Политика выполнения FindTopDocuments, выбирающая параллельность для каждого запроса по оценке его
+// стоимости из плана. Число частей k минимизирует work / k + task_overhead · k, где work — стоимость
+// запроса в наносекундах, так что короткие запросы выполняются в вызывающем потоке. Потоки делятся
+// между запросами, выполняемыми через политику одновременно. Один экземпляр можно делить между потоками
+class AdaptiveExecutionPolicy {
+public:
+    struct Calibration {
+        // Время условной операции над постингом, в которых план оценивает стоимость
+        double nanoseconds_per_cost_unit = 2.0;
+        // Запуск и ожидание одной параллельной части
+        double task_overhead_ns = 20000.0;
+    };
+
+    // Калибрует пороги встроенным микробенчмарком (несколько миллисекунд)
+    explicit AdaptiveExecutionPolicy(size_t max_parallelism = GetHardwareParallelism());
+    explicit AdaptiveExecutionPolicy(const Calibration& calibration, size_t max_parallelism = GetHardwareParallelism());
+
+    static Calibration Calibrate();
+
+    // Доля потоков, выделенная запросу; пока она жива, запрос учитывается в нагрузке
+    class Lease {
+    public:
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease();
+
+        // 1 — выполнять в вызывающем потоке
+        size_t GetParallelism() const {
+            return parallelism_;
+        }
+
+    private:
+        friend class AdaptiveExecutionPolicy;
+
+        Lease(std::atomic<size_t>& active_queries, size_t parallelism);
+
+        std::atomic<size_t>& active_queries_;
+        size_t parallelism_;
+    };
+
+    Lease Acquire(double estimated_cost) const;
+
+    // Параллельность для запроса с такой стоимостью на свободной машине
+    size_t ChooseParallelism(double estimated_cost) const;
+
+    const Calibration& GetCalibration() const {
+        return calibration_;
+    }
+
+    // Общий экземпляр, калибруется при первом обращении
+    static const AdaptiveExecutionPolicy& Default();
+
+private:
+    static size_t GetHardwareParallelism();
+
+    const Calibration calibration_;
+    const size_t max_parallelism_;
+    mutable std::atomic<size_t> active_queries_ = 0;
+};
@@ -0,0 +1,410 @@
+#include "search_server.h"
+#include "process_queries.h"
+#include "remove_duplicates.h"
+#include "generators.h"
+
+#include <sys/resource.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Подсчёт выделений памяти: глобальные operator new/delete заменены только в этом бинарнике, все формы
+// сразу — иначе часть выделений прошла бы мимо счётчиков, а пары new/delete из разных распределителей
+// не совпали бы. Всё выделяется через malloc/aligned_alloc и освобождается free
+namespace {
+    atomic<size_t> allocation_count{ 0 };
+    atomic<size_t> allocated_bytes{ 0 };
+
+    void* CountedAllocate(size_t size, size_t alignment) noexcept {
+        allocation_count.fetch_add(1, memory_order_relaxed);
+        allocated_bytes.fetch_add(size, memory_order_relaxed);
+        if (size == 0) {
+            size = 1;
+        }
+        if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return malloc(size);
+        }
+        // aligned_alloc требует размер, кратный выравниванию
+        return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+    }
+
+    void* CountedAllocateOrThrow(size_t size, size_t alignment) {
+        if (void* ptr = CountedAllocate(size, alignment)) {
+            return ptr;
+        }
+        throw bad_alloc();
+    }
+}
+
+void* operator new(size_t size) {
+    return CountedAllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](size_t size) {
+    return CountedAllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    return CountedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+    return CountedAllocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+    return CountedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+    return CountedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void* operator new(size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment, const nothrow_t&) noexcept {
+    return CountedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t, align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, size_t, align_val_t) noexcept {
+    free(ptr);
+}
+
+void operator delete(void* ptr, align_val_t, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t, const nothrow_t&) noexcept {
+    free(ptr);
+}
+
+namespace {
+
+struct BenchmarkConfig {
+    int document_count;
+    int dictionary_size;
+    int query_word_count;
+    double minus_word_ratio;
+};
+
+struct Measurement {
+    string operation;
+    string policy;
+    BenchmarkConfig config;
+    size_t operations = 0;
+    int64_t total_ns = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+    long peak_rss_kb = 0;
+};
+
+constexpr int DOCUMENT_WORD_COUNT = 70;
+constexpr int QUERY_COUNT = 100;
+constexpr int MAX_WORD_LENGTH = 10;
+
+long PeakRssKb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+class Probe {
+public:
+    Probe()
+        : allocations_(allocation_count.load())
+        , bytes_(allocated_bytes.load())
+        , start_(chrono::steady_clock::now()) {
+    }
+
+    void Finish(Measurement& measurement, size_t operations) const {
+        const auto end = chrono::steady_clock::now();
+        measurement.operations = operations;
+        measurement.total_ns = chrono::duration_cast<chrono::nanoseconds>(end - start_).count();
+        measurement.allocations = allocation_count.load() - allocations_;
+        measurement.bytes = allocated_bytes.load() - bytes_;
+        measurement.peak_rss_kb = PeakRssKb();
+    }
+
+private:
+    size_t allocations_;
+    size_t bytes_;
+    chrono::steady_clock::time_point start_;
+};
+
+struct Corpus {
+    vector<string> dictionary;
+    vector<string> documents;
+    vector<string> queries;
+};
+
+Corpus MakeCorpus(uint32_t seed, const BenchmarkConfig& config) {
+    mt19937 generator(seed);
+    Corpus corpus;
+    corpus.dictionary = GenerateDictionary(generator, config.dictionary_size, MAX_WORD_LENGTH);
+    corpus.documents = GenerateQueries(generator, corpus.dictionary, config.document_count, DOCUMENT_WORD_COUNT);
+    corpus.queries = GenerateQueries(generator, corpus.dictionary, QUERY_COUNT, config.query_word_count, config.minus_word_ratio);
+    return corpus;
+}
+
+void FillServer(SearchServer& search_server, const Corpus& corpus) {
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        search_server.AddDocument(i, corpus.documents[i], DocumentStatus::ACTUAL, { 1, 2, 3 });
+    }
+}
+
+Measurement MakeMeasurement(string operation, string policy, const BenchmarkConfig& config) {
+    Measurement measurement;
+    measurement.operation = move(operation);
+    measurement.policy = move(policy);
+    measurement.config = config;
+    return measurement;
+}
+
+template <typename ExecutionPolicy>
+Measurement BenchFindTopDocuments(const SearchServer& search_server, const Corpus& corpus, const BenchmarkConfig& config,
+    string policy_name, ExecutionPolicy& policy) {
+    auto measurement = MakeMeasurement("FindTopDocuments", move(policy_name), config);
+    double total_relevance = 0;
+    Probe probe;
+    for (const string& query : corpus.queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    probe.Finish(measurement, corpus.queries.size());
+    // не даём компилятору выбросить вычисления
+    if (total_relevance < 0) {
+        cerr << total_relevance << endl;
+    }
+    return measurement;
+}
+
+Measurement BenchFindTopDocumentsWithContext(const SearchServer& search_server, const Corpus& corpus, const BenchmarkConfig& config) {
+    auto measurement = MakeMeasurement("FindTopDocuments", "context", config);
+    SearchServer::QueryContext context;
+    Document results[MAX_RESULT_DOCUMENT_COUNT];
+    // прогрев: буферы контекста дорастают до ёмкости самого тяжёлого запроса
+    for (const string& query : corpus.queries) {
+        search_server.FindTopDocuments(context, query, results);
+    }
+    double total_relevance = 0;
+    Probe probe;
+    for (const string& query : corpus.queries) {
+        const Document* end = search_server.FindTopDocuments(context, query, results);
+        for (const Document* document = results; document != end; ++document) {
+            total_relevance += document->relevance;
+        }
+    }
+    probe.Finish(measurement, corpus.queries.size());
+    if (total_relevance < 0) {
+        cerr << total_relevance << endl;
+    }
+    return measurement;
+}
+
+template <typename ExecutionPolicy>
+Measurement BenchMatchDocument(const SearchServer& search_server, const Corpus& corpus, const BenchmarkConfig& config,
+    string policy_name, const ExecutionPolicy& policy) {
+    auto measurement = MakeMeasurement("MatchDocument", move(policy_name), config);
+    size_t matched = 0;
+    Probe probe;
+    for (size_t i = 0; i < corpus.queries.size(); ++i) {
+        const auto [words, status] = search_server.MatchDocument(policy, corpus.queries[i], static_cast<int>(i % corpus.documents.size()));
+        matched += words.size();
+    }
+    probe.Finish(measurement, corpus.queries.size());
+    if (matched == static_cast<size_t>(-1)) {
+        cerr << matched << endl;
+    }
+    return measurement;
+}
+
+template <typename RemoveFunction>
+Measurement BenchRemoveDocument(const Corpus& corpus, const BenchmarkConfig& config, string policy_name, RemoveFunction remove) {
+    auto measurement = MakeMeasurement("RemoveDocument", move(policy_name), config);
+    SearchServer search_server(corpus.dictionary[0]);
+    FillServer(search_server, corpus);
+    Probe probe;
+    for (size_t i = 0; i < corpus.documents.size(); ++i) {
+        remove(search_server, static_cast<int>(i));
+    }
+    probe.Finish(measurement, corpus.documents.size());
+    return measurement;
+}
+
+vector<Measurement> RunConfig(uint32_t seed, const BenchmarkConfig& config) {
+    const Corpus corpus = MakeCorpus(seed, config);
+    vector<Measurement> results;
+
+    {
+        auto measurement = MakeMeasurement("AddDocument", "seq", config);
+        SearchServer search_server(corpus.dictionary[0]);
+        Probe probe;
+        FillServer(search_server, corpus);
+        probe.Finish(measurement, corpus.documents.size());
+        results.push_back(measurement);
+    }
+
+    SearchServer search_server(corpus.dictionary[0]);
+    FillServer(search_server, corpus);
+
+    results.push_back(BenchFindTopDocuments(search_server, corpus, config, "seq", execution::seq));
+    results.push_back(BenchFindTopDocuments(search_server, corpus, config, "par", execution::par));
+    results.push_back(BenchFindTopDocuments(search_server, corpus, config, "auto", AdaptiveExecutionPolicy::Default()));
+    results.push_back(BenchFindTopDocumentsWithContext(search_server, corpus, config));
+    results.push_back(BenchMatchDocument(search_server, corpus, config, "seq", execution::seq));
+    results.push_back(BenchMatchDocument(search_server, corpus, config, "par", execution::par));
+
+    {
+        auto measurement = MakeMeasurement("ProcessQueries", "par", config);
+        Probe probe;
+        const auto documents = ProcessQueries(search_server, corpus.queries);
+        probe.Finish(measurement, corpus.queries.size());
+        results.push_back(measurement);
+    }
+
+    results.push_back(BenchRemoveDocument(corpus, config, "seq",
+        [](SearchServer& server, int document_id) { server.RemoveDocument(document_id); }));
+    results.push_back(BenchRemoveDocument(corpus, config, "par",
+        [](SearchServer& server, int document_id) { server.RemoveDocument(execution::par, document_id); }));
+
+    {
+        auto measurement = MakeMeasurement("RemoveDuplicates", "seq", config);
+        SearchServer duplicates_server(corpus.dictionary[0]);
+        FillServer(duplicates_server, corpus);
+        // RemoveDuplicates печатает найденные дубликаты, а stdout занят JSON-отчётом
+        ostringstream sink;
+        auto* old_buffer = cout.rdbuf(sink.rdbuf());
+        Probe probe;
+        RemoveDuplicates(duplicates_server);
+        probe.Finish(measurement, corpus.documents.size());
+        cout.rdbuf(old_buffer);
+        results.push_back(measurement);
+    }
+
+    return results;
+}
+
+void PrintJson(ostream& out, uint32_t seed, const vector<Measurement>& results) {
+    out << "{\n  \"benchmark\": \"search_server\",\n  \"seed\": " << seed << ",\n  \"results\": [";
+    bool first = true;
+    for (const auto& m : results) {
+        const double ns_per_op = m.operations ? static_cast<double>(m.total_ns) / m.operations : 0.0;
+        const double ops_per_second = m.total_ns ? m.operations * 1e9 / m.total_ns : 0.0;
+        out << (first ? "\n" : ",\n");
+        first = false;
+        out << "    {\"operation\": \"" << m.operation << "\""
+            << ", \"policy\": \"" << m.policy << "\""
+            << ", \"document_count\": " << m.config.document_count
+            << ", \"dictionary_size\": " << m.config.dictionary_size
+            << ", \"query_word_count\": " << m.config.query_word_count
+            << ", \"minus_word_ratio\": " << m.config.minus_word_ratio
+            << ", \"operations\": " << m.operations
+            << ", \"total_ns\": " << m.total_ns
+            << ", \"ns_per_op\": " << ns_per_op
+            << ", \"ops_per_second\": " << ops_per_second
+            << ", \"allocations_per_op\": " << (m.operations ? static_cast<double>(m.allocations) / m.operations : 0.0)
+            << ", \"allocated_bytes_per_op\": " << (m.operations ? static_cast<double>(m.bytes) / m.operations : 0.0)
+            << ", \"peak_rss_kb\": " << m.peak_rss_kb << "}";
+    }
+    out << "\n  ]\n}" << endl;
+}
+
+vector<BenchmarkConfig> MakeSweep(bool quick) {
+    const vector<int> document_counts = quick ? vector<int>{ 1'000 } : vector<int>{ 1'000, 10'000 };
+    const vector<int> dictionary_sizes = quick ? vector<int>{ 1'000 } : vector<int>{ 1'000, 10'000 };
+    const vector<int> query_word_counts = quick ? vector<int>{ 10 } : vector<int>{ 3, 10, 70 };
+    const vector<double> minus_ratios = quick ? vector<double>{ 0.1 } : vector<double>{ 0.0, 0.3 };
+
+    vector<BenchmarkConfig> sweep;
+    for (int document_count : document_counts) {
+        for (int dictionary_size : dictionary_sizes) {
+            for (int query_word_count : query_word_counts) {
+                for (double minus_ratio : minus_ratios) {
+                    sweep.push_back({ document_count, dictionary_size, query_word_count, minus_ratio });
+                }
+            }
+        }
+    }
+    return sweep;
+}
+
+} // namespace
+
+// Использование: search_server_benchmark [--quick] [--seed N]
+int main(int argc, char* argv[]) {
+    bool quick = false;
+    uint32_t seed = 5489;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        }
+        else if (arg == "--seed" && i + 1 < argc) {
+            seed = static_cast<uint32_t>(stoul(argv[++i]));
+        }
+        else {
+            cerr << "Usage: " << argv[0] << " [--quick] [--seed N]" << endl;
+            return 1;
+        }
+    }
+
+    vector<Measurement> results;
+    for (const auto& config : MakeSweep(quick)) {
+        for (auto& measurement : RunConfig(seed, config)) {
+            results.push_back(move(measurement));
+        }
+    }
+    PrintJson(cout, seed, results);
+#ifdef SEARCH_SERVER_STATS
+    cerr << SearchServer::GetStats();
+#endif
+}
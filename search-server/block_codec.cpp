@@ -0,0 +1,109 @@
+#include "block_codec.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+namespace {
+    constexpr size_t MIN_MATCH = 4;
+    constexpr size_t MAX_OFFSET = 65535;
+    constexpr int HASH_BITS = 14;
+
+    void AppendVarint(pmr::vector<uint8_t>& out, size_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    size_t ReadVarint(const uint8_t*& data) {
+        size_t value = 0;
+        for (int shift = 0;; shift += 7) {
+            const uint8_t byte = *data++;
+            value |= static_cast<size_t>(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    void AppendLiterals(pmr::vector<uint8_t>& out, string_view literals) {
+        AppendVarint(out, literals.size());
+        out.insert(out.end(), literals.begin(), literals.end());
+    }
+
+    // Короткие литералы и совпадения копируются кусками по WILD_COPY байт с запасом в конце буфера
+    constexpr size_t WILD_COPY = 16;
+}
+
+void CompressBlock(string_view input, pmr::vector<uint8_t>& out) {
+    vector<uint32_t> table(size_t{ 1 } << HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + MIN_MATCH <= input.size()) {
+        uint32_t sequence;
+        memcpy(&sequence, input.data() + position, sizeof(sequence));
+        const uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+        const uint32_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(position);
+        if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET
+            || memcmp(input.data() + candidate, input.data() + position, MIN_MATCH) != 0) {
+            ++position;
+            continue;
+        }
+        size_t length = MIN_MATCH;
+        while (position + length < input.size() && input[candidate + length] == input[position + length]) {
+            ++length;
+        }
+        AppendLiterals(out, input.substr(anchor, position - anchor));
+        AppendVarint(out, length - MIN_MATCH);
+        const size_t offset = position - candidate;
+        out.push_back(static_cast<uint8_t>(offset));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        position += length;
+        anchor = position;
+    }
+    AppendLiterals(out, input.substr(anchor));
+    out.shrink_to_fit();
+}
+
+string DecompressBlock(const pmr::vector<uint8_t>& data, size_t size) {
+    string result(size + WILD_COPY, '\0');
+    char* out = result.data();
+    const uint8_t* it = data.data();
+    const uint8_t* const end = it + data.size();
+    while (it != end) {
+        const size_t literal_length = ReadVarint(it);
+        if (literal_length <= WILD_COPY && end - it >= static_cast<ptrdiff_t>(WILD_COPY)) {
+            memcpy(out, it, WILD_COPY);
+        }
+        else {
+            memcpy(out, it, literal_length);
+        }
+        out += literal_length;
+        it += literal_length;
+        if (it == end) {
+            break;
+        }
+        const size_t match_length = ReadVarint(it) + MIN_MATCH;
+        const size_t offset = it[0] | (static_cast<size_t>(it[1]) << 8);
+        it += 2;
+        const char* from = out - offset;
+        if (offset >= WILD_COPY) {
+            for (size_t copied = 0; copied < match_length; copied += WILD_COPY) {
+                memcpy(out + copied, from + copied, WILD_COPY);
+            }
+        }
+        else {
+            // Совпадение перекрывается с самим собой: копируем побайтно
+            for (size_t i = 0; i < match_length; ++i) {
+                out[i] = from[i];
+            }
+        }
+        out += match_length;
+    }
+    result.resize(size);
+    return result;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// LZ-кодек блоков текста без внешних зависимостей. Формат: последовательность (varint длины литералов,
+// литералы, varint длины совпадения минус 4, 16-битное смещение назад). После последних литералов
+// совпадения нет
+void CompressBlock(std::string_view input, std::pmr::vector<uint8_t>& out);
+
+// size — длина исходного текста
+std::string DecompressBlock(const std::pmr::vector<uint8_t>& data, size_t size);
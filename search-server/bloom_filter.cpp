@@ -0,0 +1,47 @@
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+namespace {
+    uint64_t Remix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xFF51AFD7ED558CCDull;
+        value ^= value >> 33;
+        return value;
+    }
+}
+
+BloomFilter::BloomFilter(size_t capacity)
+    : blocks_(max<size_t>(1, (capacity * BITS_PER_KEY + 511) / 512))
+    , capacity_(capacity) {
+}
+
+size_t BloomFilter::GetBlockIndex(uint64_t hash) const {
+    // Старшие биты хеша выбирают блок, младшие после перемешивания — биты внутри блока
+    return static_cast<size_t>((static_cast<unsigned __int128>(hash) * blocks_.size()) >> 64);
+}
+
+void BloomFilter::Insert(string_view key) {
+    const uint64_t hash = std::hash<string_view>{}(key);
+    auto& block = blocks_[GetBlockIndex(hash)];
+    uint64_t bits = Remix(hash);
+    for (int probe = 0; probe < PROBE_COUNT; ++probe, bits >>= 9) {
+        block.words[(bits >> 6) & 7] |= uint64_t{ 1 } << (bits & 63);
+    }
+    ++size_;
+}
+
+bool BloomFilter::MayContain(string_view key) const {
+    const uint64_t hash = std::hash<string_view>{}(key);
+    const auto& block = blocks_[GetBlockIndex(hash)];
+    uint64_t bits = Remix(hash);
+    for (int probe = 0; probe < PROBE_COUNT; ++probe, bits >>= 9) {
+        if ((block.words[(bits >> 6) & 7] & (uint64_t{ 1 } << (bits & 63))) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Блочный фильтр Блума: все биты ключа лежат в одной кэш-линии, так что проверка — одно
+// обращение к памяти. Ложноположительные ответы возможны (около процента при BITS_PER_KEY),
+// ложноотрицательные — нет. Удалять ключи нельзя
+class BloomFilter {
+public:
+    explicit BloomFilter(size_t capacity = 0);
+
+    void Insert(std::string_view key);
+    bool MayContain(std::string_view key) const;
+
+    // Сколько ключей можно вставить, прежде чем доля ложных срабатываний начнёт расти
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    size_t GetMemoryUsage() const {
+        return blocks_.size() * sizeof(Block);
+    }
+
+private:
+    static constexpr size_t BITS_PER_KEY = 10;
+    static constexpr int PROBE_COUNT = 7;
+
+    struct alignas(64) Block {
+        std::array<uint64_t, 8> words{};
+    };
+
+    size_t GetBlockIndex(uint64_t hash) const;
+
+    std::vector<Block> blocks_;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+};
@@ -1,6 +1,8 @@
 #pragma once
 #include <iostream>
 
+const double ERROR_RATE_RELEVANCE = 1e-6;
+
 struct Document{
     Document() = default;
 
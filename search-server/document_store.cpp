@@ -0,0 +1,140 @@
+#include "document_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "block_codec.h"
+
+using namespace std;
+
+DocumentStore::DocumentStore(size_t cache_blocks, pmr::memory_resource* resource)
+    : resource_(resource)
+    , cache_blocks_(cache_blocks)
+    , blocks_(resource)
+    , locations_(resource)
+    , open_block_(resource) {
+}
+
+void DocumentStore::Add(int document_id, string_view text) {
+    locations_[document_id] = { open_block_id_, static_cast<uint32_t>(open_block_.size()), static_cast<uint32_t>(text.size()) };
+    open_block_.append(text);
+    open_live_bytes_ += static_cast<uint32_t>(text.size());
+    text_size_ += text.size();
+    if (open_block_.size() >= BLOCK_SIZE) {
+        SealOpenBlock();
+    }
+}
+
+void DocumentStore::SealOpenBlock() {
+    Block block{ pmr::vector<uint8_t>(resource_), static_cast<uint32_t>(open_block_.size()), open_live_bytes_ };
+    CompressBlock(open_block_, block.data);
+    blocks_.emplace(open_block_id_++, move(block));
+    open_block_.clear();
+    open_block_.shrink_to_fit();
+    open_live_bytes_ = 0;
+}
+
+void DocumentStore::Remove(int document_id) {
+    const auto it = locations_.find(document_id);
+    if (it == locations_.end()) {
+        return;
+    }
+    const Location location = it->second;
+    locations_.erase(it);
+    text_size_ -= location.length;
+    if (location.block == open_block_id_) {
+        open_live_bytes_ -= location.length;
+        if (open_live_bytes_ == 0) {
+            open_block_.clear();
+        }
+        return;
+    }
+    auto& block = blocks_.at(location.block);
+    block.live_bytes -= location.length;
+    if (block.live_bytes == 0) {
+        EraseBlock(location.block);
+    }
+}
+
+void DocumentStore::EraseBlock(uint32_t block_id) {
+    blocks_.erase(block_id);
+    lock_guard guard(cache_mutex_);
+    cache_.erase(remove_if(cache_.begin(), cache_.end(), [block_id](const CachedBlock& cached) {
+        return cached.first == block_id;
+    }), cache_.end());
+}
+
+shared_ptr<const string> DocumentStore::GetBlock(uint32_t block_id) const {
+    {
+        lock_guard guard(cache_mutex_);
+        const auto it = find_if(cache_.begin(), cache_.end(), [block_id](const CachedBlock& cached) {
+            return cached.first == block_id;
+        });
+        if (it != cache_.end()) {
+            rotate(cache_.begin(), it, it + 1);
+            return cache_.front().second;
+        }
+    }
+    // Распаковываем без блокировки: один блок могут распаковать два потока сразу, это не страшно
+    const auto& block = blocks_.at(block_id);
+    auto text = make_shared<const string>(DecompressBlock(block.data, block.size));
+    if (cache_blocks_ != 0) {
+        lock_guard guard(cache_mutex_);
+        cache_.insert(cache_.begin(), { block_id, text });
+        if (cache_.size() > cache_blocks_) {
+            cache_.pop_back();
+        }
+    }
+    return text;
+}
+
+string DocumentStore::Get(int document_id) const {
+    const auto it = locations_.find(document_id);
+    if (it == locations_.end()) {
+        throw out_of_range("There is no such id");
+    }
+    const Location location = it->second;
+    if (location.block == open_block_id_) {
+        return string(open_block_.substr(location.offset, location.length));
+    }
+    return GetBlock(location.block)->substr(location.offset, location.length);
+}
+
+void DocumentStore::Compact() {
+    vector<uint32_t> sparse_blocks;
+    for (const auto& [block_id, block] : blocks_) {
+        if (block.live_bytes * 2 < block.size) {
+            sparse_blocks.push_back(block_id);
+        }
+    }
+    if (sparse_blocks.empty()) {
+        return;
+    }
+    // Документы переносятся в открытый блок в порядке их смещений, так что соседство текстов сохраняется
+    vector<pair<Location, int>> moved;
+    for (const auto& [document_id, location] : locations_) {
+        if (binary_search(sparse_blocks.begin(), sparse_blocks.end(), location.block)) {
+            moved.push_back({ location, document_id });
+        }
+    }
+    sort(moved.begin(), moved.end(), [](const auto& lhs, const auto& rhs) {
+        return make_pair(lhs.first.block, lhs.first.offset) < make_pair(rhs.first.block, rhs.first.offset);
+    });
+    for (const auto& [location, document_id] : moved) {
+        const string text = GetBlock(location.block)->substr(location.offset, location.length);
+        text_size_ -= text.size();
+        Add(document_id, text);
+    }
+    for (const uint32_t block_id : sparse_blocks) {
+        EraseBlock(block_id);
+    }
+}
+
+size_t DocumentStore::GetCacheMemoryUsage() const {
+    lock_guard guard(cache_mutex_);
+    size_t result = 0;
+    for (const auto& [block_id, text] : cache_) {
+        result += text->capacity();
+    }
+    return result;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Тексты документов, сжатые блоками. Новые документы дописываются в открытый блок; заполненный блок
+// сжимается LZ-кодеком без внешних зависимостей и дальше хранится только в сжатом виде.
+// Последние прочитанные блоки держатся распакованными в небольшом кеше
+class DocumentStore {
+public:
+    explicit DocumentStore(size_t cache_blocks, std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    void Add(int document_id, std::string_view text);
+    void Remove(int document_id);
+
+    // Может вызываться из нескольких потоков одновременно; out_of_range, если документа нет
+    std::string Get(int document_id) const;
+
+    // Переупаковывает блоки, в которых удалённые документы занимают больше половины
+    void Compact();
+
+    size_t GetCacheMemoryUsage() const;
+
+    // Суммарная длина хранимых текстов до сжатия
+    size_t GetTextSize() const {
+        return text_size_;
+    }
+
+private:
+    static constexpr size_t BLOCK_SIZE = 32 * 1024;
+
+    struct Location {
+        uint32_t block;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct Block {
+        std::pmr::vector<uint8_t> data;
+        uint32_t size;
+        uint32_t live_bytes;
+    };
+
+    using CachedBlock = std::pair<uint32_t, std::shared_ptr<const std::string>>;
+
+    void SealOpenBlock();
+    void EraseBlock(uint32_t block_id);
+    std::shared_ptr<const std::string> GetBlock(uint32_t block_id) const;
+
+    std::pmr::memory_resource* resource_;
+    const size_t cache_blocks_;
+    std::pmr::map<uint32_t, Block> blocks_;
+    std::pmr::unordered_map<int, Location> locations_;
+    std::pmr::string open_block_;
+    uint32_t open_block_id_ = 0;
+    uint32_t open_live_bytes_ = 0;
+    size_t text_size_ = 0;
+
+    mutable std::mutex cache_mutex_;
+    // В порядке последнего обращения, свежие в начале
+    mutable std::vector<CachedBlock> cache_;
+};
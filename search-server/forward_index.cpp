@@ -0,0 +1,57 @@
+#include "forward_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+ForwardIndex::ForwardIndex(pmr::memory_resource* resource)
+    : entries_(resource)
+    , documents_(resource) {
+}
+
+void ForwardIndex::AddDocument(int document_id, const vector<Entry>& entries, uint32_t word_count) {
+    documents_[document_id] = { entries_.size(), static_cast<uint32_t>(entries.size()), word_count };
+    entries_.insert(entries_.end(), entries.begin(), entries.end());
+}
+
+void ForwardIndex::RemoveDocument(int document_id) {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return;
+    }
+    dead_entries_ += it->second.size;
+    documents_.erase(it);
+    if (dead_entries_ * 2 > entries_.size()) {
+        Compact();
+    }
+}
+
+ForwardIndex::Terms ForwardIndex::GetTerms(int document_id) const {
+    const auto it = documents_.find(document_id);
+    if (it == documents_.end()) {
+        return {};
+    }
+    const Entry* begin = entries_.data() + it->second.offset;
+    return { begin, begin + it->second.size, it->second.word_count };
+}
+
+void ForwardIndex::Compact() {
+    // Переносим документы в порядке их смещений: соседние в массиве документы остаются соседями
+    vector<Range*> ranges;
+    ranges.reserve(documents_.size());
+    for (auto& [document_id, range] : documents_) {
+        ranges.push_back(&range);
+    }
+    sort(ranges.begin(), ranges.end(), [](const Range* lhs, const Range* rhs) {
+        return lhs->offset < rhs->offset;
+    });
+    size_t offset = 0;
+    for (Range* range : ranges) {
+        copy(entries_.begin() + range->offset, entries_.begin() + range->offset + range->size, entries_.begin() + offset);
+        range->offset = offset;
+        offset += range->size;
+    }
+    entries_.resize(offset);
+    entries_.shrink_to_fit();
+    dead_entries_ = 0;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <memory_resource>
+#include <unordered_map>
+#include <vector>
+
+// Прямой индекс: термины каждого документа — отсортированный по id термина непрерывный кусок
+// общего массива пар (термин, число вхождений). Место удалённых документов переиспользуется
+// при уплотнении, которое запускается, когда мёртвых записей становится больше живых
+class ForwardIndex {
+public:
+    struct Entry {
+        uint32_t term_id;
+        uint32_t count;
+    };
+
+    // Термины одного документа; действительны до следующего изменения индекса
+    class Terms {
+    public:
+        Terms() = default;
+        Terms(const Entry* begin, const Entry* end, uint32_t word_count)
+            : begin_(begin)
+            , end_(end)
+            , word_count_(word_count) {
+        }
+
+        const Entry* begin() const {
+            return begin_;
+        }
+
+        const Entry* end() const {
+            return end_;
+        }
+
+        size_t size() const {
+            return end_ - begin_;
+        }
+
+        bool empty() const {
+            return begin_ == end_;
+        }
+
+        // Число слов документа без стоп-слов, с повторами
+        uint32_t GetWordCount() const {
+            return word_count_;
+        }
+
+    private:
+        const Entry* begin_ = nullptr;
+        const Entry* end_ = nullptr;
+        uint32_t word_count_ = 0;
+    };
+
+    explicit ForwardIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
+    // entries отсортированы по term_id и не повторяются
+    void AddDocument(int document_id, const std::vector<Entry>& entries, uint32_t word_count);
+    void RemoveDocument(int document_id);
+
+    // Пусто, если документа нет
+    Terms GetTerms(int document_id) const;
+
+private:
+    struct Range {
+        size_t offset;
+        uint32_t size;
+        uint32_t word_count;
+    };
+
+    void Compact();
+
+    std::pmr::vector<Entry> entries_;
+    std::pmr::unordered_map<int, Range> documents_;
+    size_t dead_entries_ = 0;
+};
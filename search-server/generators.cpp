@@ -0,0 +1,111 @@
+#include "generators.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+string GenerateWord(mt19937& generator, int max_length) {
+    const int length = uniform_int_distribution(1, max_length)(generator);
+    string word;
+    word.reserve(length);
+    for (int i = 0; i < length; ++i) {
+        word.push_back(uniform_int_distribution('a', 'z')(generator));
+    }
+    return word;
+}
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back(GenerateWord(generator, max_length));
+    }
+    words.erase(unique(words.begin(), words.end()), words.end());
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (!query.empty()) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+vector<string> GenerateQueries(mt19937& generator, const vector<string>& dictionary, int query_count, int max_word_count, double minus_prob) {
+    vector<string> queries;
+    queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, max_word_count, minus_prob));
+    }
+    return queries;
+}
+
+ZipfDistribution::ZipfDistribution(size_t n, double skew) {
+    if (n == 0) {
+        throw invalid_argument("Zipf distribution needs at least one value");
+    }
+    cumulative_weights_.reserve(n);
+    double total = 0.0;
+    for (size_t k = 0; k < n; ++k) {
+        total += 1.0 / pow(k + 1.0, skew);
+        cumulative_weights_.push_back(total);
+    }
+}
+
+size_t ZipfDistribution::operator()(mt19937& generator) const {
+    const double point = uniform_real_distribution<>(0, cumulative_weights_.back())(generator);
+    const auto it = upper_bound(cumulative_weights_.begin(), cumulative_weights_.end(), point);
+    return min<size_t>(it - cumulative_weights_.begin(), cumulative_weights_.size() - 1);
+}
+
+string GenerateZipfText(mt19937& generator, const vector<string>& dictionary, const ZipfDistribution& word_distribution,
+    int word_count, double minus_prob) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (!text.empty()) {
+            text.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        text += dictionary[word_distribution(generator)];
+    }
+    return text;
+}
+
+Workload GenerateZipfWorkload(mt19937& generator, const ZipfWorkloadOptions& options) {
+    if (options.query_length_weights.empty()) {
+        throw invalid_argument("Query length mix is empty");
+    }
+    Workload workload;
+    workload.dictionary = GenerateDictionary(generator, options.dictionary_size, options.max_word_length);
+    const ZipfDistribution word_distribution(workload.dictionary.size(), options.word_skew);
+
+    workload.documents.reserve(options.document_count);
+    for (int i = 0; i < options.document_count; ++i) {
+        workload.documents.push_back(GenerateZipfText(generator, workload.dictionary, word_distribution, options.document_word_count));
+    }
+
+    discrete_distribution<int> length_distribution(options.query_length_weights.begin(), options.query_length_weights.end());
+    vector<string> distinct_queries;
+    distinct_queries.reserve(options.distinct_query_count);
+    for (int i = 0; i < options.distinct_query_count; ++i) {
+        const int word_count = length_distribution(generator) + 1;
+        distinct_queries.push_back(GenerateZipfText(generator, workload.dictionary, word_distribution, word_count, options.minus_prob));
+    }
+    const ZipfDistribution query_distribution(distinct_queries.size(), options.query_skew);
+    workload.queries.reserve(options.query_count);
+    for (int i = 0; i < options.query_count; ++i) {
+        workload.queries.push_back(distinct_queries[query_distribution(generator)]);
+    }
+    return workload;
+}
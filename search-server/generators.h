@@ -0,0 +1,52 @@
+#pragma once
+
+#include <random>
+#include <string>
+#include <vector>
+
+std::string GenerateWord(std::mt19937& generator, int max_length);
+
+std::vector<std::string> GenerateDictionary(std::mt19937& generator, int word_count, int max_length);
+
+std::string GenerateQuery(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count, double minus_prob = 0);
+
+std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vector<std::string>& dictionary, int query_count, int max_word_count, double minus_prob = 0);
+
+// Номера 0..n-1 с вероятностью, пропорциональной 1 / (k + 1)^skew: несколько частых слов и длинный
+// хвост редких, как в живых текстах, или горячие запросы журнала. skew = 0 — равномерное распределение
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t n, double skew);
+
+    size_t operator()(std::mt19937& generator) const;
+
+private:
+    std::vector<double> cumulative_weights_;
+};
+
+// Слова текста выбираются из словаря по word_distribution; первые слова словаря — самые частые
+std::string GenerateZipfText(std::mt19937& generator, const std::vector<std::string>& dictionary, const ZipfDistribution& word_distribution,
+    int word_count, double minus_prob = 0);
+
+struct ZipfWorkloadOptions {
+    int dictionary_size = 10'000;
+    int max_word_length = 10;
+    double word_skew = 1.0;
+    int document_count = 10'000;
+    int document_word_count = 70;
+    // Журнал из query_count запросов выбирается из distinct_query_count разных с перекосом query_skew
+    int distinct_query_count = 1'000;
+    int query_count = 10'000;
+    double query_skew = 1.0;
+    double minus_prob = 0.1;
+    // Доли запросов из 1, 2, 3... слов
+    std::vector<double> query_length_weights{ 0.3, 0.35, 0.2, 0.1, 0.05 };
+};
+
+struct Workload {
+    std::vector<std::string> dictionary;
+    std::vector<std::string> documents;
+    std::vector<std::string> queries;
+};
+
+Workload GenerateZipfWorkload(std::mt19937& generator, const ZipfWorkloadOptions& options);
@@ -0,0 +1,45 @@
+#include "impact_index.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+int ImpactIndex::Quantize(double term_freq) {
+    const double level = floor(-log2(term_freq) * LEVELS_PER_OCTAVE);
+    return static_cast<int>(clamp(level, 0.0, static_cast<double>(MAX_LEVEL)));
+}
+
+double ImpactIndex::GetUpperBound(int level) {
+    return exp2(-static_cast<double>(level) / LEVELS_PER_OCTAVE);
+}
+
+void ImpactIndex::AddPosting(string_view word, int document_id, double term_freq) {
+    const int level = Quantize(term_freq);
+    auto& block = word_to_blocks_[word][level];
+    block.max_term_freq = GetUpperBound(level);
+    block.postings[document_id] = term_freq;
+}
+
+void ImpactIndex::RemovePosting(string_view word, int document_id, double term_freq) {
+    const auto word_it = word_to_blocks_.find(word);
+    if (word_it == word_to_blocks_.end()) {
+        return;
+    }
+    const auto block_it = word_it->second.find(Quantize(term_freq));
+    if (block_it == word_it->second.end()) {
+        return;
+    }
+    block_it->second.postings.erase(document_id);
+    if (block_it->second.postings.empty()) {
+        word_it->second.erase(block_it);
+    }
+    if (word_it->second.empty()) {
+        word_to_blocks_.erase(word_it);
+    }
+}
+
+const ImpactIndex::BlockList* ImpactIndex::GetBlocks(string_view word) const {
+    const auto it = word_to_blocks_.find(word);
+    return it == word_to_blocks_.end() ? nullptr : &it->second;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <memory_resource>
+#include <string_view>
+
+// Постинги слов, дополнительно сгруппированные в блоки по квантованной частоте слова в документе.
+// IDF у всех постингов слова общий, поэтому блоки в порядке убывания TF идут и в порядке
+// убывания вклада TF-IDF
+class ImpactIndex {
+public:
+    struct Block {
+        // Постинги блока выделяются из ресурса индекса
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        explicit Block(const allocator_type& allocator = {})
+            : postings(allocator) {
+        }
+
+        Block(const Block& other, const allocator_type& allocator)
+            : max_term_freq(other.max_term_freq)
+            , postings(other.postings, allocator) {
+        }
+
+        Block(Block&& other, const allocator_type& allocator)
+            : max_term_freq(other.max_term_freq)
+            , postings(std::move(other.postings), allocator) {
+        }
+
+        // Верхняя граница TF постингов блока
+        double max_term_freq = 0.0;
+        std::pmr::map<int, double> postings;
+    };
+
+    // Ключ — уровень квантования: чем он меньше, тем больше TF
+    using BlockList = std::pmr::map<int, Block>;
+
+    explicit ImpactIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : word_to_blocks_(resource) {
+    }
+
+    void AddPosting(std::string_view word, int document_id, double term_freq);
+    // term_freq должен совпадать с переданным в AddPosting: по нему находится блок
+    void RemovePosting(std::string_view word, int document_id, double term_freq);
+
+    // nullptr, если слова нет
+    const BlockList* GetBlocks(std::string_view word) const;
+
+private:
+    // Уровни делят каждую октаву TF на LEVELS_PER_OCTAVE частей
+    static constexpr int LEVELS_PER_OCTAVE = 4;
+    static constexpr int MAX_LEVEL = 63;
+
+    static int Quantize(double term_freq);
+    static double GetUpperBound(int level);
+
+    std::pmr::map<std::string_view, BlockList> word_to_blocks_;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <memory_resource>
+
+#include "memory_tracking.h"
+#include "search_server.h"
+
+// Арена для индекса, который строится один раз и выбрасывается целиком, как при blue/green-замене;
+// передаётся в IndexOptions::memory_resource. Узлы индекса нарезаются подряд из крупных блоков,
+// освобождение узла ничего не делает, а блоки возвращаются системе разом вместе с ареной: деструктор
+// сервера только обходит контейнеры, без free на каждый узел. Память удалённых документов не
+// переиспользуется, так что индексу с частыми удалениями лучше подойдёт std::pmr::synchronized_pool_resource.
+// Выделять память из арены можно из одного потока за раз — изменения сервера и так исключают друг друга
+class IndexArena : public std::pmr::memory_resource {
+public:
+    explicit IndexArena(size_t initial_block_size = 1 << 20)
+        : arena_(initial_block_size, &blocks_) {
+    }
+
+    // Сколько байт арена взяла у системы и сколькими блоками
+    size_t GetReservedBytes() const {
+        return blocks_.GetAllocatedBytes();
+    }
+
+    size_t GetBlockCount() const {
+        return blocks_.GetAllocationCount();
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        return arena_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* /*p*/, size_t /*bytes*/, size_t /*alignment*/) override {
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    TrackingMemoryResource blocks_;
+    std::pmr::monotonic_buffer_resource arena_;
+};
+
+// Сервер вместе с собственной ареной: арена живёт, пока жив сервер, и освобождается сразу после него
+template <typename StringContainer>
+std::shared_ptr<SearchServer> MakeArenaSearchServer(const StringContainer& stop_words, IndexOptions options = {},
+    size_t initial_block_size = 1 << 20) {
+    struct ArenaServer {
+        ArenaServer(const StringContainer& stop_words, IndexOptions options, size_t initial_block_size)
+            : arena(initial_block_size)
+            , server(stop_words, WithResource(options, &arena)) {
+        }
+
+        static IndexOptions WithResource(IndexOptions options, std::pmr::memory_resource* resource) {
+            options.memory_resource = resource;
+            return options;
+        }
+
+        IndexArena arena;
+        SearchServer server;
+    };
+    auto holder = std::make_shared<ArenaServer>(stop_words, std::move(options), initial_block_size);
+    return std::shared_ptr<SearchServer>(holder, &holder->server);
+}
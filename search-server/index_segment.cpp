@@ -0,0 +1,188 @@
+#include "index_segment.h"
+
+#include <algorithm>
+#include <tuple>
+
+using namespace std;
+
+void MutableSegment::AddDocument(const SegmentDocument& document) {
+    DocumentData data{ document.rating, document.status, {} };
+    for (const auto& [word, term_freq] : document.word_freqs) {
+        auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
+            it = word_to_document_freqs_.emplace(string(word), map<int, double>{}).first;
+        }
+        it->second[document.id] += term_freq;
+        data.words.push_back(it->first);
+    }
+    documents_[document.id] = move(data);
+}
+
+bool MutableSegment::RemoveDocument(int document_id) {
+    const auto document_it = documents_.find(document_id);
+    if (document_it == documents_.end()) {
+        return false;
+    }
+    for (const string_view word : document_it->second.words) {
+        const auto word_it = word_to_document_freqs_.find(word);
+        if (word_it == word_to_document_freqs_.end()) {
+            continue;
+        }
+        word_it->second.erase(document_id);
+        if (word_it->second.empty()) {
+            word_to_document_freqs_.erase(word_it);
+        }
+    }
+    documents_.erase(document_it);
+    return true;
+}
+
+size_t MutableSegment::GetDocumentFreq(string_view word) const {
+    const auto it = word_to_document_freqs_.find(word);
+    return it == word_to_document_freqs_.end() ? 0 : it->second.size();
+}
+
+vector<SegmentDocument> MutableSegment::GetLiveDocuments() const {
+    vector<SegmentDocument> result;
+    result.reserve(documents_.size());
+    for (const auto& [document_id, data] : documents_) {
+        SegmentDocument document{ document_id, data.rating, data.status, {} };
+        for (const string_view word : data.words) {
+            document.word_freqs.push_back({ word, word_to_document_freqs_.find(word)->second.at(document_id) });
+        }
+        result.push_back(move(document));
+    }
+    return result;
+}
+
+FrozenSegment::FrozenSegment(vector<SegmentDocument> documents) {
+    sort(documents.begin(), documents.end(), [](const auto& lhs, const auto& rhs) { return lhs.id < rhs.id; });
+
+    // (слово, номер документа в сегменте, TF), отсортированные по слову, затем по документу
+    vector<tuple<string_view, uint32_t, double>> postings;
+    for (uint32_t i = 0; i < documents.size(); ++i) {
+        for (const auto& [word, term_freq] : documents[i].word_freqs) {
+            postings.emplace_back(word, i, term_freq);
+        }
+    }
+    sort(postings.begin(), postings.end());
+
+    posting_documents_.reserve(postings.size());
+    posting_freqs_.reserve(postings.size());
+    for (size_t i = 0; i < postings.size(); ++i) {
+        const auto& [word, document, term_freq] = postings[i];
+        if (i == 0 || word != get<0>(postings[i - 1])) {
+            term_offsets_.push_back(static_cast<uint32_t>(term_data_.size()));
+            term_data_.append(word);
+            posting_offsets_.push_back(static_cast<uint32_t>(posting_documents_.size()));
+        }
+        posting_documents_.push_back(document);
+        posting_freqs_.push_back(term_freq);
+    }
+    term_offsets_.push_back(static_cast<uint32_t>(term_data_.size()));
+    posting_offsets_.push_back(static_cast<uint32_t>(posting_documents_.size()));
+
+    const size_t term_count = term_offsets_.size() - 1;
+    live_document_freqs_.resize(term_count);
+    vector<vector<uint32_t>> terms_by_document(documents.size());
+    for (size_t term = 0; term < term_count; ++term) {
+        live_document_freqs_[term] = posting_offsets_[term + 1] - posting_offsets_[term];
+        for (uint32_t i = posting_offsets_[term]; i < posting_offsets_[term + 1]; ++i) {
+            terms_by_document[posting_documents_[i]].push_back(static_cast<uint32_t>(term));
+        }
+    }
+
+    for (size_t i = 0; i < documents.size(); ++i) {
+        document_ids_.push_back(documents[i].id);
+        ratings_.push_back(documents[i].rating);
+        statuses_.push_back(documents[i].status);
+        document_term_offsets_.push_back(static_cast<uint32_t>(document_terms_.size()));
+        document_terms_.insert(document_terms_.end(), terms_by_document[i].begin(), terms_by_document[i].end());
+    }
+    document_term_offsets_.push_back(static_cast<uint32_t>(document_terms_.size()));
+
+    deleted_ = make_unique<atomic<bool>[]>(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        deleted_[i].store(false, memory_order_relaxed);
+    }
+    live_document_count_ = documents.size();
+}
+
+string_view FrozenSegment::GetTerm(size_t term) const {
+    return string_view(term_data_).substr(term_offsets_[term], term_offsets_[term + 1] - term_offsets_[term]);
+}
+
+size_t FrozenSegment::FindTerm(string_view word) const {
+    size_t low = 0;
+    size_t high = term_offsets_.size() - 1;
+    while (low < high) {
+        const size_t middle = (low + high) / 2;
+        if (GetTerm(middle) < word) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low < term_offsets_.size() - 1 && GetTerm(low) == word ? low : NO_TERM;
+}
+
+size_t FrozenSegment::FindDocument(int document_id) const {
+    const auto it = lower_bound(document_ids_.begin(), document_ids_.end(), document_id);
+    if (it == document_ids_.end() || *it != document_id) {
+        return NO_TERM;
+    }
+    return it - document_ids_.begin();
+}
+
+bool FrozenSegment::HasLiveDocument(int document_id) const {
+    const size_t document = FindDocument(document_id);
+    return document != NO_TERM && !deleted_[document].load(memory_order_relaxed);
+}
+
+bool FrozenSegment::RemoveDocument(int document_id) {
+    const size_t document = FindDocument(document_id);
+    if (document == NO_TERM || deleted_[document].load(memory_order_relaxed)) {
+        return false;
+    }
+    deleted_[document].store(true, memory_order_relaxed);
+    for (uint32_t i = document_term_offsets_[document]; i < document_term_offsets_[document + 1]; ++i) {
+        --live_document_freqs_[document_terms_[i]];
+    }
+    --live_document_count_;
+    return true;
+}
+
+size_t FrozenSegment::GetDocumentFreq(string_view word) const {
+    const size_t term = FindTerm(word);
+    return term == NO_TERM ? 0 : live_document_freqs_[term];
+}
+
+vector<SegmentDocument> FrozenSegment::GetLiveDocuments() const {
+    vector<SegmentDocument> result;
+    for (size_t document = 0; document < document_ids_.size(); ++document) {
+        if (deleted_[document].load(memory_order_relaxed)) {
+            continue;
+        }
+        SegmentDocument entry{ document_ids_[document], ratings_[document], statuses_[document], {} };
+        for (uint32_t i = document_term_offsets_[document]; i < document_term_offsets_[document + 1]; ++i) {
+            const uint32_t term = document_terms_[i];
+            const auto postings_begin = posting_documents_.begin() + posting_offsets_[term];
+            const auto postings_end = posting_documents_.begin() + posting_offsets_[term + 1];
+            const auto posting = lower_bound(postings_begin, postings_end, static_cast<uint32_t>(document));
+            entry.word_freqs.push_back({ GetTerm(term), posting_freqs_[posting - posting_documents_.begin()] });
+        }
+        result.push_back(move(entry));
+    }
+    return result;
+}
+
+size_t FrozenSegment::GetMemoryUsage() const {
+    return term_data_.capacity()
+        + (term_offsets_.capacity() + live_document_freqs_.capacity() + posting_offsets_.capacity()
+            + posting_documents_.capacity() + document_term_offsets_.capacity() + document_terms_.capacity()) * sizeof(uint32_t)
+        + posting_freqs_.capacity() * sizeof(double)
+        + (document_ids_.capacity() + ratings_.capacity()) * sizeof(int)
+        + statuses_.capacity() * sizeof(DocumentStatus)
+        + document_ids_.size() * sizeof(atomic<bool>);
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "document.h"
+
+// Документ в виде, общем для всех сегментов: слова с их TF
+struct SegmentDocument {
+    int id = 0;
+    int rating = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<std::pair<std::string_view, double>> word_freqs;
+};
+
+// Изменяемый сегмент в памяти: сюда попадают все новые документы
+class MutableSegment {
+public:
+    void AddDocument(const SegmentDocument& document);
+    bool RemoveDocument(int document_id);
+
+    bool HasDocument(int document_id) const {
+        return documents_.count(document_id) > 0;
+    }
+
+    size_t GetDocumentCount() const {
+        return documents_.size();
+    }
+
+    size_t GetDocumentFreq(std::string_view word) const;
+
+    // callback(document_id, term_freq, status, rating)
+    template <typename Callback>
+    void ForEachPosting(std::string_view word, Callback callback) const {
+        const auto it = word_to_document_freqs_.find(word);
+        if (it == word_to_document_freqs_.end()) {
+            return;
+        }
+        for (const auto [document_id, term_freq] : it->second) {
+            const auto& data = documents_.at(document_id);
+            callback(document_id, term_freq, data.status, data.rating);
+        }
+    }
+
+    std::vector<SegmentDocument> GetLiveDocuments() const;
+
+private:
+    struct DocumentData {
+        int rating;
+        DocumentStatus status;
+        std::vector<std::string_view> words;
+    };
+
+    std::map<std::string, std::map<int, double>, std::less<>> word_to_document_freqs_;
+    std::map<int, DocumentData> documents_;
+};
+
+// Неизменяемый сегмент, оптимизированный для чтения: словарь и постинги лежат в плоских массивах.
+// Меняются только отметки об удалении и зависящие от них счётчики живых документов
+class FrozenSegment {
+public:
+    explicit FrozenSegment(std::vector<SegmentDocument> documents);
+
+    FrozenSegment(const FrozenSegment&) = delete;
+    FrozenSegment& operator=(const FrozenSegment&) = delete;
+
+    bool HasLiveDocument(int document_id) const;
+    bool RemoveDocument(int document_id);
+
+    size_t GetDocumentCount() const {
+        return document_ids_.size();
+    }
+
+    size_t GetLiveDocumentCount() const {
+        return live_document_count_;
+    }
+
+    size_t GetDeletedDocumentCount() const {
+        return document_ids_.size() - live_document_count_;
+    }
+
+    size_t GetDocumentFreq(std::string_view word) const;
+
+    template <typename Callback>
+    void ForEachPosting(std::string_view word, Callback callback) const {
+        const size_t term = FindTerm(word);
+        if (term == NO_TERM) {
+            return;
+        }
+        for (uint32_t i = posting_offsets_[term]; i < posting_offsets_[term + 1]; ++i) {
+            const uint32_t document = posting_documents_[i];
+            if (!deleted_[document].load(std::memory_order_relaxed)) {
+                callback(document_ids_[document], posting_freqs_[i], statuses_[document], ratings_[document]);
+            }
+        }
+    }
+
+    // Безопасно вызывать параллельно с RemoveDocument: отметки об удалении атомарны
+    std::vector<SegmentDocument> GetLiveDocuments() const;
+
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t NO_TERM = static_cast<size_t>(-1);
+
+    size_t FindTerm(std::string_view word) const;
+    std::string_view GetTerm(size_t term) const;
+    size_t FindDocument(int document_id) const;
+
+    std::string term_data_;
+    std::vector<uint32_t> term_offsets_;
+    std::vector<uint32_t> live_document_freqs_;
+
+    std::vector<uint32_t> posting_offsets_;
+    std::vector<uint32_t> posting_documents_;
+    std::vector<double> posting_freqs_;
+
+    std::vector<int> document_ids_;
+    std::vector<int> ratings_;
+    std::vector<DocumentStatus> statuses_;
+    std::vector<uint32_t> document_term_offsets_;
+    std::vector<uint32_t> document_terms_;
+    std::unique_ptr<std::atomic<bool>[]> deleted_;
+    size_t live_document_count_ = 0;
+};
@@ -0,0 +1,255 @@
+#include "ingestion.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+
+#include "bounded_queue.h"
+
+using namespace std;
+
+namespace {
+
+struct Chunk {
+    size_t sequence;
+    string data;
+};
+
+struct ParsedChunk {
+    size_t sequence;
+    vector<SearchServer::PreparedDocument> documents;
+    size_t records = 0;
+    size_t errors = 0;
+};
+
+using ReadFunction = function<size_t(char* buffer, size_t size)>;
+
+DocumentStatus ParseStatus(string_view text) {
+    if (text == "ACTUAL" || text == "0") {
+        return DocumentStatus::ACTUAL;
+    }
+    if (text == "IRRELEVANT" || text == "1") {
+        return DocumentStatus::IRRELEVANT;
+    }
+    if (text == "BANNED" || text == "2") {
+        return DocumentStatus::BANNED;
+    }
+    if (text == "REMOVED" || text == "3") {
+        return DocumentStatus::REMOVED;
+    }
+    throw invalid_argument("Invalid document status");
+}
+
+int ParseInt(string_view text) {
+    size_t parsed = 0;
+    const string value(text);
+    const int result = stoi(value, &parsed);
+    if (parsed != value.size()) {
+        throw invalid_argument("Invalid number");
+    }
+    return result;
+}
+
+string_view NextField(string_view& line) {
+    const size_t tab = line.find('\t');
+    if (tab == line.npos) {
+        throw invalid_argument("Record has too few fields");
+    }
+    const string_view field = line.substr(0, tab);
+    line.remove_prefix(tab + 1);
+    return field;
+}
+
+SearchServer::PreparedDocument ParseRecord(const SearchServer& search_server, string_view line) {
+    const int document_id = ParseInt(NextField(line));
+    const DocumentStatus status = ParseStatus(NextField(line));
+    vector<int> ratings;
+    for (const string_view rating : SplitIntoWords(NextField(line))) {
+        if (!rating.empty()) {
+            ratings.push_back(ParseInt(rating));
+        }
+    }
+    return search_server.PrepareDocument(document_id, string(line), status, ratings);
+}
+
+ParsedChunk ParseChunk(const SearchServer& search_server, Chunk chunk) {
+    ParsedChunk result{ chunk.sequence, {} };
+    string_view data = chunk.data;
+    while (!data.empty()) {
+        const size_t end_of_line = data.find('\n');
+        string_view line = data.substr(0, end_of_line);
+        data.remove_prefix(end_of_line == data.npos ? data.size() : end_of_line + 1);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        ++result.records;
+        try {
+            result.documents.push_back(ParseRecord(search_server, line));
+        }
+        catch (const exception&) {
+            ++result.errors;
+        }
+    }
+    return result;
+}
+
+// Читает блоки по options.chunk_size и режет их по последнему переводу строки,
+// хвост переносится в следующий блок
+void ReadChunks(const ReadFunction& read, const IngestionOptions& options, BoundedQueue<Chunk>& chunks, atomic<size_t>& bytes_read) {
+    string carry;
+    size_t sequence = 0;
+    bool at_end = false;
+    while (!at_end) {
+        string buffer = move(carry);
+        carry.clear();
+        const size_t filled = buffer.size();
+        buffer.resize(filled + options.chunk_size);
+        const size_t count = read(buffer.data() + filled, options.chunk_size);
+        bytes_read += count;
+        buffer.resize(filled + count);
+        at_end = count == 0;
+
+        if (!at_end) {
+            const size_t last_newline = buffer.rfind('\n');
+            if (last_newline == buffer.npos) {
+                carry = move(buffer);
+                continue;
+            }
+            carry.assign(buffer, last_newline + 1, buffer.npos);
+            buffer.resize(last_newline + 1);
+        }
+        if (!buffer.empty() && !chunks.Push({ sequence++, move(buffer) })) {
+            return;
+        }
+    }
+}
+
+IngestionStats RunPipeline(SearchServer& search_server, const ReadFunction& read, const IngestionOptions& options) {
+    if (options.chunk_size == 0 || options.queue_capacity == 0 || options.parser_threads == 0) {
+        throw invalid_argument("Invalid ingestion options");
+    }
+    BoundedQueue<Chunk> chunks(options.queue_capacity);
+    BoundedQueue<ParsedChunk> parsed(options.queue_capacity);
+    atomic<size_t> bytes_read{ 0 };
+    exception_ptr reader_error;
+
+    thread reader([&] {
+        try {
+            ReadChunks(read, options, chunks, bytes_read);
+        }
+        catch (...) {
+            reader_error = current_exception();
+        }
+        chunks.Close();
+        });
+
+    const SearchServer& const_server = search_server;
+    atomic<size_t> active_parsers{ options.parser_threads };
+    vector<thread> parsers;
+    for (size_t i = 0; i < options.parser_threads; ++i) {
+        parsers.emplace_back([&] {
+            while (auto chunk = chunks.Pop()) {
+                if (!parsed.Push(ParseChunk(const_server, move(*chunk)))) {
+                    break;
+                }
+            }
+            if (--active_parsers == 0) {
+                parsed.Close();
+            }
+            });
+    }
+
+    // Индексация в текущем потоке, в исходном порядке записей
+    IngestionStats stats;
+    map<size_t, ParsedChunk> pending;
+    size_t next_sequence = 0;
+    exception_ptr indexer_error;
+    try {
+        while (auto chunk = parsed.Pop()) {
+            pending.emplace(chunk->sequence, move(*chunk));
+            for (auto it = pending.find(next_sequence); it != pending.end(); it = pending.find(++next_sequence)) {
+                stats.records += it->second.records;
+                stats.errors += it->second.errors;
+                for (auto& document : it->second.documents) {
+                    try {
+                        search_server.AddPreparedDocument(move(document));
+                        ++stats.documents_added;
+                    }
+                    catch (const invalid_argument&) {
+                        ++stats.errors;
+                    }
+                }
+                pending.erase(it);
+            }
+        }
+    }
+    catch (...) {
+        indexer_error = current_exception();
+        chunks.Close();
+        parsed.Close();
+    }
+
+    reader.join();
+    for (auto& parser : parsers) {
+        parser.join();
+    }
+    if (indexer_error) {
+        rethrow_exception(indexer_error);
+    }
+    if (reader_error) {
+        rethrow_exception(reader_error);
+    }
+    stats.bytes_read = bytes_read;
+    return stats;
+}
+
+} // namespace
+
+IngestionStats IngestDocuments(SearchServer& search_server, istream& input, const IngestionOptions& options) {
+    return RunPipeline(search_server, [&input](char* buffer, size_t size) {
+        input.read(buffer, size);
+        return static_cast<size_t>(input.gcount());
+        }, options);
+}
+
+IngestionStats IngestFile(SearchServer& search_server, const string& path, const IngestionOptions& options) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Cannot open " + path);
+    }
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    try {
+        auto stats = RunPipeline(search_server, [fd](char* buffer, size_t size) {
+            size_t total = 0;
+            while (total < size) {
+                const ssize_t count = read(fd, buffer + total, size - total);
+                if (count < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw system_error(errno, generic_category(), "Read failed");
+                }
+                if (count == 0) {
+                    break;
+                }
+                total += count;
+            }
+            return total;
+            }, options);
+        close(fd);
+        return stats;
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+
+#include "search_server.h"
+
+// Потоковая загрузка корпуса. Формат записи — строка
+//   id<TAB>status<TAB>ratings<TAB>text
+// где status — ACTUAL/IRRELEVANT/BANNED/REMOVED или его номер, ratings — целые через пробел.
+// Чтение крупными блоками, разбор и токенизация, индексация идут в разных потоках,
+// стадии связаны ограниченными очередями
+struct IngestionOptions {
+    size_t chunk_size = 1 << 20;
+    size_t queue_capacity = 8;
+    size_t parser_threads = 2;
+};
+
+struct IngestionStats {
+    size_t bytes_read = 0;
+    size_t records = 0;
+    size_t documents_added = 0;
+    // Некорректные записи пропускаются
+    size_t errors = 0;
+};
+
+IngestionStats IngestDocuments(SearchServer& search_server, std::istream& input, const IngestionOptions& options = {});
+
+IngestionStats IngestFile(SearchServer& search_server, const std::string& path, const IngestionOptions& options = {});
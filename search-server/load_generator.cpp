@@ -0,0 +1,167 @@
+#include "search_server.h"
+#include "generators.h"
+#include "ingestion.h"
+#include "query_replay.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct LoadConfig {
+    uint32_t seed = 5489;
+    ZipfWorkloadOptions workload;
+    // Столько самых частых слов словаря становятся стоп-словами
+    int stop_word_count = 0;
+    string corpus_path;
+    string log_path;
+    string write_log_path;
+    ReplayOptions replay;
+};
+
+const char USAGE[] = " [--quick] [--seed N] [--documents N] [--dictionary N] [--word-skew S]"
+    " [--queries N] [--distinct-queries N] [--query-skew S] [--minus-prob P] [--stop-words N]"
+    " [--corpus FILE] [--log FILE] [--write-log FILE] [--clients N] [--qps N]";
+
+// false, если аргументы не разобрать
+bool ParseArguments(int argc, char* argv[], LoadConfig& config) {
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--quick") {
+            config.workload.document_count = 2'000;
+            config.workload.dictionary_size = 2'000;
+            config.workload.query_count = 2'000;
+            config.workload.distinct_query_count = 200;
+            continue;
+        }
+        if (i + 1 == argc) {
+            return false;
+        }
+        const string value = argv[++i];
+        if (arg == "--seed") {
+            config.seed = static_cast<uint32_t>(stoul(value));
+        }
+        else if (arg == "--documents") {
+            config.workload.document_count = stoi(value);
+        }
+        else if (arg == "--dictionary") {
+            config.workload.dictionary_size = stoi(value);
+        }
+        else if (arg == "--word-skew") {
+            config.workload.word_skew = stod(value);
+        }
+        else if (arg == "--queries") {
+            config.workload.query_count = stoi(value);
+        }
+        else if (arg == "--distinct-queries") {
+            config.workload.distinct_query_count = stoi(value);
+        }
+        else if (arg == "--query-skew") {
+            config.workload.query_skew = stod(value);
+        }
+        else if (arg == "--minus-prob") {
+            config.workload.minus_prob = stod(value);
+        }
+        else if (arg == "--stop-words") {
+            config.stop_word_count = stoi(value);
+        }
+        else if (arg == "--corpus") {
+            config.corpus_path = value;
+        }
+        else if (arg == "--log") {
+            config.log_path = value;
+        }
+        else if (arg == "--write-log") {
+            config.write_log_path = value;
+        }
+        else if (arg == "--clients") {
+            const int client_count = stoi(value);
+            if (client_count <= 0) {
+                return false;
+            }
+            config.replay.client_count = static_cast<size_t>(client_count);
+        }
+        else if (arg == "--qps") {
+            config.replay.target_qps = stod(value);
+            // Заодно отсекает NaN
+            if (!(config.replay.target_qps >= 0.0)) {
+                return false;
+            }
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+// Строит сервер на сгенерированном по Ципфу корпусе (или на корпусе из --corpus в формате IngestFile),
+// прогоняет журнал запросов (сгенерированный или из --log) и печатает в stdout JSON с пропускной
+// способностью и перцентилями задержки
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    try {
+        if (!ParseArguments(argc, argv, config)) {
+            cerr << "Usage: " << argv[0] << USAGE << endl;
+            return 1;
+        }
+    }
+    catch (const logic_error&) {
+        cerr << "Usage: " << argv[0] << USAGE << endl;
+        return 1;
+    }
+
+    mt19937 generator(config.seed);
+    const Workload workload = GenerateZipfWorkload(generator, config.workload);
+    const auto stop_word_end = workload.dictionary.begin() + min<size_t>(max(config.stop_word_count, 0), workload.dictionary.size());
+    SearchServer search_server(vector<string>(workload.dictionary.begin(), stop_word_end));
+    if (config.corpus_path.empty()) {
+        for (size_t i = 0; i < workload.documents.size(); ++i) {
+            search_server.AddDocument(static_cast<int>(i), workload.documents[i], DocumentStatus::ACTUAL, { static_cast<int>(i % 10) });
+        }
+    }
+    else {
+        IngestFile(search_server, config.corpus_path);
+    }
+
+    vector<string> queries = workload.queries;
+    if (!config.log_path.empty()) {
+        ifstream log(config.log_path);
+        if (!log) {
+            cerr << "Cannot open " << config.log_path << endl;
+            return 1;
+        }
+        queries = ReadQueryLog(log);
+    }
+    if (!config.write_log_path.empty()) {
+        ofstream log(config.write_log_path);
+        if (!log) {
+            cerr << "Cannot open " << config.write_log_path << endl;
+            return 1;
+        }
+        WriteQueryLog(log, queries);
+        if (!log.flush()) {
+            cerr << "Cannot write " << config.write_log_path << endl;
+            return 1;
+        }
+    }
+
+    const ReplayStats stats = ReplayQueries(search_server, queries, config.replay);
+    cout << "{\"seed\": " << config.seed
+        << ", \"documents\": " << search_server.GetDocumentCount()
+        << ", \"word_skew\": " << config.workload.word_skew
+        << ", \"query_skew\": " << config.workload.query_skew
+        << ", \"minus_prob\": " << config.workload.minus_prob
+        << ", \"clients\": " << config.replay.client_count
+        << ", \"target_qps\": " << config.replay.target_qps
+        << ", \"result\": " << stats << "}" << endl;
+}
@@ -2,18 +2,20 @@
 
 #include <chrono>
 #include <iostream>
+#include <string>
+#include <string_view>
 
 #define PROFILE_CONCAT_INTERNAL(X, Y) X##Y
 #define PROFILE_CONCAT(X, Y) PROFILE_CONCAT_INTERNAL(X, Y)
 #define UNIQUE_VAR_NAME_PROFILE PROFILE_CONCAT(profileGuard, __LINE__)
-#define LOG_DURATION(name) LogDuration UNIQUE_VAR_NAME_PROFILE(x)
+#define LOG_DURATION(name) LogDuration UNIQUE_VAR_NAME_PROFILE(name)
 #define LOG_DURATION_STREAM(name, stream) LogDuration UNIQUE_VAR_NAME_PROFILE(name, stream)
 
 class LogDuration {
 public:
 	using Clock = std::chrono::steady_clock;
 
-	LogDuration(const std::string& id, std::ostream& stream = std::cerr) : id_(id), output_(stream) {}
+	LogDuration(std::string_view id, std::ostream& stream = std::cerr) : id_(id), output_(stream) {}
 
 	~LogDuration() {
 		using namespace std::chrono;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory_resource>
+
+// Считает байты, выделенные через него контейнерами std::pmr; сами выделения делает upstream.
+// Счётчик атомарный: контейнеры одного ресурса могут освобождать память из разных потоков
+class TrackingMemoryResource : public std::pmr::memory_resource {
+public:
+    explicit TrackingMemoryResource(std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+        : upstream_(upstream) {
+    }
+
+    size_t GetAllocatedBytes() const {
+        return allocated_bytes_.load(std::memory_order_relaxed);
+    }
+
+    // Всего вызовов allocate с создания ресурса
+    size_t GetAllocationCount() const {
+        return allocation_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        void* result = upstream_->allocate(bytes, alignment);
+        allocated_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        allocation_count_.fetch_add(1, std::memory_order_relaxed);
+        return result;
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override {
+        upstream_->deallocate(p, bytes, alignment);
+        allocated_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    std::pmr::memory_resource* upstream_;
+    std::atomic<size_t> allocated_bytes_ = 0;
+    std::atomic<size_t> allocation_count_ = 0;
+};
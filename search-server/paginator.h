@@ -1,6 +1,8 @@
 #pragma once
 
 #include <iostream>
+#include <iterator>
+#include <stdexcept>
 
 namespace std {
     template <typename Iterator>
@@ -37,31 +39,66 @@ namespace std {
         return out;
     }
 
+    // Страницы не хранятся, а строятся при разыменовании итератора
     template <typename Iterator>
     class Paginator {
     public:
-        Paginator(Iterator begin, Iterator end, size_t page_size) {
-            for (size_t left = distance(begin, end); left > 0;) {
-                const size_t current_page_size = min(page_size, left);
-                const Iterator current_page_end = next(begin, current_page_size);
-                pages_.push_back({ begin, current_page_end });
-
-                left -= current_page_size;
-                begin = current_page_end;
+        class PageIterator {
+        public:
+            PageIterator(Iterator page_begin, size_t left, size_t page_size)
+                : page_begin_(page_begin)
+                , left_(left)
+                , page_size_(page_size) {
+            }
+
+            IteratorRange<Iterator> operator*() const {
+                return { page_begin_, next(page_begin_, min(page_size_, left_)) };
+            }
+
+            PageIterator& operator++() {
+                const size_t current_page_size = min(page_size_, left_);
+                page_begin_ = next(page_begin_, current_page_size);
+                left_ -= current_page_size;
+                return *this;
+            }
+
+            bool operator==(const PageIterator& other) const {
+                return left_ == other.left_;
+            }
+
+            bool operator!=(const PageIterator& other) const {
+                return !(*this == other);
+            }
+
+        private:
+            Iterator page_begin_;
+            size_t left_;
+            size_t page_size_;
+        };
+
+        Paginator(Iterator begin, Iterator end, size_t page_size)
+            : begin_(begin)
+            , end_(end)
+            , page_size_(page_size)
+            , total_(distance(begin, end)) {
+            if (page_size_ == 0) {
+                throw invalid_argument("Page size must be positive");
             }
         }
         auto begin() const {
-            return pages_.begin();
+            return PageIterator(begin_, total_, page_size_);
         }
         auto end() const {
-            return pages_.end();
+            return PageIterator(end_, 0, page_size_);
         }
         size_t size() const {
-            return pages_.size();
+            return (total_ + page_size_ - 1) / page_size_;
         }
 
     private:
-        vector<IteratorRange<Iterator>> pages_;
+        Iterator begin_, end_;
+        size_t page_size_;
+        size_t total_;
     };
 
     template <typename Container>
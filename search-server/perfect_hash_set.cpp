@@ -0,0 +1,105 @@
+#include "perfect_hash_set.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+    // Финализатор splitmix64
+    uint64_t Mix(uint64_t value) {
+        value ^= value >> 30;
+        value *= 0xBF58476D1CE4E5B9ull;
+        value ^= value >> 27;
+        value *= 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    uint64_t SeededHash(uint64_t hash, uint32_t seed) {
+        return Mix(hash ^ (seed * 0x9E3779B97F4A7C15ull));
+    }
+}
+
+PerfectHashSet::PerfectHashSet(const set<string, less<>>& keys) {
+    const size_t key_count = keys.size();
+    if (key_count == 0) {
+        return;
+    }
+    vector<vector<uint64_t>> buckets(key_count);
+    vector<string> sorted_keys(keys.begin(), keys.end());
+    vector<uint64_t> hashes;
+    for (const string& key : sorted_keys) {
+        const uint64_t hash = std::hash<string_view>{}(key);
+        hashes.push_back(hash);
+        buckets[Mix(hash) % key_count].push_back(hash);
+    }
+
+    // Сначала размещаем большие корзины, пока свободных ячеек много
+    vector<size_t> order(key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&buckets](size_t lhs, size_t rhs) {
+        return buckets[lhs].size() > buckets[rhs].size();
+    });
+
+    displacements_.assign(key_count, 0);
+    vector<bool> occupied(key_count);
+    vector<size_t> slots;
+    size_t free_slot = 0;
+    for (const size_t bucket : order) {
+        const auto& bucket_hashes = buckets[bucket];
+        if (bucket_hashes.empty()) {
+            break;
+        }
+        if (bucket_hashes.size() == 1) {
+            while (occupied[free_slot]) {
+                ++free_slot;
+            }
+            occupied[free_slot] = true;
+            displacements_[bucket] = -static_cast<int32_t>(free_slot) - 1;
+            continue;
+        }
+        for (uint32_t seed = 1;; ++seed) {
+            if (seed == 0x7FFFFFFF) {
+                throw invalid_argument("Cannot build perfect hash: duplicate key hashes");
+            }
+            slots.clear();
+            for (const uint64_t hash : bucket_hashes) {
+                const size_t slot = SeededHash(hash, seed) % key_count;
+                if (occupied[slot] || find(slots.begin(), slots.end(), slot) != slots.end()) {
+                    break;
+                }
+                slots.push_back(slot);
+            }
+            if (slots.size() == bucket_hashes.size()) {
+                for (const size_t slot : slots) {
+                    occupied[slot] = true;
+                }
+                displacements_[bucket] = static_cast<int32_t>(seed);
+                break;
+            }
+        }
+    }
+
+    keys_.resize(key_count);
+    for (size_t i = 0; i < key_count; ++i) {
+        keys_[GetSlot(hashes[i])] = move(sorted_keys[i]);
+    }
+}
+
+size_t PerfectHashSet::GetSlot(uint64_t hash) const {
+    const int32_t displacement = displacements_[Mix(hash) % keys_.size()];
+    if (displacement < 0) {
+        return static_cast<size_t>(-(displacement + 1));
+    }
+    return SeededHash(hash, static_cast<uint32_t>(displacement)) % keys_.size();
+}
+
+bool PerfectHashSet::Contains(string_view key) const {
+    if (keys_.empty()) {
+        return false;
+    }
+    return keys_[GetSlot(std::hash<string_view>{}(key))] == key;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Неизменяемое множество строк на минимальной совершенной хеш-функции (hash-and-displace):
+// ключ сначала попадает в корзину, а смещение корзины выбирается так, чтобы все её ключи
+// легли в свободные ячейки таблицы размером ровно с число ключей. Поиск — два перемешивания
+// одного хеша строки и одно сравнение
+class PerfectHashSet {
+public:
+    PerfectHashSet() = default;
+    explicit PerfectHashSet(const std::set<std::string, std::less<>>& keys);
+
+    bool Contains(std::string_view key) const;
+
+    size_t size() const {
+        return keys_.size();
+    }
+
+    std::vector<std::string>::const_iterator begin() const {
+        return keys_.begin();
+    }
+
+    std::vector<std::string>::const_iterator end() const {
+        return keys_.end();
+    }
+
+private:
+    size_t GetSlot(uint64_t hash) const;
+
+    // Для корзины из одного ключа хранится -(ячейка + 1), иначе — затравка для второго хеша
+    std::vector<int32_t> displacements_;
+    std::vector<std::string> keys_;
+};
@@ -0,0 +1,201 @@
+#include "positional_index.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+    void AppendVarint(pmr::vector<uint8_t>& out, uint32_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value) | 0x80);
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    uint32_t ReadVarint(const uint8_t*& data) {
+        uint32_t value = 0;
+        int shift = 0;
+        while (true) {
+            const uint8_t byte = *data++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+            shift += 7;
+        }
+    }
+
+    // Конец позиций документа, начинающихся с data
+    const uint8_t* SkipPositions(const uint8_t* data) {
+        for (uint32_t count = ReadVarint(data); count > 0; --count) {
+            ReadVarint(data);
+        }
+        return data;
+    }
+}
+
+PositionalIndex::PositionList::Iterator::Iterator(const uint8_t* data, uint32_t count)
+    : data_(data)
+    , remaining_(count) {
+    if (remaining_ != 0) {
+        Decode();
+    }
+}
+
+PositionalIndex::PositionList::Iterator& PositionalIndex::PositionList::Iterator::operator++() {
+    if (--remaining_ != 0) {
+        Decode();
+    }
+    return *this;
+}
+
+void PositionalIndex::PositionList::Iterator::Decode() {
+    value_ += ReadVarint(data_);
+}
+
+bool PositionalIndex::PositionList::Contains(uint32_t position) const {
+    for (const uint32_t current : *this) {
+        if (current >= position) {
+            return current == position;
+        }
+    }
+    return false;
+}
+
+void PositionalIndex::AddDocument(int document_id, const vector<pair<string_view, uint32_t>>& words) {
+    // Позиции каждого слова подряд и по возрастанию
+    vector<pair<string_view, uint32_t>> sorted_words = words;
+    sort(sorted_words.begin(), sorted_words.end());
+    for (auto run = sorted_words.begin(); run != sorted_words.end();) {
+        const auto run_end = find_if(run, sorted_words.end(), [word = run->first](const auto& entry) {
+            return entry.first != word;
+        });
+        auto& positions = word_to_positions_[run->first];
+        const auto entry = lower_bound(positions.documents.begin(), positions.documents.end(), document_id,
+            [](const DocumentEntry& lhs, int id) { return lhs.document_id < id; });
+        // Байты нового документа всегда дописываются в конец буфера, даже если его id не наибольший
+        positions.documents.insert(entry, { document_id, static_cast<uint32_t>(positions.data.size()) });
+        AppendVarint(positions.data, static_cast<uint32_t>(run_end - run));
+        uint32_t previous = 0;
+        for (; run != run_end; ++run) {
+            AppendVarint(positions.data, run->second - previous);
+            previous = run->second;
+        }
+    }
+}
+
+void PositionalIndex::RemoveDocument(int document_id, const vector<string_view>& words) {
+    for (const string_view word : words) {
+        const auto it = word_to_positions_.find(word);
+        if (it == word_to_positions_.end()) {
+            continue;
+        }
+        auto& positions = it->second;
+        const auto entry = lower_bound(positions.documents.begin(), positions.documents.end(), document_id,
+            [](const DocumentEntry& lhs, int id) { return lhs.document_id < id; });
+        if (entry == positions.documents.end() || entry->document_id != document_id) {
+            continue;
+        }
+        const uint8_t* const begin = positions.data.data() + entry->offset;
+        positions.dead_bytes += SkipPositions(begin) - begin;
+        positions.documents.erase(entry);
+        if (positions.documents.empty()) {
+            word_to_positions_.erase(it);
+        }
+        else if (positions.dead_bytes * 2 > positions.data.size()) {
+            CompactPositions(positions);
+        }
+    }
+}
+
+void PositionalIndex::CompactPositions(WordPositions& positions) {
+    pmr::vector<uint8_t> data(positions.data.get_allocator());
+    data.reserve(positions.data.size() - positions.dead_bytes);
+    for (auto& entry : positions.documents) {
+        const uint8_t* const begin = positions.data.data() + entry.offset;
+        entry.offset = static_cast<uint32_t>(data.size());
+        data.insert(data.end(), begin, SkipPositions(begin));
+    }
+    positions.data.swap(data);
+    positions.dead_bytes = 0;
+}
+
+PositionalIndex::PositionList PositionalIndex::GetPositions(string_view word, int document_id) const {
+    const auto word_it = word_to_positions_.find(word);
+    if (word_it == word_to_positions_.end()) {
+        return {};
+    }
+    const auto& documents = word_it->second.documents;
+    const auto entry = lower_bound(documents.begin(), documents.end(), document_id,
+        [](const DocumentEntry& lhs, int id) { return lhs.document_id < id; });
+    if (entry == documents.end() || entry->document_id != document_id) {
+        return {};
+    }
+    const uint8_t* data = word_it->second.data.data() + entry->offset;
+    const uint32_t count = ReadVarint(data);
+    return { data, count };
+}
+
+bool PositionalIndex::MatchesPhrase(int document_id, const Phrase& phrase) const {
+    if (phrase.words.empty()) {
+        return true;
+    }
+    return phrase.max_distance < 0 ? MatchesExactPhrase(document_id, phrase) : MatchesProximity(document_id, phrase);
+}
+
+bool PositionalIndex::MatchesExactPhrase(int document_id, const Phrase& phrase) const {
+    const PositionList first = GetPositions(phrase.words[0], document_id);
+    for (const uint32_t position : first) {
+        if (position < phrase.offsets[0]) {
+            continue;
+        }
+        const uint32_t phrase_start = position - phrase.offsets[0];
+        bool matched = true;
+        for (size_t i = 1; i < phrase.words.size() && matched; ++i) {
+            matched = GetPositions(phrase.words[i], document_id).Contains(phrase_start + phrase.offsets[i]);
+        }
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PositionalIndex::MatchesProximity(int document_id, const Phrase& phrase) const {
+    vector<string_view> words = phrase.words;
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+
+    // Сливаем позиции всех слов и ищем минимальное окно, покрывающее каждое слово
+    vector<pair<uint32_t, size_t>> occurrences;
+    for (size_t i = 0; i < words.size(); ++i) {
+        const PositionList positions = GetPositions(words[i], document_id);
+        if (positions.empty()) {
+            return false;
+        }
+        for (const uint32_t position : positions) {
+            occurrences.push_back({ position, i });
+        }
+    }
+    sort(occurrences.begin(), occurrences.end());
+
+    vector<int> counts(words.size());
+    size_t covered = 0;
+    size_t left = 0;
+    for (size_t right = 0; right < occurrences.size(); ++right) {
+        if (counts[occurrences[right].second]++ == 0) {
+            ++covered;
+        }
+        while (covered == words.size()) {
+            if (occurrences[right].first - occurrences[left].first <= static_cast<uint32_t>(phrase.max_distance)) {
+                return true;
+            }
+            if (--counts[occurrences[left].second] == 0) {
+                --covered;
+            }
+            ++left;
+        }
+    }
+    return false;
+}
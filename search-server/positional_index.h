@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+// Позиции слов в документах. Позиции всех документов одного слова лежат в одном буфере: у документа —
+// число позиций и сами позиции varint-дельтами, а таблица (id документа, смещение в буфере),
+// отсортированная по id, находит их двоичным поиском. Удаление только выбрасывает строку таблицы;
+// буфер слова уплотняется, когда мёртвые байты занимают больше половины
+class PositionalIndex {
+public:
+    // Позиции одного слова в одном документе; декодируются на лету без выделения памяти
+    class PositionList {
+    public:
+        class Iterator {
+        public:
+            Iterator(const uint8_t* data, uint32_t count);
+
+            uint32_t operator*() const {
+                return value_;
+            }
+
+            Iterator& operator++();
+
+            bool operator!=(const Iterator& other) const {
+                return remaining_ != other.remaining_;
+            }
+
+        private:
+            void Decode();
+
+            const uint8_t* data_;
+            uint32_t remaining_;
+            uint32_t value_ = 0;
+        };
+
+        PositionList() = default;
+        PositionList(const uint8_t* data, uint32_t count)
+            : data_(data)
+            , count_(count) {
+        }
+
+        Iterator begin() const {
+            return { data_, count_ };
+        }
+
+        Iterator end() const {
+            return { nullptr, 0 };
+        }
+
+        bool empty() const {
+            return count_ == 0;
+        }
+
+        bool Contains(uint32_t position) const;
+
+    private:
+        const uint8_t* data_ = nullptr;
+        uint32_t count_ = 0;
+    };
+
+    // Фраза запроса: слова с их смещениями относительно первого слова фразы.
+    // Если max_distance < 0, слова должны стоять ровно на своих смещениях,
+    // иначе все слова должны уложиться в окно из max_distance + 1 позиций в любом порядке
+    struct Phrase {
+        std::vector<std::string_view> words;
+        std::vector<uint32_t> offsets;
+        int max_distance = -1;
+    };
+
+    explicit PositionalIndex(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : word_to_positions_(resource) {
+    }
+
+    // words — слова документа вместе с их позициями (стоп-слова пропущены, но позиции учитывают их)
+    void AddDocument(int document_id, const std::vector<std::pair<std::string_view, uint32_t>>& words);
+    void RemoveDocument(int document_id, const std::vector<std::string_view>& words);
+
+    PositionList GetPositions(std::string_view word, int document_id) const;
+
+    bool MatchesPhrase(int document_id, const Phrase& phrase) const;
+
+private:
+    struct DocumentEntry {
+        int document_id;
+        uint32_t offset;
+    };
+
+    struct WordPositions {
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        explicit WordPositions(const allocator_type& allocator = {})
+            : documents(allocator)
+            , data(allocator) {
+        }
+
+        WordPositions(const WordPositions& other) = default;
+        WordPositions(WordPositions&& other) = default;
+
+        WordPositions(const WordPositions& other, const allocator_type& allocator)
+            : documents(other.documents, allocator)
+            , data(other.data, allocator)
+            , dead_bytes(other.dead_bytes) {
+        }
+
+        WordPositions(WordPositions&& other, const allocator_type& allocator)
+            : documents(std::move(other.documents), allocator)
+            , data(std::move(other.data), allocator)
+            , dead_bytes(other.dead_bytes) {
+        }
+
+        WordPositions& operator=(const WordPositions& other) = default;
+        WordPositions& operator=(WordPositions&& other) = default;
+
+        std::pmr::vector<DocumentEntry> documents;
+        std::pmr::vector<uint8_t> data;
+        // Байты удалённых документов, ещё лежащие в data
+        size_t dead_bytes = 0;
+    };
+
+    // Переписывает data без байтов удалённых документов
+    static void CompactPositions(WordPositions& positions);
+
+    bool MatchesExactPhrase(int document_id, const Phrase& phrase) const;
+    bool MatchesProximity(int document_id, const Phrase& phrase) const;
+
+    std::pmr::map<std::string_view, WordPositions> word_to_positions_;
+};
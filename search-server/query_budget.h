@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "document.h"
+
+// Флаг отмены, общий для источника и всех выданных им токенов
+class CancellationToken {
+public:
+    // Токен без источника никогда не отменяется
+    CancellationToken() = default;
+
+    bool IsCancelled() const {
+        return cancelled_ && cancelled_->load(std::memory_order_relaxed);
+    }
+
+private:
+    friend class CancellationSource;
+
+    explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> cancelled)
+        : cancelled_(std::move(cancelled)) {
+    }
+
+    std::shared_ptr<const std::atomic<bool>> cancelled_;
+};
+
+class CancellationSource {
+public:
+    void Cancel() const {
+        cancelled_->store(true, std::memory_order_relaxed);
+    }
+
+    CancellationToken GetToken() const {
+        return CancellationToken(cancelled_);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled_ = std::make_shared<std::atomic<bool>>(false);
+};
+
+// Ограничение на время выполнения запроса. Проверяется между блоками постингов,
+// поэтому запрос может превысить срок на время обработки одного блока
+struct QueryBudget {
+    using Clock = std::chrono::steady_clock;
+
+    std::optional<Clock::time_point> deadline;
+    CancellationToken cancellation;
+
+    // Срок отсчитывается от создания бюджета, так что ожидание в очереди тоже учитывается
+    static QueryBudget WithTimeout(Clock::duration timeout, CancellationToken cancellation = {}) {
+        return { Clock::now() + timeout, std::move(cancellation) };
+    }
+
+    bool IsExhausted() const {
+        return cancellation.IsCancelled() || (deadline && Clock::now() >= *deadline);
+    }
+};
+
+struct PartialSearchResult {
+    std::vector<Document> documents;
+    // Бюджет исчерпан: documents — лучшие из документов, найденных к этому моменту
+    bool partial = false;
+};
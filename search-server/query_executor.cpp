@@ -0,0 +1,30 @@
+#include "query_executor.h"
+
+using namespace std;
+
+QueryExecutor::QueryExecutor(size_t thread_count, size_t queue_capacity)
+    : tasks_(queue_capacity) {
+    if (thread_count == 0 || queue_capacity == 0) {
+        throw invalid_argument("Invalid query executor options");
+    }
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this] {
+            while (auto task = tasks_.Pop()) {
+                (*task)();
+            }
+        });
+    }
+}
+
+QueryExecutor::~QueryExecutor() {
+    tasks_.Close();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+QueryExecutor& QueryExecutor::GetDefault() {
+    static QueryExecutor executor;
+    return executor;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "bounded_queue.h"
+
+// Пул из фиксированного числа потоков для асинхронных запросов: одновременно выполняется не больше
+// запросов, чем потоков, остальные ждут в очереди. Срок QueryBudget::WithTimeout идёт и в очереди,
+// так что запрос, простоявший дольше срока, сразу завершается с флагом partial. Submit блокируется,
+// пока в очереди queue_capacity задач, — это обратное давление на источник запросов
+class QueryExecutor {
+public:
+    explicit QueryExecutor(size_t thread_count = std::max(1u, std::thread::hardware_concurrency()), size_t queue_capacity = 1024);
+
+    QueryExecutor(const QueryExecutor&) = delete;
+    QueryExecutor& operator=(const QueryExecutor&) = delete;
+
+    // Дожидается задач, уже поставленных в очередь
+    ~QueryExecutor();
+
+    template <typename Task>
+    std::future<std::invoke_result_t<Task&>> Submit(Task task) {
+        using Result = std::invoke_result_t<Task&>;
+        auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        auto result = packaged_task->get_future();
+        if (!tasks_.Push([packaged_task] { (*packaged_task)(); })) {
+            throw std::logic_error("Query executor is stopped");
+        }
+        return result;
+    }
+
+    size_t GetThreadCount() const {
+        return threads_.size();
+    }
+
+    // Общий пул процесса по числу аппаратных потоков; создаётся при первом обращении
+    static QueryExecutor& GetDefault();
+
+private:
+    BoundedQueue<std::function<void()>> tasks_;
+    std::vector<std::thread> threads_;
+};
@@ -0,0 +1,133 @@
+#include "query_replay.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+namespace {
+    // Точный перцентиль по отсортированным задержкам
+    uint64_t Percentile(const vector<uint64_t>& sorted_latencies, double fraction) {
+        if (sorted_latencies.empty()) {
+            return 0;
+        }
+        const size_t rank = max<size_t>(1, static_cast<size_t>(fraction * sorted_latencies.size() + 0.5));
+        return sorted_latencies[min(rank, sorted_latencies.size()) - 1];
+    }
+}
+
+ostream& operator<<(ostream& out, const ReplayStats& stats) {
+    out << "{\"queries\": " << stats.queries
+        << ", \"full_parser_queries\": " << stats.full_parser_queries
+        << ", \"errors\": " << stats.errors
+        << ", \"elapsed_s\": " << stats.elapsed_seconds
+        << ", \"throughput_qps\": " << stats.throughput_qps
+        << ", \"mean_ns\": " << stats.mean_ns
+        << ", \"p50_ns\": " << stats.p50_ns
+        << ", \"p99_ns\": " << stats.p99_ns
+        << ", \"p999_ns\": " << stats.p999_ns
+        << ", \"max_ns\": " << stats.max_ns << "}";
+    return out;
+}
+
+ReplayStats ReplayQueries(const SearchServer& search_server, const vector<string>& queries, const ReplayOptions& options) {
+    if (options.client_count == 0 || options.target_qps < 0.0) {
+        throw invalid_argument("Invalid replay options");
+    }
+    using Clock = chrono::steady_clock;
+
+    // Путь выполнения выбирается до замера, чтобы разбор и отказ не попадали в задержку
+    vector<bool> supports_context(queries.size());
+    size_t full_parser_queries = 0;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        supports_context[i] = SearchServer::SupportsQueryContext(queries[i]);
+        full_parser_queries += !supports_context[i];
+    }
+
+    atomic<size_t> next_query{ 0 };
+    atomic<size_t> errors{ 0 };
+    vector<vector<uint64_t>> client_latencies(options.client_count);
+    const auto start = Clock::now() + chrono::milliseconds(1);
+    const auto client = [&](vector<uint64_t>& latencies) {
+        // У каждого клиента свои буферы запроса, как у отдельного потока обслуживания
+        SearchServer::QueryContext context;
+        Document results[MAX_RESULT_DOCUMENT_COUNT];
+        latencies.reserve(queries.size() / options.client_count + 1);
+        // Клиенты стартуют вместе, иначе прогон короче миллисекунды показывал бы отрицательное время
+        this_thread::sleep_until(start);
+        for (size_t i = next_query++; i < queries.size(); i = next_query++) {
+            auto scheduled = Clock::now();
+            if (options.target_qps > 0.0) {
+                scheduled = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(i / options.target_qps));
+                this_thread::sleep_until(scheduled);
+            }
+            try {
+                if (supports_context[i]) {
+                    search_server.FindTopDocuments(context, queries[i], results);
+                }
+                else {
+                    search_server.FindTopDocuments(queries[i]);
+                }
+            }
+            catch (const invalid_argument&) {
+                ++errors;
+                continue;
+            }
+            latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(Clock::now() - scheduled).count());
+        }
+    };
+
+    vector<thread> threads;
+    threads.reserve(options.client_count);
+    for (auto& latencies : client_latencies) {
+        threads.emplace_back(client, ref(latencies));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    const double elapsed_seconds = chrono::duration<double>(Clock::now() - start).count();
+
+    vector<uint64_t> latencies;
+    latencies.reserve(queries.size());
+    for (const auto& part : client_latencies) {
+        latencies.insert(latencies.end(), part.begin(), part.end());
+    }
+    sort(latencies.begin(), latencies.end());
+
+    ReplayStats stats;
+    stats.queries = queries.size();
+    stats.full_parser_queries = full_parser_queries;
+    stats.errors = errors;
+    stats.elapsed_seconds = elapsed_seconds;
+    stats.throughput_qps = elapsed_seconds > 0.0 ? latencies.size() / elapsed_seconds : 0.0;
+    stats.mean_ns = latencies.empty() ? 0.0 : accumulate(latencies.begin(), latencies.end(), 0.0) / latencies.size();
+    stats.p50_ns = Percentile(latencies, 0.5);
+    stats.p99_ns = Percentile(latencies, 0.99);
+    stats.p999_ns = Percentile(latencies, 0.999);
+    stats.max_ns = latencies.empty() ? 0 : latencies.back();
+    return stats;
+}
+
+vector<string> ReadQueryLog(istream& input) {
+    vector<string> queries;
+    string line;
+    while (getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (!line.empty()) {
+            queries.push_back(move(line));
+        }
+    }
+    return queries;
+}
+
+void WriteQueryLog(ostream& output, const vector<string>& queries) {
+    for (const string& query : queries) {
+        output << query << '\n';
+    }
+}
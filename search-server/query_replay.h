@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "search_server.h"
+
+// Нагрузочный прогон журнала запросов: client_count потоков по очереди берут следующий запрос журнала.
+// При target_qps > 0 нагрузка открытая: запрос i назначен на момент i / target_qps от начала, и задержка
+// считается от назначенного момента, а не от фактической отправки — иначе отставший сервер сам прятал бы
+// очередь из статистики. При target_qps = 0 каждый клиент шлёт следующий запрос сразу после ответа.
+// Запросы выполняются через QueryContext, а запросы с синтаксисом, который он не разбирает (фразы, префиксы,
+// +слова, группы a|b), — через FindTopDocuments(запрос), как их выполнял бы сервер
+struct ReplayOptions {
+    size_t client_count = 4;
+    double target_qps = 0.0;
+};
+
+struct ReplayStats {
+    size_t queries = 0;
+    // Запросы, выполненные без QueryContext
+    size_t full_parser_queries = 0;
+    // Запросы, отвергнутые сервером; в задержки и пропускную способность не входят
+    size_t errors = 0;
+    double elapsed_seconds = 0.0;
+    double throughput_qps = 0.0;
+    double mean_ns = 0.0;
+    uint64_t p50_ns = 0;
+    uint64_t p99_ns = 0;
+    uint64_t p999_ns = 0;
+    uint64_t max_ns = 0;
+};
+
+std::ostream& operator<<(std::ostream& out, const ReplayStats& stats);
+
+ReplayStats ReplayQueries(const SearchServer& search_server, const std::vector<std::string>& queries, const ReplayOptions& options = {});
+
+// Журнал — запрос на строку, пустые строки пропускаются
+std::vector<std::string> ReadQueryLog(std::istream& input);
+void WriteQueryLog(std::ostream& output, const std::vector<std::string>& queries);
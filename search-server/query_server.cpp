@@ -0,0 +1,420 @@
+#include "query_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <execution>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+    constexpr uint64_t LISTEN_ID = 0;
+    constexpr uint64_t STOP_ID = 1;
+    constexpr int MAX_EVENTS = 64;
+    constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+    // IOV_MAX в Linux
+    constexpr size_t MAX_IOVECS = 1024;
+
+    [[noreturn]] void ThrowSystemError(const string& what) {
+        throw system_error(errno, generic_category(), what);
+    }
+
+    template <typename Number>
+    void AppendNumber(string& out, Number value) {
+        char buffer[32];
+        const auto result = to_chars(begin(buffer), end(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+
+    string FormatResponse(const vector<Document>& documents) {
+        string response = "OK ";
+        AppendNumber(response, documents.size());
+        for (const Document& document : documents) {
+            response += ' ';
+            AppendNumber(response, document.id);
+            response += ' ';
+            AppendNumber(response, document.relevance);
+            response += ' ';
+            AppendNumber(response, document.rating);
+        }
+        response += '\n';
+        return response;
+    }
+
+    string FormatError(const string& what) {
+        string response = "ERROR " + what + '\n';
+        replace(response.begin(), response.end() - 1, '\n', ' ');
+        return response;
+    }
+
+    uint64_t ToNanoseconds(chrono::steady_clock::duration duration) {
+        return chrono::duration_cast<chrono::nanoseconds>(duration).count();
+    }
+
+    void PrintHistogram(ostream& out, const string& name, const StageHistogram& histogram) {
+        out << name << ": count = " << histogram.count
+            << ", mean = " << histogram.MeanNs() << " ns"
+            << ", p50 = " << histogram.Percentile(0.5) << " ns"
+            << ", p99 = " << histogram.Percentile(0.99) << " ns"
+            << ", p999 = " << histogram.Percentile(0.999) << " ns"
+            << ", max = " << histogram.max_ns << " ns" << '\n';
+    }
+}
+
+ostream& operator<<(ostream& out, const QueryServerStats& stats) {
+    out << "connections: accepted = " << stats.connections_accepted << ", open = " << stats.open_connections << '\n';
+    out << "requests = " << stats.requests << ", errors = " << stats.errors << ", batches = " << stats.batches
+        << ", mean batch = " << (stats.batches == 0 ? 0.0 : stats.requests * 1.0 / stats.batches) << '\n';
+    PrintHistogram(out, "request latency", stats.request_latency);
+    PrintHistogram(out, "batch latency", stats.batch_latency);
+    return out;
+}
+
+QueryServer::QueryServer(const SearchServer& search_server, const QueryServerOptions& options)
+    : search_server_(search_server)
+    , options_(options)
+    , next_connection_id_(STOP_ID + 1) {
+    if (options_.max_batch_size == 0 || options_.max_request_size == 0 || options_.max_pending_requests == 0
+        || options_.max_output_size == 0) {
+        throw invalid_argument("Invalid query server options");
+    }
+    try {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(options_.port);
+        if (inet_pton(AF_INET, options_.address.c_str(), &address.sin_addr) != 1) {
+            throw invalid_argument("Invalid address " + options_.address);
+        }
+        listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            ThrowSystemError("Cannot create socket");
+        }
+        const int enable = 1;
+        setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            ThrowSystemError("Cannot bind " + options_.address + ":" + to_string(options_.port));
+        }
+        if (listen(listen_fd_, options_.listen_backlog) != 0) {
+            ThrowSystemError("Cannot listen");
+        }
+        socklen_t address_size = sizeof(address);
+        if (getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&address), &address_size) != 0) {
+            ThrowSystemError("Cannot get socket address");
+        }
+        port_ = ntohs(address.sin_port);
+
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            ThrowSystemError("Cannot create epoll");
+        }
+        stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stop_fd_ < 0) {
+            ThrowSystemError("Cannot create eventfd");
+        }
+        for (const auto& [fd, id] : { pair{ listen_fd_, LISTEN_ID }, pair{ stop_fd_, STOP_ID } }) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.u64 = id;
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+                ThrowSystemError("Cannot watch socket");
+            }
+        }
+    }
+    catch (...) {
+        CloseDescriptors();
+        throw;
+    }
+    thread_ = thread([this] { Run(); });
+}
+
+QueryServer::~QueryServer() {
+    Stop();
+    CloseDescriptors();
+}
+
+QueryServerStats QueryServer::GetStats() const {
+    lock_guard lock(stats_mutex_);
+    return stats_;
+}
+
+void QueryServer::Stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    const uint64_t signal = 1;
+    static_cast<void>(write(stop_fd_, &signal, sizeof(signal)));
+    thread_.join();
+}
+
+void QueryServer::Run() {
+    epoll_event events[MAX_EVENTS];
+    bool stopping = false;
+    while (!stopping) {
+        // Пока пачка копится, ждём не дольше её окна
+        int timeout = -1;
+        if (!batch_.empty()) {
+            const auto left = batch_.front().received + options_.batch_window - Clock::now();
+            timeout = max<int>(0, chrono::ceil<chrono::milliseconds>(left).count());
+        }
+        const int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+        if (event_count < 0 && errno != EINTR) {
+            break;
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t id = events[i].data.u64;
+            if (id == STOP_ID) {
+                stopping = true;
+            }
+            else if (id == LISTEN_ID) {
+                Accept();
+            }
+            else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                // Соединение закрыто в обе стороны: ответы уже некуда отправить
+                Close(id);
+            }
+            else {
+                if (events[i].events & EPOLLOUT) {
+                    Flush(id);
+                }
+                if (events[i].events & EPOLLIN) {
+                    Read(id);
+                }
+            }
+        }
+        while (!batch_.empty() && !stopping
+            && (batch_.size() >= options_.max_batch_size || Clock::now() >= batch_.front().received + options_.batch_window)) {
+            ExecuteBatch();
+        }
+    }
+
+    for (const auto& [id, connection] : connections_) {
+        close(connection.fd);
+    }
+    connections_.clear();
+    batch_.clear();
+    lock_guard lock(stats_mutex_);
+    stats_.open_connections = 0;
+}
+
+void QueryServer::Accept() {
+    while (true) {
+        const int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        // Ответы и так собраны в один sendmsg, задержка Нейгла только добавила бы к ним RTT
+        const int enable = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        const uint64_t id = next_connection_id_++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        connections_[id].fd = fd;
+        lock_guard lock(stats_mutex_);
+        ++stats_.connections_accepted;
+        ++stats_.open_connections;
+    }
+}
+
+void QueryServer::Read(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    const auto received = Clock::now();
+    // Сначала строки, оставшиеся в буфере с тех пор, как соединение было перегружено
+    ParseRequests(connection_id, connection, received);
+    char buffer[READ_CHUNK_SIZE];
+    while (!connection.read_closed && !IsOverloaded(connection)) {
+        const ssize_t size = read(connection.fd, buffer, sizeof(buffer));
+        if (size == 0) {
+            connection.read_closed = true;
+            break;
+        }
+        if (size < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            Close(connection_id);
+            return;
+        }
+        connection.input.append(buffer, size);
+        ParseRequests(connection_id, connection, received);
+        // У перегруженного соединения в буфере могут остаться полные строки; их длина проверится позже
+        if (!IsOverloaded(connection) && connection.input.size() > options_.max_request_size) {
+            Close(connection_id);
+            return;
+        }
+    }
+    UpdateEvents(connection_id, connection);
+    CloseIfDone(connection_id);
+}
+
+void QueryServer::ParseRequests(uint64_t connection_id, Connection& connection, Clock::time_point received) {
+    size_t line_begin = 0;
+    for (size_t line_end; !IsOverloaded(connection) && (line_end = connection.input.find('\n', line_begin)) != string::npos;
+        line_begin = line_end + 1) {
+        string_view line(connection.input.data() + line_begin, line_end - line_begin);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        batch_.push_back({ connection_id, string(line), received });
+        ++connection.pending_requests;
+    }
+    connection.input.erase(0, line_begin);
+}
+
+bool QueryServer::IsOverloaded(const Connection& connection) const {
+    return connection.pending_requests >= options_.max_pending_requests || connection.output_size >= options_.max_output_size;
+}
+
+void QueryServer::ExecuteBatch() {
+    const size_t size = min(batch_.size(), options_.max_batch_size);
+    const auto batch_end = batch_.begin() + size;
+    vector<string> responses(size);
+    const auto start = Clock::now();
+    transform(execution::par, batch_.begin(), batch_end, responses.begin(), [this](const Request& request) {
+        try {
+            return FormatResponse(search_server_.FindTopDocuments(request.query));
+        }
+        catch (const exception& error) {
+            return FormatError(error.what());
+        }
+        });
+    const auto finish = Clock::now();
+
+    {
+        lock_guard lock(stats_mutex_);
+        ++stats_.batches;
+        stats_.batch_latency.Add(ToNanoseconds(finish - start));
+        for (size_t i = 0; i < size; ++i) {
+            ++stats_.requests;
+            stats_.errors += responses[i][0] == 'E';
+            stats_.request_latency.Add(ToNanoseconds(finish - batch_[i].received));
+        }
+    }
+
+    // Запросы соединения лежат в пачке по порядку, поэтому и ответы встают в очередь по порядку
+    vector<uint64_t> touched_ids;
+    for (size_t i = 0; i < size; ++i) {
+        const auto it = connections_.find(batch_[i].connection_id);
+        if (it == connections_.end()) {
+            continue;
+        }
+        it->second.output_size += responses[i].size();
+        it->second.output.push_back(move(responses[i]));
+        --it->second.pending_requests;
+        touched_ids.push_back(it->first);
+    }
+    batch_.erase(batch_.begin(), batch_end);
+
+    sort(touched_ids.begin(), touched_ids.end());
+    touched_ids.erase(unique(touched_ids.begin(), touched_ids.end()), touched_ids.end());
+    for (const uint64_t id : touched_ids) {
+        Flush(id);
+    }
+}
+
+void QueryServer::Flush(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    while (!connection.output.empty()) {
+        iovec buffers[MAX_IOVECS];
+        size_t buffer_count = 0;
+        for (auto output = connection.output.begin(); output != connection.output.end() && buffer_count < MAX_IOVECS; ++output) {
+            const size_t offset = buffer_count == 0 ? connection.output_offset : 0;
+            buffers[buffer_count++] = { output->data() + offset, output->size() - offset };
+        }
+        msghdr message{};
+        message.msg_iov = buffers;
+        message.msg_iovlen = buffer_count;
+        // sendmsg вместо writev — ради MSG_NOSIGNAL: закрытый клиентом сокет не должен убивать процесс SIGPIPE
+        const ssize_t sent = sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            Close(connection_id);
+            return;
+        }
+        connection.output_offset += sent;
+        while (!connection.output.empty() && connection.output_offset >= connection.output.front().size()) {
+            connection.output_offset -= connection.output.front().size();
+            connection.output_size -= connection.output.front().size();
+            connection.output.pop_front();
+        }
+    }
+    // Строки, отложенные при перегрузке, уже прочитаны из сокета, и epoll о них не сообщит
+    if (!connection.reading && !connection.read_closed) {
+        ParseRequests(connection_id, connection, Clock::now());
+    }
+    UpdateEvents(connection_id, connection);
+    CloseIfDone(connection_id);
+}
+
+void QueryServer::CloseIfDone(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it != connections_.end() && it->second.read_closed && it->second.pending_requests == 0 && it->second.output.empty()) {
+        Close(connection_id);
+    }
+}
+
+void QueryServer::Close(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    // close сам снимает дескриптор с epoll
+    close(it->second.fd);
+    connections_.erase(it);
+    lock_guard lock(stats_mutex_);
+    --stats_.open_connections;
+}
+
+void QueryServer::UpdateEvents(uint64_t connection_id, Connection& connection) {
+    const bool reading = !connection.read_closed && !IsOverloaded(connection);
+    const bool writing = !connection.output.empty();
+    if (reading == connection.reading && writing == connection.writing) {
+        return;
+    }
+    connection.reading = reading;
+    connection.writing = writing;
+    epoll_event event{};
+    event.events = (reading ? uint32_t{ EPOLLIN } : uint32_t{ 0 }) | (writing ? uint32_t{ EPOLLOUT } : uint32_t{ 0 });
+    event.data.u64 = connection_id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryServer::CloseDescriptors() {
+    for (int* fd : { &stop_fd_, &epoll_fd_, &listen_fd_ }) {
+        if (*fd >= 0) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "query_stats.h"
+#include "search_server.h"
+
+// TCP-фронтенд поискового сервера на epoll: один поток ввода-вывода обслуживает все соединения.
+// Протокол строковый: запрос — строка с текстом запроса, ответ — строка
+//   OK <число документов>[ <id> <relevance> <rating>]...
+// или ERROR <причина>. Запросы одного соединения можно слать не дожидаясь ответов, ответы идут
+// в том же порядке. Запросы, прочитанные со всех соединений за один проход, выполняются одной
+// пачкой параллельно, как в ProcessQueries, а ответы соединения уходят одним sendmsg из нескольких буферов
+struct QueryServerOptions {
+    std::string address = "127.0.0.1";
+    // 0 — свободный порт, его вернёт GetPort
+    uint16_t port = 0;
+    int listen_backlog = 128;
+    size_t max_batch_size = 256;
+    // Сколько ещё ждать запросов после первого в пачке; 0 — выполнять сразу по окончании прохода
+    std::chrono::milliseconds batch_window{ 0 };
+    // Более длинная строка запроса — ошибка, соединение закрывается
+    size_t max_request_size = 64 * 1024;
+    // Соединение перестаёт читаться, пока у него столько запросов ждут выполнения или столько байт
+    // ответов ждут отправки, и читается снова, когда клиент заберёт ответы
+    size_t max_pending_requests = 1024;
+    size_t max_output_size = 1024 * 1024;
+};
+
+struct QueryServerStats {
+    uint64_t connections_accepted = 0;
+    uint64_t open_connections = 0;
+    uint64_t requests = 0;
+    // Запросы, на которые ответили ERROR
+    uint64_t errors = 0;
+    uint64_t batches = 0;
+    // От прочтения запроса до постановки ответа в очередь отправки
+    StageHistogram request_latency;
+    // Выполнение пачки целиком
+    StageHistogram batch_latency;
+};
+
+std::ostream& operator<<(std::ostream& out, const QueryServerStats& stats);
+
+// Начинает принимать соединения в конструкторе; search_server не должен меняться, пока фронтенд работает
+class QueryServer {
+public:
+    // system_error, если не удалось открыть сокет
+    explicit QueryServer(const SearchServer& search_server, const QueryServerOptions& options = {});
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    ~QueryServer();
+
+    uint16_t GetPort() const {
+        return port_;
+    }
+
+    QueryServerStats GetStats() const;
+
+    // Закрывает все соединения; ответы на ещё не выполненные запросы не отправляются.
+    // Вызывается из одного потока, повторный вызов ничего не делает
+    void Stop();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        // Ответы в порядке запросов; у первого уже отправлено output_offset байт
+        std::deque<std::string> output;
+        size_t output_offset = 0;
+        // Суммарная длина ответов в output
+        size_t output_size = 0;
+        size_t pending_requests = 0;
+        bool read_closed = false;
+        // Какие события сейчас запрошены у epoll
+        bool reading = true;
+        bool writing = false;
+    };
+
+    struct Request {
+        uint64_t connection_id;
+        std::string query;
+        Clock::time_point received;
+    };
+
+    void Run();
+    void Accept();
+    void Read(uint64_t connection_id);
+    // Переносит в пачку полные строки из входного буфера, пока соединение не перегружено
+    void ParseRequests(uint64_t connection_id, Connection& connection, Clock::time_point received);
+    bool IsOverloaded(const Connection& connection) const;
+    void ExecuteBatch();
+    void Flush(uint64_t connection_id);
+    void CloseIfDone(uint64_t connection_id);
+    void Close(uint64_t connection_id);
+    void UpdateEvents(uint64_t connection_id, Connection& connection);
+    void CloseDescriptors();
+
+    const SearchServer& search_server_;
+    const QueryServerOptions options_;
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    uint16_t port_ = 0;
+
+    // Всё ниже, кроме stats_, трогает только поток ввода-вывода
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_;
+    std::vector<Request> batch_;
+
+    mutable std::mutex stats_mutex_;
+    QueryServerStats stats_;
+
+    std::thread thread_;
+};
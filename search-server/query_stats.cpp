@@ -0,0 +1,203 @@
+#include "query_stats.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+struct AtomicHistogram {
+    atomic<uint64_t> count{ 0 };
+    atomic<uint64_t> total_ns{ 0 };
+    atomic<uint64_t> max_ns{ 0 };
+    array<atomic<uint64_t>, HISTOGRAM_BUCKET_COUNT> buckets{};
+};
+
+// Пишет в эти счётчики только владеющий поток, поэтому инкременты не требуют
+// атомарного read-modify-write; atomic нужен лишь для чтения снимка из чужого потока
+struct ThreadStats {
+    array<AtomicHistogram, QUERY_STAGE_COUNT> stages;
+    array<atomic<uint64_t>, QUERY_COUNTER_COUNT> counters{};
+};
+
+void Bump(atomic<uint64_t>& value, uint64_t delta) {
+    value.store(value.load(memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+size_t BucketIndex(uint64_t duration_ns) {
+    size_t index = 0;
+    while (duration_ns > 1 && index + 1 < HISTOGRAM_BUCKET_COUNT) {
+        duration_ns >>= 1;
+        ++index;
+    }
+    return index;
+}
+
+void Accumulate(QueryStats& to, const ThreadStats& from) {
+    for (size_t stage = 0; stage < QUERY_STAGE_COUNT; ++stage) {
+        StageHistogram& histogram = to.stages[stage];
+        const AtomicHistogram& source = from.stages[stage];
+        histogram.count += source.count.load(memory_order_relaxed);
+        histogram.total_ns += source.total_ns.load(memory_order_relaxed);
+        histogram.max_ns = max(histogram.max_ns, source.max_ns.load(memory_order_relaxed));
+        for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; ++bucket) {
+            histogram.buckets[bucket] += source.buckets[bucket].load(memory_order_relaxed);
+        }
+    }
+    for (size_t counter = 0; counter < QUERY_COUNTER_COUNT; ++counter) {
+        to.counters[counter] += from.counters[counter].load(memory_order_relaxed);
+    }
+}
+
+class StatsRegistry {
+public:
+    void Register(ThreadStats* stats) {
+        lock_guard guard(mutex_);
+        live_.push_back(stats);
+    }
+
+    // Статистика завершившегося потока переносится в retired_, чтобы потоки std::async не копились в реестре
+    void Retire(ThreadStats* stats) {
+        lock_guard guard(mutex_);
+        Accumulate(retired_, *stats);
+        live_.erase(remove(live_.begin(), live_.end(), stats), live_.end());
+    }
+
+    QueryStats Snapshot() {
+        lock_guard guard(mutex_);
+        QueryStats result = retired_;
+        for (const ThreadStats* stats : live_) {
+            Accumulate(result, *stats);
+        }
+        return result;
+    }
+
+    void Reset() {
+        lock_guard guard(mutex_);
+        retired_ = {};
+        for (ThreadStats* stats : live_) {
+            for (auto& stage : stats->stages) {
+                stage.count = 0;
+                stage.total_ns = 0;
+                stage.max_ns = 0;
+                for (auto& bucket : stage.buckets) {
+                    bucket = 0;
+                }
+            }
+            for (auto& counter : stats->counters) {
+                counter = 0;
+            }
+        }
+    }
+
+private:
+    mutex mutex_;
+    vector<ThreadStats*> live_;
+    QueryStats retired_;
+};
+
+StatsRegistry& Registry() {
+    static StatsRegistry registry;
+    return registry;
+}
+
+struct ThreadStatsHolder {
+    ThreadStatsHolder() {
+        Registry().Register(&stats);
+    }
+
+    ~ThreadStatsHolder() {
+        Registry().Retire(&stats);
+    }
+
+    ThreadStats stats;
+};
+
+ThreadStats& LocalStats() {
+    thread_local ThreadStatsHolder holder;
+    return holder.stats;
+}
+
+} // namespace
+
+void StageHistogram::Add(uint64_t duration_ns) {
+    ++count;
+    total_ns += duration_ns;
+    max_ns = max(max_ns, duration_ns);
+    ++buckets[BucketIndex(duration_ns)];
+}
+
+uint64_t StageHistogram::Percentile(double fraction) const {
+    if (count == 0) {
+        return 0;
+    }
+    const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank) {
+            return min(max_ns, (uint64_t{ 2 } << bucket) - 1);
+        }
+    }
+    return max_ns;
+}
+
+double StageHistogram::MeanNs() const {
+    return count == 0 ? 0.0 : static_cast<double>(total_ns) / count;
+}
+
+void RecordQueryStage(QueryStage stage, uint64_t duration_ns) {
+    AtomicHistogram& histogram = LocalStats().stages[static_cast<size_t>(stage)];
+    Bump(histogram.count, 1);
+    Bump(histogram.total_ns, duration_ns);
+    Bump(histogram.buckets[BucketIndex(duration_ns)], 1);
+    if (duration_ns > histogram.max_ns.load(memory_order_relaxed)) {
+        histogram.max_ns.store(duration_ns, memory_order_relaxed);
+    }
+}
+
+void AddQueryCounter(QueryCounter counter, uint64_t value) {
+    Bump(LocalStats().counters[static_cast<size_t>(counter)], value);
+}
+
+QueryStats GetQueryStats() {
+    return Registry().Snapshot();
+}
+
+void ResetQueryStats() {
+    Registry().Reset();
+}
+
+ostream& operator<<(ostream& out, QueryStage stage) {
+    switch (stage) {
+    case QueryStage::PARSE:
+        return out << "parse";
+    case QueryStage::POSTINGS:
+        return out << "postings";
+    case QueryStage::MINUS_FILTER:
+        return out << "minus_filter";
+    case QueryStage::TOP_K:
+        return out << "top_k";
+    case QueryStage::ASSEMBLY:
+        return out << "assembly";
+    }
+    return out;
+}
+
+ostream& operator<<(ostream& out, const QueryStats& stats) {
+    out << "queries = " << stats.Counter(QueryCounter::QUERIES)
+        << ", postings = " << stats.Counter(QueryCounter::POSTINGS_VISITED)
+        << ", minus postings = " << stats.Counter(QueryCounter::MINUS_POSTINGS_VISITED)
+        << ", matched = " << stats.Counter(QueryCounter::DOCUMENTS_MATCHED) << '\n';
+    for (size_t i = 0; i < QUERY_STAGE_COUNT; ++i) {
+        const StageHistogram& histogram = stats.stages[i];
+        out << static_cast<QueryStage>(i) << ": count = " << histogram.count
+            << ", mean = " << histogram.MeanNs() << " ns"
+            << ", p50 = " << histogram.Percentile(0.5) << " ns"
+            << ", p99 = " << histogram.Percentile(0.99) << " ns"
+            << ", max = " << histogram.max_ns << " ns" << '\n';
+    }
+    return out;
+}
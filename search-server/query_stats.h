@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Посэтапная статистика запросов. Собирается только при определённом SEARCH_SERVER_STATS,
+// иначе макросы QUERY_STAGE_* и QUERY_COUNTER_ADD раскрываются в пустоту.
+
+enum class QueryStage {
+    PARSE,
+    POSTINGS,
+    MINUS_FILTER,
+    TOP_K,
+    ASSEMBLY,
+};
+
+enum class QueryCounter {
+    QUERIES,
+    POSTINGS_VISITED,
+    MINUS_POSTINGS_VISITED,
+    DOCUMENTS_MATCHED,
+};
+
+constexpr size_t QUERY_STAGE_COUNT = 5;
+constexpr size_t QUERY_COUNTER_COUNT = 4;
+// Корзина i содержит длительности из [2^i, 2^(i+1)) нс
+constexpr size_t HISTOGRAM_BUCKET_COUNT = 48;
+
+struct StageHistogram {
+    uint64_t count = 0;
+    uint64_t total_ns = 0;
+    uint64_t max_ns = 0;
+    std::array<uint64_t, HISTOGRAM_BUCKET_COUNT> buckets{};
+
+    void Add(uint64_t duration_ns);
+
+    // Верхняя граница корзины, в которую попадает заданный перцентиль (0..1)
+    uint64_t Percentile(double fraction) const;
+    double MeanNs() const;
+};
+
+struct QueryStats {
+    std::array<StageHistogram, QUERY_STAGE_COUNT> stages;
+    std::array<uint64_t, QUERY_COUNTER_COUNT> counters{};
+
+    const StageHistogram& Stage(QueryStage stage) const {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    uint64_t Counter(QueryCounter counter) const {
+        return counters[static_cast<size_t>(counter)];
+    }
+};
+
+std::ostream& operator<<(std::ostream& out, QueryStage stage);
+std::ostream& operator<<(std::ostream& out, const QueryStats& stats);
+
+// Снимок суммирует гистограммы всех живых и завершившихся потоков процесса
+QueryStats GetQueryStats();
+void ResetQueryStats();
+
+void RecordQueryStage(QueryStage stage, uint64_t duration_ns);
+void AddQueryCounter(QueryCounter counter, uint64_t value);
+
+// Замеряет последовательные этапы одной функции: Switch закрывает текущий этап и открывает следующий,
+// деструктор закрывает последний
+class StageTimeline {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit StageTimeline(QueryStage stage)
+        : stage_(stage) {
+    }
+
+    StageTimeline(const StageTimeline&) = delete;
+    StageTimeline& operator=(const StageTimeline&) = delete;
+
+    ~StageTimeline() {
+        Stop();
+    }
+
+    void Switch(QueryStage next) {
+        Stop();
+        stage_ = next;
+        running_ = true;
+        start_time_ = Clock::now();
+    }
+
+    void Stop() {
+        if (running_) {
+            const auto duration = Clock::now() - start_time_;
+            RecordQueryStage(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+            running_ = false;
+        }
+    }
+
+private:
+    QueryStage stage_;
+    bool running_ = true;
+    Clock::time_point start_time_ = Clock::now();
+};
+
+#ifdef SEARCH_SERVER_STATS
+#define QUERY_STAGE_TIMER(stage) StageTimeline query_stage_timeline(stage)
+#define QUERY_STAGE_SWITCH(stage) query_stage_timeline.Switch(stage)
+#define QUERY_STAGE_STOP() query_stage_timeline.Stop()
+#define QUERY_COUNTER_ADD(counter, value) AddQueryCounter(counter, value)
+#else
+#define QUERY_STAGE_TIMER(stage) static_cast<void>(0)
+#define QUERY_STAGE_SWITCH(stage) static_cast<void>(0)
+#define QUERY_STAGE_STOP() static_cast<void>(0)
+#define QUERY_COUNTER_ADD(counter, value) static_cast<void>(0)
+#endif
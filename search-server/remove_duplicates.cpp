@@ -8,12 +8,10 @@ using namespace std;
 void RemoveDuplicates(SearchServer& search_server) {
 	set <int> id_dublicate_delete;
 	map<set<string>, int> set_words_in_document;
-	map<string, double>words_freq;	
 	for (const int document_id : search_server) {
 		set<string>words;
-		words_freq = search_server.GetWordFrequencies(document_id);
-		for (auto [word, freq] : words_freq) {
-			words.insert(word);
+		for (const auto& [word, freq] : search_server.GetWordFrequencies(document_id)) {
+			words.insert(string(word));
 		}
 		if (set_words_in_document.empty() || !set_words_in_document.count(words)) {
 			set_words_in_document.insert(std::make_pair(words, document_id));
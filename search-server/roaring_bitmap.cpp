@@ -0,0 +1,278 @@
+#include "roaring_bitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+using namespace std;
+
+bool RoaringBitmap::Container::Contains(uint16_t low) const {
+    if (!bits.empty()) {
+        return (bits[low >> 6] >> (low & 63)) & 1;
+    }
+    return binary_search(values.begin(), values.end(), low);
+}
+
+void RoaringBitmap::Container::Add(uint16_t low) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[low >> 6];
+        const uint64_t mask = uint64_t{ 1 } << (low & 63);
+        cardinality += (word & mask) == 0;
+        word |= mask;
+        return;
+    }
+    const auto it = lower_bound(values.begin(), values.end(), low);
+    if (it != values.end() && *it == low) {
+        return;
+    }
+    values.insert(it, low);
+    ++cardinality;
+    if (values.size() > ARRAY_LIMIT) {
+        ToBitmap();
+    }
+}
+
+void RoaringBitmap::Container::Remove(uint16_t low) {
+    if (!bits.empty()) {
+        uint64_t& word = bits[low >> 6];
+        const uint64_t mask = uint64_t{ 1 } << (low & 63);
+        cardinality -= (word & mask) != 0;
+        word &= ~mask;
+        Normalize();
+        return;
+    }
+    const auto it = lower_bound(values.begin(), values.end(), low);
+    if (it != values.end() && *it == low) {
+        values.erase(it);
+        --cardinality;
+    }
+}
+
+void RoaringBitmap::Container::ToBitmap() {
+    if (!bits.empty()) {
+        return;
+    }
+    bits.assign(BITMAP_WORDS, 0);
+    for (const uint16_t low : values) {
+        bits[low >> 6] |= uint64_t{ 1 } << (low & 63);
+    }
+    values.clear();
+    values.shrink_to_fit();
+}
+
+void RoaringBitmap::Container::Normalize() {
+    if (bits.empty() || cardinality > ARRAY_LIMIT) {
+        return;
+    }
+    values.clear();
+    values.reserve(cardinality);
+    for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+        for (uint64_t word_bits = bits[word]; word_bits != 0; word_bits &= word_bits - 1) {
+            values.push_back(static_cast<uint16_t>(word * 64 + __builtin_ctzll(word_bits)));
+        }
+    }
+    bits.clear();
+    bits.shrink_to_fit();
+}
+
+RoaringBitmap::Container RoaringBitmap::And(const Container& lhs, const Container& rhs, const allocator_type& allocator) {
+    Container result(allocator);
+    result.key = lhs.key;
+    if (lhs.bits.empty() || rhs.bits.empty()) {
+        // Хотя бы один — массив: результат не больше его
+        const Container& array = lhs.bits.empty() ? lhs : rhs;
+        const Container& other = lhs.bits.empty() ? rhs : lhs;
+        if (other.bits.empty()) {
+            set_intersection(array.values.begin(), array.values.end(), other.values.begin(), other.values.end(), back_inserter(result.values));
+        }
+        else {
+            copy_if(array.values.begin(), array.values.end(), back_inserter(result.values), [&other](uint16_t low) {
+                return other.Contains(low);
+            });
+        }
+        result.cardinality = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+    result.bits.resize(BITMAP_WORDS);
+    for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+        result.bits[word] = lhs.bits[word] & rhs.bits[word];
+        result.cardinality += __builtin_popcountll(result.bits[word]);
+    }
+    result.Normalize();
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::Or(const Container& lhs, const Container& rhs, const allocator_type& allocator) {
+    Container result(allocator);
+    result.key = lhs.key;
+    if (lhs.bits.empty() && rhs.bits.empty() && lhs.cardinality + rhs.cardinality <= ARRAY_LIMIT) {
+        set_union(lhs.values.begin(), lhs.values.end(), rhs.values.begin(), rhs.values.end(), back_inserter(result.values));
+        result.cardinality = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+    result = lhs;
+    result.ToBitmap();
+    if (rhs.bits.empty()) {
+        for (const uint16_t low : rhs.values) {
+            result.bits[low >> 6] |= uint64_t{ 1 } << (low & 63);
+        }
+    }
+    else {
+        for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+            result.bits[word] |= rhs.bits[word];
+        }
+    }
+    result.cardinality = 0;
+    for (const uint64_t word : result.bits) {
+        result.cardinality += __builtin_popcountll(word);
+    }
+    result.Normalize();
+    return result;
+}
+
+RoaringBitmap::Container RoaringBitmap::AndNot(const Container& lhs, const Container& rhs, const allocator_type& allocator) {
+    Container result(allocator);
+    result.key = lhs.key;
+    if (lhs.bits.empty()) {
+        copy_if(lhs.values.begin(), lhs.values.end(), back_inserter(result.values), [&rhs](uint16_t low) {
+            return !rhs.Contains(low);
+        });
+        result.cardinality = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+    result = lhs;
+    if (rhs.bits.empty()) {
+        for (const uint16_t low : rhs.values) {
+            result.bits[low >> 6] &= ~(uint64_t{ 1 } << (low & 63));
+        }
+    }
+    else {
+        for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+            result.bits[word] &= ~rhs.bits[word];
+        }
+    }
+    result.cardinality = 0;
+    for (const uint64_t word : result.bits) {
+        result.cardinality += __builtin_popcountll(word);
+    }
+    result.Normalize();
+    return result;
+}
+
+pmr::vector<RoaringBitmap::Container>::iterator RoaringBitmap::Find(uint16_t key) {
+    return lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t value) {
+        return container.key < value;
+    });
+}
+
+pmr::vector<RoaringBitmap::Container>::const_iterator RoaringBitmap::Find(uint16_t key) const {
+    return lower_bound(containers_.begin(), containers_.end(), key, [](const Container& container, uint16_t value) {
+        return container.key < value;
+    });
+}
+
+void RoaringBitmap::Add(uint32_t value) {
+    const auto key = static_cast<uint16_t>(value >> 16);
+    auto it = Find(key);
+    if (it == containers_.end() || it->key != key) {
+        it = containers_.insert(it, Container(containers_.get_allocator()));
+        it->key = key;
+    }
+    it->Add(static_cast<uint16_t>(value));
+}
+
+void RoaringBitmap::Remove(uint32_t value) {
+    const auto key = static_cast<uint16_t>(value >> 16);
+    const auto it = Find(key);
+    if (it == containers_.end() || it->key != key) {
+        return;
+    }
+    it->Remove(static_cast<uint16_t>(value));
+    if (it->cardinality == 0) {
+        containers_.erase(it);
+    }
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+    const auto key = static_cast<uint16_t>(value >> 16);
+    const auto it = Find(key);
+    return it != containers_.end() && it->key == key && it->Contains(static_cast<uint16_t>(value));
+}
+
+size_t RoaringBitmap::Cardinality() const {
+    size_t result = 0;
+    for (const auto& container : containers_) {
+        result += container.cardinality;
+    }
+    return result;
+}
+
+size_t RoaringBitmap::GetMemoryUsage() const {
+    size_t result = containers_.capacity() * sizeof(Container);
+    for (const auto& container : containers_) {
+        result += container.values.capacity() * sizeof(uint16_t) + container.bits.capacity() * sizeof(uint64_t);
+    }
+    return result;
+}
+
+RoaringBitmap& RoaringBitmap::operator&=(const RoaringBitmap& other) {
+    pmr::vector<Container> result(containers_.get_allocator());
+    auto lhs = containers_.begin();
+    auto rhs = other.containers_.begin();
+    while (lhs != containers_.end() && rhs != other.containers_.end()) {
+        if (lhs->key < rhs->key) {
+            ++lhs;
+        }
+        else if (rhs->key < lhs->key) {
+            ++rhs;
+        }
+        else {
+            Container container = And(*lhs, *rhs, containers_.get_allocator());
+            if (container.cardinality > 0) {
+                result.push_back(move(container));
+            }
+            ++lhs;
+            ++rhs;
+        }
+    }
+    containers_ = move(result);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator|=(const RoaringBitmap& other) {
+    pmr::vector<Container> result(containers_.get_allocator());
+    auto lhs = containers_.begin();
+    auto rhs = other.containers_.begin();
+    while (lhs != containers_.end() || rhs != other.containers_.end()) {
+        if (rhs == other.containers_.end() || (lhs != containers_.end() && lhs->key < rhs->key)) {
+            result.push_back(move(*lhs++));
+        }
+        else if (lhs == containers_.end() || rhs->key < lhs->key) {
+            result.push_back(*rhs++);
+        }
+        else {
+            result.push_back(Or(*lhs++, *rhs++, containers_.get_allocator()));
+        }
+    }
+    containers_ = move(result);
+    return *this;
+}
+
+RoaringBitmap& RoaringBitmap::operator-=(const RoaringBitmap& other) {
+    pmr::vector<Container> result(containers_.get_allocator());
+    auto rhs = other.containers_.begin();
+    for (auto& container : containers_) {
+        while (rhs != other.containers_.end() && rhs->key < container.key) {
+            ++rhs;
+        }
+        if (rhs == other.containers_.end() || rhs->key != container.key) {
+            result.push_back(move(container));
+            continue;
+        }
+        Container difference = AndNot(container, *rhs, containers_.get_allocator());
+        if (difference.cardinality > 0) {
+            result.push_back(move(difference));
+        }
+    }
+    containers_ = move(result);
+    return *this;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+// Сжатое множество 32-битных чисел в духе Roaring: числа делятся на контейнеры по старшим 16 битам,
+// контейнер хранит младшие биты отсортированным массивом, пока их не больше ARRAY_LIMIT,
+// и битовой картой на 2^16 бит — когда больше. Память контейнеров берётся из ресурса аллокатора:
+// в индексе — из ресурса сервера, у временных множеств запроса — из ресурса по умолчанию
+class RoaringBitmap {
+public:
+    using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+    explicit RoaringBitmap(const allocator_type& allocator = {})
+        : containers_(allocator) {
+    }
+
+    RoaringBitmap(const RoaringBitmap& other) = default;
+    RoaringBitmap(RoaringBitmap&& other) = default;
+
+    RoaringBitmap(const RoaringBitmap& other, const allocator_type& allocator)
+        : containers_(other.containers_, allocator) {
+    }
+
+    RoaringBitmap(RoaringBitmap&& other, const allocator_type& allocator)
+        : containers_(std::move(other.containers_), allocator) {
+    }
+
+    RoaringBitmap& operator=(const RoaringBitmap& other) = default;
+    RoaringBitmap& operator=(RoaringBitmap&& other) = default;
+
+    void Add(uint32_t value);
+    void Remove(uint32_t value);
+    bool Contains(uint32_t value) const;
+
+    bool empty() const {
+        return containers_.empty();
+    }
+
+    size_t Cardinality() const;
+    size_t GetMemoryUsage() const;
+
+    RoaringBitmap& operator&=(const RoaringBitmap& other);
+    RoaringBitmap& operator|=(const RoaringBitmap& other);
+    // Разность множеств
+    RoaringBitmap& operator-=(const RoaringBitmap& other);
+
+    // Обходит элементы по возрастанию
+    template <typename Callback>
+    void ForEach(Callback callback) const {
+        for (const auto& container : containers_) {
+            const uint32_t high = static_cast<uint32_t>(container.key) << 16;
+            if (container.bits.empty()) {
+                for (const uint16_t low : container.values) {
+                    callback(high | low);
+                }
+                continue;
+            }
+            for (size_t word = 0; word < BITMAP_WORDS; ++word) {
+                for (uint64_t bits = container.bits[word]; bits != 0; bits &= bits - 1) {
+                    callback(high | static_cast<uint32_t>(word * 64 + __builtin_ctzll(bits)));
+                }
+            }
+        }
+    }
+
+private:
+    static constexpr size_t ARRAY_LIMIT = 4096;
+    static constexpr size_t BITMAP_WORDS = (1 << 16) / 64;
+
+    struct Container {
+        using allocator_type = std::pmr::polymorphic_allocator<char>;
+
+        explicit Container(const allocator_type& allocator = {})
+            : values(allocator)
+            , bits(allocator) {
+        }
+
+        Container(const Container& other) = default;
+        Container(Container&& other) = default;
+
+        Container(const Container& other, const allocator_type& allocator)
+            : key(other.key)
+            , cardinality(other.cardinality)
+            , values(other.values, allocator)
+            , bits(other.bits, allocator) {
+        }
+
+        Container(Container&& other, const allocator_type& allocator)
+            : key(other.key)
+            , cardinality(other.cardinality)
+            , values(std::move(other.values), allocator)
+            , bits(std::move(other.bits), allocator) {
+        }
+
+        Container& operator=(const Container& other) = default;
+        Container& operator=(Container&& other) = default;
+
+        uint16_t key = 0;
+        uint32_t cardinality = 0;
+        // Ровно одно из представлений непусто
+        std::pmr::vector<uint16_t> values;
+        std::pmr::vector<uint64_t> bits;
+
+        bool Contains(uint16_t low) const;
+        void Add(uint16_t low);
+        void Remove(uint16_t low);
+        void ToBitmap();
+        // Переходит к массиву, если элементов стало мало
+        void Normalize();
+    };
+
+    static Container And(const Container& lhs, const Container& rhs, const allocator_type& allocator);
+    static Container Or(const Container& lhs, const Container& rhs, const allocator_type& allocator);
+    static Container AndNot(const Container& lhs, const Container& rhs, const allocator_type& allocator);
+
+    std::pmr::vector<Container>::iterator Find(uint16_t key);
+    std::pmr::vector<Container>::const_iterator Find(uint16_t key) const;
+
+    std::pmr::vector<Container> containers_;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+// Модели ранжирования для FindTopDocuments. Модель передаётся шаблонным параметром, так что цикл
+// по постингам специализируется при компиляции, без виртуальных вызовов. Prepare один раз на запрос
+// сводит статистику коллекции к постоянным модели; GetTermWeight вычисляется один раз на слово запроса,
+// Score — на каждый постинг. Постинг хранит TF — долю слова среди слов документа без стоп-слов
+
+struct CollectionStatistics {
+    size_t document_count = 0;
+    double average_document_length = 0.0;
+};
+
+// TF · IDF, IDF = log(N / df)
+struct TfIdfScorer {
+    struct Ranker {
+        // Score не читает длину документа, и её не нужно искать
+        static constexpr bool USES_DOCUMENT_LENGTH = false;
+
+        size_t document_count;
+
+        double GetTermWeight(size_t document_freq) const {
+            return std::log(document_count * 1.0 / document_freq);
+        }
+
+        double Score(double term_weight, double term_freq, uint32_t /*document_length*/) const {
+            return term_freq * term_weight;
+        }
+    };
+
+    Ranker Prepare(const CollectionStatistics& statistics) const {
+        return { statistics.document_count };
+    }
+};
+
+// Okapi BM25. Нормировка длины k1 · (1 - b + b · length / avgdl) раскладывается на две постоянные
+// запроса, так что на постинг остаются умножение, сложение и деление
+struct Bm25Scorer {
+    double k1 = 1.2;
+    double b = 0.75;
+
+    struct Ranker {
+        static constexpr bool USES_DOCUMENT_LENGTH = true;
+
+        size_t document_count;
+        double k1;
+        double constant_norm;
+        double length_norm;
+
+        double GetTermWeight(size_t document_freq) const {
+            return std::log(1.0 + (document_count - document_freq + 0.5) / (document_freq + 0.5));
+        }
+
+        double Score(double term_weight, double term_freq, uint32_t document_length) const {
+            const double count = term_freq * document_length;
+            return term_weight * count * (k1 + 1.0) / (count + constant_norm + length_norm * document_length);
+        }
+    };
+
+    Ranker Prepare(const CollectionStatistics& statistics) const {
+        const double average_length = statistics.average_document_length > 0.0 ? statistics.average_document_length : 1.0;
+        return { statistics.document_count, k1, k1 * (1.0 - b), k1 * b / average_length };
+    }
+};
+
+// Каждое совпавшее слово запроса даёт единицу: релевантность — число различных слов запроса в документе
+struct ConstantScorer {
+    struct Ranker {
+        static constexpr bool USES_DOCUMENT_LENGTH = false;
+
+        double GetTermWeight(size_t /*document_freq*/) const {
+            return 1.0;
+        }
+
+        double Score(double term_weight, double /*term_freq*/, uint32_t /*document_length*/) const {
+            return term_weight;
+        }
+    };
+
+    Ranker Prepare(const CollectionStatistics& /*statistics*/) const {
+        return {};
+    }
+};
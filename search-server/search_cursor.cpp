@@ -0,0 +1,49 @@
+#include "search_cursor.h"
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+
+bool IsRankedBefore(const Document& lhs, const Document& rhs) {
+    if (lhs.relevance != rhs.relevance) {
+        return lhs.relevance > rhs.relevance;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+SearchCursor::SearchCursor(const Document& last_document)
+    : last_document_(last_document) {
+}
+
+bool SearchCursor::IsBefore(const Document& document) const {
+    return IsRankedBefore(last_document_, document);
+}
+
+// Релевантность сохраняется побитово, чтобы курсор точно воспроизводил границу страницы
+string SearchCursor::ToString() const {
+    uint64_t relevance_bits = 0;
+    memcpy(&relevance_bits, &last_document_.relevance, sizeof(relevance_bits));
+    ostringstream out;
+    out << hex << relevance_bits << '.' << dec << last_document_.rating << '.' << last_document_.id;
+    return out.str();
+}
+
+SearchCursor SearchCursor::FromString(string_view text) {
+    istringstream in{ string(text) };
+    uint64_t relevance_bits = 0;
+    char first_dot = 0;
+    char second_dot = 0;
+    Document document;
+    in >> hex >> relevance_bits >> first_dot >> dec >> document.rating >> second_dot >> document.id;
+    if (!in || first_dot != '.' || second_dot != '.' || in.peek() != char_traits<char>::eof()) {
+        throw invalid_argument("Invalid search cursor");
+    }
+    memcpy(&document.relevance, &relevance_bits, sizeof(relevance_bits));
+    return SearchCursor(document);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "document.h"
+
+// Полный порядок выдачи: релевантность по убыванию, затем рейтинг по убыванию, затем id по возрастанию.
+// Им сортируют все поисковые методы, так что страницы FindPage совпадают с началом FindTopDocuments.
+// Релевантности сравниваются точно: сравнение с допуском нетранзитивно, и partial_sort с ним не определён,
+// а курсор мог бы пропускать или повторять документы с цепочкой близких релевантностей
+bool IsRankedBefore(const Document& lhs, const Document& rhs);
+
+// Непрозрачная позиция в выдаче: следующая страница начинается с документов, ранжированных после неё
+class SearchCursor {
+public:
+    explicit SearchCursor(const Document& last_document);
+
+    bool IsBefore(const Document& document) const;
+
+    std::string ToString() const;
+    static SearchCursor FromString(std::string_view text);
+
+private:
+    Document last_document_;
+};
+
+struct SearchPage {
+    std::vector<Document> documents;
+    // Пуст, если страница последняя
+    std::optional<SearchCursor> next;
+};
@@ -0,0 +1,47 @@
+#include "search_facets.h"
+
+#include <cstdint>
+
+using namespace std;
+
+void SearchFacets::Add(DocumentStatus status, int rating) {
+    ++total_hits;
+    ++status_counts[static_cast<size_t>(status)];
+    ++rating_histogram[GetRatingBucket(rating)];
+}
+
+void SearchFacets::Merge(const SearchFacets& other) {
+    total_hits += other.total_hits;
+    for (size_t i = 0; i < status_counts.size(); ++i) {
+        status_counts[i] += other.status_counts[i];
+    }
+    for (const auto& [bucket, count] : other.rating_histogram) {
+        rating_histogram[bucket] += count;
+    }
+}
+
+// Округление вниз, чтобы отрицательные рейтинги не попадали в корзину нуля
+int SearchFacets::GetRatingBucket(int rating) const {
+    const int64_t width = rating_bucket_width;
+    int64_t bucket = rating / width;
+    if (rating % width != 0 && rating < 0) {
+        --bucket;
+    }
+    return static_cast<int>(bucket * width);
+}
+
+ostream& operator<<(ostream& out, const SearchFacets& facets) {
+    static const char* const STATUS_NAMES[DOCUMENT_STATUS_COUNT] = { "actual", "irrelevant", "banned", "removed" };
+    out << "{ total = " << facets.total_hits;
+    for (size_t i = 0; i < DOCUMENT_STATUS_COUNT; ++i) {
+        out << ", " << STATUS_NAMES[i] << " = " << facets.status_counts[i];
+    }
+    out << ", ratings = {";
+    bool is_first = true;
+    for (const auto& [bucket, count] : facets.rating_histogram) {
+        out << (is_first ? " " : ", ") << bucket << ": " << count;
+        is_first = false;
+    }
+    out << " } }";
+    return out;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include "document.h"
+
+constexpr size_t DOCUMENT_STATUS_COUNT = 4;
+
+// Сводка по всем документам, подошедшим под запрос и предикат, а не только по вошедшим в выдачу
+struct SearchFacets {
+    // Корзина гистограммы с ключом r содержит рейтинги [r, r + rating_bucket_width)
+    int rating_bucket_width = 1;
+    size_t total_hits = 0;
+    // Индекс — DocumentStatus
+    std::array<size_t, DOCUMENT_STATUS_COUNT> status_counts{};
+    std::map<int, size_t> rating_histogram;
+
+    void Add(DocumentStatus status, int rating);
+    // Добавляет счётчики другой части того же запроса (с той же шириной корзины)
+    void Merge(const SearchFacets& other);
+
+    size_t GetStatusCount(DocumentStatus status) const {
+        return status_counts[static_cast<size_t>(status)];
+    }
+
+    int GetRatingBucket(int rating) const;
+};
+
+std::ostream& operator<<(std::ostream& out, const SearchFacets& facets);
+
+struct FacetedSearchResult {
+    std::vector<Document> documents;
+    SearchFacets facets;
+};
@@ -5,22 +5,86 @@
 #include <numeric>
 #include <string_view>
 
-SearchServer::SearchServer(const std::string& stop_words_text)
-	: SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const std::string& stop_words_text, const IndexOptions& options)
+	: SearchServer(SplitIntoWords(stop_words_text), options)
 {
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const
+SearchServer::WordFrequencies SearchServer::GetWordFrequencies(int document_id) const
 {
-	if (document_to_word_freqs_.count(document_id))
-	{
-		return document_to_word_freqs_.at(document_id);
+	return { forward_index_.GetTerms(document_id), term_words_.data() };
+}
+
+SearchPage SearchServer::FindPage(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size) const {
+	return FindPage(std::execution::seq, raw_query, DocumentStatus::ACTUAL, after, page_size);
+}
+
+PartialSearchResult SearchServer::FindTopDocuments(QueryContext& context, const QueryBudget& budget, const std::string_view raw_query, DocumentStatus status) const {
+	return FindTopDocuments(context, budget, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+		return document_status == status;
+		});
+}
+
+PartialSearchResult SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status, size_t max_postings) const {
+	return FindTopDocumentsByImpact(raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+		return document_status == status;
+		}, max_postings);
+}
+
+std::future<PartialSearchResult> SearchServer::FindTopDocumentsAsync(QueryExecutor& executor, std::string raw_query, QueryBudget budget, DocumentStatus status) const {
+	return FindTopDocumentsAsync(executor, std::move(raw_query), std::move(budget), [status](int document_id, DocumentStatus document_status, int rating) {
+		return document_status == status;
+		});
+}
+
+std::future<PartialSearchResult> SearchServer::FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentStatus status) const {
+	return FindTopDocumentsAsync(QueryExecutor::GetDefault(), std::move(raw_query), std::move(budget), status);
+}
+
+SearchServer::QueryTerms SearchServer::ParseQueryTerms(const std::string_view raw_query) const {
+	// Слова нужны и тем, кого нет в этом индексе: разбор используется внешними индексами
+	const auto query = ParseQuery(raw_query, false);
+	if (!query.phrases.empty() || !query.minus_phrases.empty() || !query.plus_prefixes.empty() || !query.minus_prefixes.empty()
+		|| !query.required_words.empty() || !query.any_of_groups.empty()) {
+		throw std::invalid_argument("Only plain and minus words are supported here");
+	}
+	return { { query.plus_words.begin(), query.plus_words.end() }, { query.minus_words.begin(), query.minus_words.end() } };
+}
+
+QueryStats SearchServer::GetStats() {
+	return GetQueryStats();
+}
+
+SearchServer::StoredDocument SearchServer::GetDocument(int document_id) const {
+	const auto& data = documents_.at(document_id);
+	return { texts_.Get(document_id), data.status, data.rating };
+}
+
+SearchServer::MemoryUsage SearchServer::GetMemoryUsage() const {
+	MemoryUsage usage;
+	usage.term_dictionary = term_dictionary_memory_.GetAllocatedBytes() + vocabulary_filter_.GetMemoryUsage();
+	usage.postings = postings_memory_.GetAllocatedBytes();
+	usage.forward_index = forward_index_memory_.GetAllocatedBytes();
+	usage.document_text = document_text_memory_.GetAllocatedBytes();
+	usage.metadata = metadata_memory_.GetAllocatedBytes();
+	usage.caches = texts_.GetCacheMemoryUsage();
+	for (const TrackingMemoryResource* resource : { &term_dictionary_memory_, &postings_memory_, &forward_index_memory_, &document_text_memory_, &metadata_memory_ }) {
+		usage.allocations += resource->GetAllocationCount();
 	}
-	else
-	{
-		static std::map<std::string_view, double> MapFrequencies;
-		return MapFrequencies;
+	return usage;
+}
+
+void SearchServer::Compact() {
+	std::vector<uint32_t> unused_term_ids;
+	for (const auto& [word, term_id] : words_) {
+		if (word_to_document_freqs_.count(word) == 0) {
+			unused_term_ids.push_back(term_id);
+		}
 	}
+	ReleaseTerms(unused_term_ids);
+	RebuildVocabularyFilter();
+	texts_.Compact();
+	next_compaction_usage_ = GetMemoryUsage().GetTotal() + options_.soft_memory_limit / 8;
 }
 
 int SearchServer::GetDocumentCount() const {
@@ -28,34 +92,112 @@ int SearchServer::GetDocumentCount() const {
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-	if (document_ids_.find(document_id) == document_ids_.end()) {
-		return;
+	RemoveDocument(std::execution::seq, document_id);
+}
+
+void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+	AddPreparedDocument(PrepareDocument(document_id, std::string{ document }, status, ratings));
+}
+
+SearchServer::PreparedDocument SearchServer::PrepareDocument(int document_id, std::string text, DocumentStatus status, const std::vector<int>& ratings) const {
+	if (document_id < 0) {
+		throw std::invalid_argument("Invalid document_id");
 	}
-	std::string word_remove;
-	for (auto& [word, id_freq] : word_to_document_freqs_) {
-		if (id_freq.find(document_id) != id_freq.end()) {
-			word_remove = word;
+	PreparedDocument document{ document_id, status, ComputeAverageRating(ratings), std::move(text), {} };
+	const std::string_view text_view = document.text;
+	uint32_t position = 0;
+	for (const std::string_view word : SplitIntoWords(text_view)) {
+		if (!IsValidWord(word)) {
+			throw std::invalid_argument("Word is invalid");
 		}
+		if (!IsStopWord(word)) {
+			document.words.push_back({ static_cast<uint32_t>(word.data() - text_view.data()), static_cast<uint32_t>(word.size()), position });
+		}
+		++position;
 	}
-	word_to_document_freqs_.erase(word_remove);
-	documents_.erase(document_id);
-	document_ids_.erase(document_id);
-	document_to_word_freqs_.erase(document_id);
+	return document;
 }
 
-void SearchServer::AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+void SearchServer::AddPreparedDocument(PreparedDocument document) {
+	const int document_id = document.document_id;
 	if ((document_id < 0) || (documents_.count(document_id) > 0)) {
 		throw std::invalid_argument("Invalid document_id");
 	}
-	const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ ComputeAverageRating(ratings), status, std::string{document} });
-	const auto words = SplitIntoWordsNoStop(it->second.text);
+	if (options_.hard_memory_limit != 0) {
+		// Проверяем до изменения индекса: отвергнутый документ не оставляет следов. Прирост оцениваем
+		// по отношению размера индекса к объёму текста уже добавленных документов
+		const auto would_exceed = [this, &document] {
+			const auto usage = GetMemoryUsage();
+			const size_t expected_growth = texts_.GetTextSize() == 0
+				? document.text.size()
+				: document.text.size() * usage.GetTotal() / texts_.GetTextSize();
+			return usage.GetTotal() + expected_growth > options_.hard_memory_limit;
+		};
+		if (would_exceed() && GetMemoryUsage().GetTotal() >= next_compaction_usage_) {
+			Compact();
+		}
+		if (would_exceed()) {
+			throw std::length_error("Memory budget exceeded: document " + std::to_string(document_id) + " rejected");
+		}
+	}
+	const auto [it, inserted] = documents_.emplace(document_id, DocumentData{ document.rating, document.status,
+		static_cast<uint32_t>(document.words.size()), std::pmr::vector<PreparedDocument::Token>(&forward_index_memory_) });
+	const std::string_view text = document.text;
 
-	const double inv_word_count = 1.0 / words.size();
-	for (std::string_view word : words) {
-		word_to_document_freqs_[word][document_id] += inv_word_count;
-		document_to_word_freqs_[document_id][word] += inv_word_count;
+	std::vector<std::pair<std::string_view, uint32_t>> positions;
+	std::vector<ForwardIndex::Entry> entries;
+	entries.reserve(document.words.size());
+	for (const auto& token : document.words) {
+		const uint32_t term_id = GetTermId(text.substr(token.offset, token.length));
+		entries.push_back({ term_id, 1 });
+		if (options_.store_positions) {
+			positions.push_back({ term_words_[term_id], token.position });
+		}
+	}
+	std::sort(entries.begin(), entries.end(), [](const ForwardIndex::Entry& lhs, const ForwardIndex::Entry& rhs) {
+		return lhs.term_id < rhs.term_id;
+		});
+	size_t unique_count = 0;
+	for (const auto& entry : entries) {
+		if (unique_count != 0 && entries[unique_count - 1].term_id == entry.term_id) {
+			++entries[unique_count - 1].count;
+		}
+		else {
+			entries[unique_count++] = entry;
+		}
+	}
+	entries.resize(unique_count);
+
+	const double inv_word_count = 1.0 / document.words.size();
+	for (const auto& entry : entries) {
+		const std::string_view word = term_words_[entry.term_id];
+		if (word_to_document_freqs_.count(word) == 0) {
+			AddToVocabularyFilter(word);
+		}
+		const double term_freq = entry.count * inv_word_count;
+		word_to_document_freqs_[word][document_id] = term_freq;
+		word_to_document_set_[word].Add(static_cast<uint32_t>(document_id));
+		if (options_.store_impacts) {
+			impacts_.AddPosting(word, document_id, term_freq);
+		}
+	}
+	forward_index_.AddDocument(document_id, entries, static_cast<uint32_t>(document.words.size()));
+	if (options_.store_positions) {
+		positions_.AddDocument(document_id, positions);
+	}
+	if (options_.store_offsets) {
+		it->second.tokens.assign(document.words.begin(), document.words.end());
 	}
 	document_ids_.insert(document_id);
+	total_word_count_ += document.words.size();
+	texts_.Add(document_id, document.text);
+
+	if (options_.soft_memory_limit != 0) {
+		const size_t usage = GetMemoryUsage().GetTotal();
+		if (usage > options_.soft_memory_limit && usage >= next_compaction_usage_) {
+			Compact();
+		}
+	}
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query) const {
@@ -69,7 +211,7 @@ std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_
 }
 
 SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::execution::parallel_policy&, const std::string_view raw_query, int document_id) const {
-	if (document_to_word_freqs_.count(document_id) == 0) {
+	if (documents_.count(document_id) == 0) {
 		throw std::out_of_range("There is no such id");
 	}
 	const auto query = ParseQuery(raw_query);
@@ -77,16 +219,20 @@ SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::execution::p
 	if (std::any_of(std::execution::par,
 		query.minus_words.begin(),
 		query.minus_words.end(),
-		[&](const std::string_view word) { return word_to_document_freqs_.at(std::string(word)).count(document_id); }
+		[&](const std::string_view word) { return DocumentContainsWord(word, document_id); }
 	)) {
 		return { matched_words, documents_.at(document_id).status };
 	}
+	if (!MatchesPhrases(query, document_id) || ContainsMinusPrefix(query, document_id) || !MatchesBooleanConstraints(query, document_id)) {
+		return { matched_words, documents_.at(document_id).status };
+	}
 	std::copy_if(std::execution::par,
 		query.plus_words.begin(),
 		query.plus_words.end(),
 		std::back_inserter(matched_words),
-		[&](const std::string_view word) { return word_to_document_freqs_.at(std::string(word)).count(document_id); }
+		[&](const std::string_view word) { return DocumentContainsWord(word, document_id); }
 	);
+	AppendPrefixMatches(query, document_id, matched_words);
 	matched_words.shrink_to_fit();
 	std::sort(matched_words.begin(), matched_words.end());
 	auto pos = std::unique(matched_words.begin(), matched_words.end());
@@ -95,7 +241,7 @@ SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::execution::p
 }
 
 SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const {
-	if (document_to_word_freqs_.count(document_id) == 0) {
+	if (documents_.count(document_id) == 0) {
 		throw std::out_of_range("There is no such id");
 	}
 	const auto query = ParseQuery(raw_query);
@@ -104,16 +250,24 @@ SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::execution::s
 	if (std::any_of(std::execution::seq,
 		query.minus_words.begin(),
 		query.minus_words.end(),
-		[&](const std::string_view& word) { return word_to_document_freqs_.at(std::string{ word }).count(document_id); }
+		[&](const std::string_view& word) { return DocumentContainsWord(word, document_id); }
 	)) {
 		return { matched_words, documents_.at(document_id).status };
 	}
+	if (!MatchesPhrases(query, document_id) || ContainsMinusPrefix(query, document_id) || !MatchesBooleanConstraints(query, document_id)) {
+		return { matched_words, documents_.at(document_id).status };
+	}
 	std::copy_if(std::execution::seq,
 		query.plus_words.begin(),
 		query.plus_words.end(),
 		std::back_inserter(matched_words),
-		[&](const std::string_view& word) { return word_to_document_freqs_.at(std::string{ word }).count(document_id); }
+		[&](const std::string_view& word) { return DocumentContainsWord(word, document_id); }
 	);
+	if (!query.plus_prefixes.empty()) {
+		AppendPrefixMatches(query, document_id, matched_words);
+		std::sort(matched_words.begin(), matched_words.end());
+		matched_words.erase(std::unique(matched_words.begin(), matched_words.end()), matched_words.end());
+	}
 	return { matched_words, documents_.at(document_id).status };
 }
 
@@ -121,8 +275,159 @@ SearchServer::MatchDocReturn SearchServer::MatchDocument(const std::string_view
 	return MatchDocument(std::execution::seq, raw_query, document_id);
 }
 
+std::vector<SearchServer::Snippet> SearchServer::GetSnippets(const std::string_view raw_query, const std::vector<int>& document_ids, size_t window) const {
+	if (!options_.store_offsets) {
+		throw std::invalid_argument("Snippets require an index with offsets");
+	}
+	if (window == 0) {
+		throw std::invalid_argument("Snippet window must be positive");
+	}
+	const auto query = ParseQuery(raw_query);
+	std::vector<std::pair<std::string_view, double>> query_weights;
+	for (const std::string_view word : query.plus_words) {
+		if (word_to_document_freqs_.count(word) != 0) {
+			query_weights.push_back({ word, ComputeWordInverseDocumentFreq(word) });
+		}
+	}
+	for (const std::string_view prefix : query.plus_prefixes) {
+		for (const auto& term : ExpandPrefix(prefix)) {
+			query_weights.push_back({ term->first, ComputeWordInverseDocumentFreq(term->first) });
+		}
+	}
+	std::sort(query_weights.begin(), query_weights.end());
+	query_weights.erase(std::unique(query_weights.begin(), query_weights.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.first == rhs.first;
+		}), query_weights.end());
+
+	std::vector<Snippet> snippets;
+	snippets.reserve(document_ids.size());
+	for (const int document_id : document_ids) {
+		snippets.push_back(BuildSnippet(document_id, query_weights, window));
+	}
+	return snippets;
+}
+
+SearchServer::Snippet SearchServer::BuildSnippet(int document_id, const std::vector<std::pair<std::string_view, double>>& query_weights, size_t window) const {
+	const auto document_it = documents_.find(document_id);
+	if (document_it == documents_.end()) {
+		throw std::out_of_range("There is no such id");
+	}
+	const auto& tokens = document_it->second.tokens;
+	const std::string text = texts_.Get(document_id);
+	if (tokens.empty()) {
+		return { document_id, {}, 0, {} };
+	}
+
+	// Вхождения слов запроса: индекс токена и индекс слова в query_weights
+	std::vector<std::pair<size_t, size_t>> hits;
+	for (size_t i = 0; i < tokens.size() && !query_weights.empty(); ++i) {
+		const std::string_view word = std::string_view(text).substr(tokens[i].offset, tokens[i].length);
+		const auto it = std::lower_bound(query_weights.begin(), query_weights.end(), word, [](const auto& weight, std::string_view value) {
+			return weight.first < value;
+			});
+		if (it != query_weights.end() && it->first == word) {
+			hits.push_back({ i, static_cast<size_t>(it - query_weights.begin()) });
+		}
+	}
+
+	// Скользящее окно по вхождениям: сумма IDF различных слов, при равенстве — больше вхождений
+	uint32_t first_position = tokens.front().position;
+	uint32_t last_position = first_position;
+	if (!hits.empty()) {
+		std::vector<uint32_t> counts(query_weights.size());
+		double score = 0.0;
+		double best_score = -1.0;
+		size_t best_hit_count = 0;
+		size_t first = 0;
+		for (size_t last = 0; last < hits.size(); ++last) {
+			if (counts[hits[last].second]++ == 0) {
+				score += query_weights[hits[last].second].second;
+			}
+			while (tokens[hits[last].first].position - tokens[hits[first].first].position >= window) {
+				if (--counts[hits[first].second] == 0) {
+					score -= query_weights[hits[first].second].second;
+				}
+				++first;
+			}
+			const size_t hit_count = last - first + 1;
+			if (score > best_score + 1e-9 || (score > best_score - 1e-9 && hit_count > best_hit_count)) {
+				best_score = score;
+				best_hit_count = hit_count;
+				first_position = tokens[hits[first].first].position;
+				last_position = tokens[hits[last].first].position;
+			}
+		}
+	}
+
+	// Добираем окно до window позиций поровну с обеих сторон, не выходя за границы документа
+	const uint32_t slack = static_cast<uint32_t>(window - 1) - (last_position - first_position);
+	uint32_t begin_position = first_position - std::min(first_position, slack / 2);
+	const uint32_t document_end = tokens.back().position;
+	if (begin_position + window - 1 > document_end) {
+		begin_position -= std::min<uint32_t>(begin_position, begin_position + window - 1 - document_end);
+	}
+	const uint32_t end_position = begin_position + static_cast<uint32_t>(window) - 1;
+	const auto by_position = [](const PreparedDocument::Token& token, uint32_t position) {
+		return token.position < position;
+	};
+	const size_t first_token = std::lower_bound(tokens.begin(), tokens.end(), begin_position, by_position) - tokens.begin();
+	const size_t last_token = std::lower_bound(tokens.begin(), tokens.end(), end_position + 1, by_position) - tokens.begin() - 1;
+
+	Snippet snippet;
+	snippet.document_id = document_id;
+	snippet.offset = tokens[first_token].offset;
+	snippet.text = text.substr(snippet.offset, tokens[last_token].offset + tokens[last_token].length - snippet.offset);
+	for (const auto& [token, word] : hits) {
+		if (token >= first_token && token <= last_token) {
+			snippet.highlights.push_back({ tokens[token].offset - snippet.offset, tokens[token].length });
+		}
+	}
+	return snippet;
+}
+
 bool SearchServer::IsStopWord(const std::string_view word) const {
-	return stop_words_.count(word) > 0;
+	return stop_words_.Contains(word);
+}
+
+void SearchServer::AddToVocabularyFilter(const std::string_view word) {
+	if (vocabulary_filter_.size() >= vocabulary_filter_.GetCapacity()) {
+		RebuildVocabularyFilter();
+	}
+	vocabulary_filter_.Insert(word);
+}
+
+uint32_t SearchServer::GetTermId(const std::string_view word) {
+	const auto it = words_.find(word);
+	if (it != words_.end()) {
+		return it->second;
+	}
+	uint32_t term_id = static_cast<uint32_t>(term_words_.size());
+	if (!free_term_ids_.empty()) {
+		term_id = free_term_ids_.back();
+		free_term_ids_.pop_back();
+	}
+	else {
+		term_words_.emplace_back();
+	}
+	term_words_[term_id] = words_.emplace(word, term_id).first->first;
+	return term_id;
+}
+
+void SearchServer::ReleaseTerms(const std::vector<uint32_t>& term_ids) {
+	for (const uint32_t term_id : term_ids) {
+		words_.erase(words_.find(term_words_[term_id]));
+		term_words_[term_id] = {};
+		free_term_ids_.push_back(term_id);
+	}
+}
+
+void SearchServer::RebuildVocabularyFilter() {
+	// Пересобираем с запасом; заодно выпадают слова удалённых документов
+	BloomFilter filter(std::max(MIN_VOCABULARY_FILTER_CAPACITY, word_to_document_freqs_.size() * 2));
+	for (const auto& [indexed_word, _] : word_to_document_freqs_) {
+		filter.Insert(indexed_word);
+	}
+	vocabulary_filter_ = std::move(filter);
 }
 
 bool SearchServer::IsValidWord(const std::string_view word) {
@@ -131,19 +436,6 @@ bool SearchServer::IsValidWord(const std::string_view word) {
 		});
 }
 
-std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view text) const {
-	std::vector<std::string_view> words;
-	for (const std::string_view word : SplitIntoWords(text)) {
-		if (!IsValidWord(word)) {
-			throw std::invalid_argument("Word is invalid");
-		}
-		if (!IsStopWord(word)) {
-			words.push_back(word);
-		}
-	}
-	return words;
-}
-
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
 	if (ratings.empty()) {
 		return 0;
@@ -168,11 +460,29 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
 	return { word, is_minus, IsStopWord(word) };
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const {
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, bool skip_unknown_words) const {
 	Query result;
-	for (const std::string_view word : SplitIntoWords(text)) {
+	const auto words = SplitIntoWords(text);
+	for (size_t i = 0; i < words.size(); ++i) {
+		const std::string_view word = words[i];
+		if (!word.empty() && (word[0] == '"' || (word.size() > 1 && word[0] == '-' && word[1] == '"'))) {
+			i = ParsePhrase(words, i, result);
+			continue;
+		}
+		if (!word.empty() && (word[0] == '+' || word.find('|') != std::string_view::npos)) {
+			ParseBooleanWord(word, result);
+			continue;
+		}
 		const auto query_word = ParseQueryWord(word);
-		if (!query_word.is_stop) {
+		if (query_word.data.back() == '*') {
+			const std::string_view prefix = query_word.data.substr(0, query_word.data.size() - 1);
+			if (prefix.empty()) {
+				throw std::invalid_argument("Query prefix is empty");
+			}
+			(query_word.is_minus ? result.minus_prefixes : result.plus_prefixes).push_back(prefix);
+			continue;
+		}
+		if (!query_word.is_stop && (!skip_unknown_words || vocabulary_filter_.MayContain(query_word.data))) {
 			if (query_word.is_minus) {
 				result.minus_words.insert(query_word.data);
 			}
@@ -184,6 +494,357 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
 	return result;
 }
 
+void SearchServer::ParseBooleanWord(std::string_view word, Query& query) const {
+	const bool is_required = word[0] == '+';
+	const bool is_minus = word[0] == '-';
+	if (is_required || is_minus) {
+		word.remove_prefix(1);
+	}
+	if (!word.empty() && (word[0] == '"' || word[0] == '+' || word[0] == '-')) {
+		throw std::invalid_argument("Query word is invalid");
+	}
+
+	std::vector<std::string_view> group;
+	for (size_t begin = 0; begin <= word.size();) {
+		const size_t end = std::min(word.find('|', begin), word.size());
+		const std::string_view part = word.substr(begin, end - begin);
+		const auto query_word = ParseQueryWord(part);
+		if (query_word.is_minus || part[0] == '+') {
+			throw std::invalid_argument("Query word is invalid");
+		}
+		if (part.back() == '*') {
+			throw std::invalid_argument("Prefixes are not supported in required words and groups");
+		}
+		if (!query_word.is_stop) {
+			group.push_back(query_word.data);
+		}
+		begin = end + 1;
+	}
+
+	if (is_minus) {
+		query.minus_words.insert(group.begin(), group.end());
+		return;
+	}
+	// Обязательные слова не отсеиваются фильтром словаря: неизвестное слово должно дать пустую выдачу
+	query.plus_words.insert(group.begin(), group.end());
+	if (group.size() == 1 && word.find('|') == std::string_view::npos) {
+		query.required_words.push_back(group.front());
+	}
+	else if (!group.empty()) {
+		query.any_of_groups.push_back(std::move(group));
+	}
+}
+
+const RoaringBitmap& SearchServer::GetDocumentSet(const std::string_view word) const {
+	static const RoaringBitmap EMPTY_SET;
+	const auto it = word_to_document_set_.find(word);
+	return it == word_to_document_set_.end() ? EMPTY_SET : it->second;
+}
+
+SearchServer::DocumentFilter SearchServer::BuildDocumentFilter(const Query& query, const QueryPlan& plan) const {
+	DocumentFilter filter;
+	for (const auto& term : plan.minus_terms) {
+		filter.excluded |= GetDocumentSet(term.word);
+	}
+	QUERY_COUNTER_ADD(QueryCounter::MINUS_POSTINGS_VISITED, filter.excluded.Cardinality());
+	if (query.required_words.empty() && query.any_of_groups.empty()) {
+		return filter;
+	}
+
+	std::vector<RoaringBitmap> constraints;
+	for (const std::string_view word : query.required_words) {
+		constraints.push_back(GetDocumentSet(word));
+	}
+	for (const auto& group : query.any_of_groups) {
+		RoaringBitmap any_of;
+		for (const std::string_view word : group) {
+			any_of |= GetDocumentSet(word);
+		}
+		constraints.push_back(std::move(any_of));
+	}
+	// Пересекаем от самого маленького множества: промежуточный результат сразу минимален
+	std::sort(constraints.begin(), constraints.end(), [](const RoaringBitmap& lhs, const RoaringBitmap& rhs) {
+		return lhs.Cardinality() < rhs.Cardinality();
+		});
+	filter.restricted = true;
+	filter.allowed = std::move(constraints.front());
+	for (size_t i = 1; i < constraints.size() && !filter.allowed.empty(); ++i) {
+		filter.allowed &= constraints[i];
+	}
+	filter.allowed -= filter.excluded;
+	return filter;
+}
+
+bool SearchServer::MatchesBooleanConstraints(const Query& query, int document_id) const {
+	const auto contains = [this, document_id](const std::string_view word) {
+		return DocumentContainsWord(word, document_id);
+	};
+	return std::all_of(query.required_words.begin(), query.required_words.end(), contains)
+		&& std::all_of(query.any_of_groups.begin(), query.any_of_groups.end(), [&contains](const std::vector<std::string_view>& group) {
+			return std::any_of(group.begin(), group.end(), contains);
+			});
+}
+
+size_t SearchServer::ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const {
+	if (!options_.store_positions) {
+		throw std::invalid_argument("Phrase queries require an index with positions");
+	}
+	std::string_view opening = words[first];
+	const bool is_minus = opening[0] == '-';
+	opening.remove_prefix(is_minus ? 2 : 1);
+
+	PositionalIndex::Phrase phrase;
+	size_t last = first;
+	for (;; ++last) {
+		if (last == words.size()) {
+			throw std::invalid_argument("Phrase is not closed");
+		}
+		std::string_view word = last == first ? opening : words[last];
+		const size_t quote = word.find('"');
+		const bool is_closing = quote != std::string_view::npos;
+		if (is_closing) {
+			const std::string_view suffix = word.substr(quote + 1);
+			word = word.substr(0, quote);
+			if (!suffix.empty()) {
+				if (suffix[0] != '~' || suffix.size() == 1
+					|| !std::all_of(suffix.begin() + 1, suffix.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+					throw std::invalid_argument("Invalid phrase proximity");
+				}
+				phrase.max_distance = std::stoi(std::string(suffix.substr(1)));
+			}
+		}
+		if (word.empty() && is_closing && last == first) {
+			throw std::invalid_argument("Phrase is empty");
+		}
+		if (!word.empty()) {
+			const auto query_word = ParseQueryWord(word);
+			if (query_word.is_minus) {
+				throw std::invalid_argument("Minus words are not allowed inside a phrase");
+			}
+			if (!query_word.is_stop) {
+				phrase.words.push_back(query_word.data);
+				phrase.offsets.push_back(static_cast<uint32_t>(last - first));
+			}
+		}
+		if (is_closing) {
+			break;
+		}
+	}
+
+	if (!phrase.words.empty()) {
+		if (is_minus) {
+			query.minus_phrases.push_back(std::move(phrase));
+		}
+		else {
+			query.plus_words.insert(phrase.words.begin(), phrase.words.end());
+			query.phrases.push_back(std::move(phrase));
+		}
+	}
+	return last;
+}
+
+bool SearchServer::MatchesPhrases(const Query& query, int document_id) const {
+	for (const auto& phrase : query.phrases) {
+		if (!positions_.MatchesPhrase(document_id, phrase)) {
+			return false;
+		}
+	}
+	for (const auto& phrase : query.minus_phrases) {
+		if (positions_.MatchesPhrase(document_id, phrase)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool SearchServer::SupportsQueryContext(const std::string_view raw_query) {
+	return FindContextRestriction(raw_query) == nullptr;
+}
+
+const char* SearchServer::FindContextRestriction(const std::string_view text) {
+	if (text.find('"') != std::string_view::npos) {
+		return "Phrase queries are not supported with QueryContext";
+	}
+	if (text.find("* ") != std::string_view::npos || (!text.empty() && text.back() == '*')) {
+		return "Prefix queries are not supported with QueryContext";
+	}
+	// Слова разделены пробелами: + в начале любого слова, | в любом месте
+	if ((!text.empty() && text.front() == '+') || text.find(" +") != std::string_view::npos || text.find('|') != std::string_view::npos) {
+		return "Required words and groups are not supported with QueryContext";
+	}
+	return nullptr;
+}
+
+void SearchServer::ParseQuery(QueryContext& context, const std::string_view text) const {
+	if (const char* restriction = FindContextRestriction(text)) {
+		throw std::invalid_argument(restriction);
+	}
+	context.tokens_.clear();
+	context.plus_terms_.clear();
+	context.minus_terms_.clear();
+	context.excluded_ids_.clear();
+	SplitIntoWords(text, context.tokens_);
+	for (const std::string_view word : context.tokens_) {
+		const auto query_word = ParseQueryWord(word);
+		if (query_word.is_stop || !vocabulary_filter_.MayContain(query_word.data)) {
+			continue;
+		}
+		const auto it = word_to_document_freqs_.find(query_word.data);
+		if (it == word_to_document_freqs_.end()) {
+			continue;
+		}
+		(query_word.is_minus ? context.minus_terms_ : context.plus_terms_).push_back(it);
+	}
+
+	const auto by_word = [](const auto& lhs, const auto& rhs) { return lhs->first < rhs->first; };
+	for (auto* terms : { &context.plus_terms_, &context.minus_terms_ }) {
+		std::sort(terms->begin(), terms->end(), by_word);
+		terms->erase(std::unique(terms->begin(), terms->end()), terms->end());
+	}
+
+	for (const auto& term : context.minus_terms_) {
+		for (const auto& [document_id, _] : term->second) {
+			context.excluded_ids_.push_back(document_id);
+		}
+	}
+	std::sort(context.excluded_ids_.begin(), context.excluded_ids_.end());
+	context.excluded_ids_.erase(std::unique(context.excluded_ids_.begin(), context.excluded_ids_.end()), context.excluded_ids_.end());
+}
+
+// Слова с префиксом идут в отсортированном словаре постингов подряд, начиная с lower_bound(prefix)
+std::vector<SearchServer::PostingIterator> SearchServer::ExpandPrefix(const std::string_view prefix) const {
+	std::vector<PostingIterator> terms;
+	auto it = word_to_document_freqs_.lower_bound(prefix);
+	while (it != word_to_document_freqs_.end() && it->first.substr(0, prefix.size()) == prefix && terms.size() < options_.max_prefix_expansions) {
+		terms.push_back(it++);
+	}
+	return terms;
+}
+
+bool SearchServer::ContainsMinusPrefix(const Query& query, int document_id) const {
+	for (const std::string_view prefix : query.minus_prefixes) {
+		for (const auto& term : ExpandPrefix(prefix)) {
+			if (term->second.count(document_id) > 0) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void SearchServer::AppendPrefixMatches(const Query& query, int document_id, std::vector<std::string_view>& matched_words) const {
+	for (const std::string_view prefix : query.plus_prefixes) {
+		for (const auto& term : ExpandPrefix(prefix)) {
+			if (term->second.count(document_id) > 0) {
+				matched_words.push_back(term->first);
+			}
+		}
+	}
+}
+
+bool SearchServer::DocumentContainsWord(const std::string_view word, int document_id) const {
+	const auto it = word_to_document_freqs_.find(word);
+	return it != word_to_document_freqs_.end() && it->second.count(document_id) > 0;
+}
+
 double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const {
 	return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.at(std::string(word)).size());
+}
+
+const std::pmr::map<int, double>& SearchServer::GetPostings(const std::string_view word) const {
+	return word_to_document_freqs_.find(word)->second;
+}
+
+double SearchServer::QueryPlan::GetEstimatedCost() const {
+	switch (strategy) {
+	case QueryStrategy::TERM_AT_A_TIME:
+		return term_at_a_time_cost;
+	case QueryStrategy::DOCUMENT_AT_A_TIME:
+		return document_at_a_time_cost;
+	case QueryStrategy::BITMAP_FIRST:
+		return bitmap_first_cost;
+	}
+	return 0.0;
+}
+
+SearchServer::QueryPlan SearchServer::ExplainQuery(const std::string_view raw_query) const {
+	return ExplainQuery(raw_query, TfIdfScorer{});
+}
+
+void SearchServer::ChooseStrategy(QueryPlan& plan, const DocumentFilter& filter, bool reads_document_length) const {
+	// Проход по плотному массиву аккумуляторов дешевле обработки постинга
+	static constexpr double ACCUMULATOR_SCAN_COST = 0.25;
+
+	const auto by_document_freq = [](const QueryPlan::Term& lhs, const QueryPlan::Term& rhs) {
+		return lhs.document_freq < rhs.document_freq;
+	};
+	std::stable_sort(plan.plus_terms.begin(), plan.plus_terms.end(), by_document_freq);
+	// Объединение начинается с самого большого множества: остальные вливаются в него
+	std::stable_sort(plan.minus_terms.rbegin(), plan.minus_terms.rend(), by_document_freq);
+
+	const double document_count = static_cast<double>(documents_.size());
+	plan.posting_count = 0;
+	for (const auto& term : plan.plus_terms) {
+		plan.posting_count += term.document_freq;
+	}
+	plan.candidate_count = filter.restricted ? filter.allowed.Cardinality() : documents_.size();
+
+	// Поиск метаданных документа в documents_
+	const double lookup_cost = std::log2(document_count + 1.0);
+	const double postings = static_cast<double>(plan.posting_count);
+	const double matched = std::min(postings, static_cast<double>(plan.candidate_count));
+	const double id_range = document_ids_.empty() ? 0.0 : static_cast<double>(*document_ids_.rbegin()) - *document_ids_.begin() + 1.0;
+	const double term_count = static_cast<double>(plan.plus_terms.size());
+
+	plan.term_at_a_time_cost = postings * (1.0 + (reads_document_length ? lookup_cost : 0.0))
+		+ id_range * ACCUMULATOR_SCAN_COST + matched * lookup_cost;
+	plan.document_at_a_time_cost = postings * (1.0 + std::log2(std::max(term_count, 2.0))) + matched * lookup_cost;
+	plan.bitmap_first_cost = std::numeric_limits<double>::infinity();
+	if (filter.restricted) {
+		const double average_postings = term_count == 0.0 ? 0.0 : postings / term_count;
+		plan.bitmap_first_cost = plan.candidate_count * (lookup_cost + term_count * std::log2(average_postings + 2.0));
+	}
+
+	plan.strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+	if (plan.term_at_a_time_cost < plan.GetEstimatedCost()) {
+		plan.strategy = QueryStrategy::TERM_AT_A_TIME;
+	}
+	if (plan.bitmap_first_cost < plan.GetEstimatedCost()) {
+		plan.strategy = QueryStrategy::BITMAP_FIRST;
+	}
+}
+
+std::ostream& operator<<(std::ostream& out, SearchServer::QueryStrategy strategy) {
+	switch (strategy) {
+	case SearchServer::QueryStrategy::TERM_AT_A_TIME:
+		return out << "term_at_a_time";
+	case SearchServer::QueryStrategy::DOCUMENT_AT_A_TIME:
+		return out << "document_at_a_time";
+	case SearchServer::QueryStrategy::BITMAP_FIRST:
+		return out << "bitmap_first";
+	}
+	return out;
+}
+
+std::ostream& operator<<(std::ostream& out, const SearchServer::QueryPlan& plan) {
+	const auto print_terms = [&out](const char* title, const std::vector<SearchServer::QueryPlan::Term>& terms) {
+		out << title << ':';
+		for (const auto& term : terms) {
+			out << ' ' << term.word << " (df = " << term.document_freq << ", weight = " << term.weight << ')';
+		}
+		out << '\n';
+	};
+	out << "strategy = " << plan.strategy << ", estimated cost = " << plan.GetEstimatedCost()
+		<< " (term_at_a_time = " << plan.term_at_a_time_cost
+		<< ", document_at_a_time = " << plan.document_at_a_time_cost
+		<< ", bitmap_first = " << plan.bitmap_first_cost << ")\n";
+	out << "postings = " << plan.posting_count << ", candidates = " << plan.candidate_count << '\n';
+	print_terms("plus", plan.plus_terms);
+	print_terms("zero weight", plan.zero_weight_terms);
+	print_terms("minus", plan.minus_terms);
+	return out;
+}
+
+CollectionStatistics SearchServer::GetCollectionStatistics() const {
+	return { documents_.size(), documents_.empty() ? 0.0 : total_word_count_ * 1.0 / documents_.size() };
 }
\ No newline at end of file
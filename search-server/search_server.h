@@ -5,33 +5,210 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <execution>
 #include <string_view>
 #include <functional>
 #include <type_traits>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <future>
+#include <numeric>
+#include <unordered_map>
+#include <memory_resource>
+#include <limits>
 
 #include "document.h"
 #include "string_processing.h"
-#include "concurrent_map.h"
+#include "query_stats.h"
+#include "positional_index.h"
+#include "impact_index.h"
+#include "perfect_hash_set.h"
+#include "bloom_filter.h"
+#include "roaring_bitmap.h"
+#include "search_cursor.h"
+#include "search_facets.h"
+#include "query_budget.h"
+#include "query_executor.h"
+#include "memory_tracking.h"
+#include "document_store.h"
+#include "forward_index.h"
+#include "scoring.h"
+#include "adaptive_execution.h"
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double ERROR_RATE_RELEVANCE = 1e-6;
+
+struct IndexOptions {
+	// Хранить позиции слов: без них не работают фразовые запросы "..." и запросы на близость "..."~N
+	bool store_positions = false;
+	// Сколько терминов словаря может раскрыть один префиксный терм запроса вида prefix*
+	size_t max_prefix_expansions = 64;
+	// Хранить постинги, упорядоченные по вкладу: нужны для FindTopDocumentsByImpact
+	bool store_impacts = false;
+	// Хранить смещения слов в тексте документа: нужны для GetSnippets
+	bool store_offsets = false;
+	// Мягкий предел памяти индекса в байтах (0 — нет предела): после его превышения AddDocument
+	// уплотняет словарь и сбрасывает кеши
+	size_t soft_memory_limit = 0;
+	// Жёсткий предел: документ, с которым он был бы превышен, отвергается с std::length_error
+	size_t hard_memory_limit = 0;
+	// Сколько распакованных блоков текстов документов держать в кеше
+	size_t text_cache_blocks = 16;
+	// Откуда контейнеры индекса берут память (nullptr — new/delete), например IndexArena. Должен пережить
+	// сервер и допускать освобождение из нескольких потоков: его делает RemoveDocument(par)
+	std::pmr::memory_resource* memory_resource = nullptr;
+};
 
 class SearchServer {
 public:
+	// Переиспользуемые буферы одного обслуживающего потока: после прогрева запрос
+	// через FindTopDocuments(QueryContext&, ...) не выделяет память в куче
+	class QueryContext {
+	private:
+		friend class SearchServer;
+
+		using PostingIterator = std::pmr::map<std::string_view, std::pmr::map<int, double>>::const_iterator;
+
+		struct Accumulator {
+			int document_id;
+			int term_index;
+			double relevance;
+		};
+
+		std::vector<std::string_view> tokens_;
+		std::vector<PostingIterator> plus_terms_;
+		std::vector<PostingIterator> minus_terms_;
+		std::vector<int> excluded_ids_;
+		std::vector<Accumulator> accumulators_;
+		std::vector<Document> results_;
+	};
+
 	template <typename StringContainer>
-	explicit SearchServer(const StringContainer& stop_words);
-	explicit SearchServer(const std::string& stop_words_text);
+	explicit SearchServer(const StringContainer& stop_words, const IndexOptions& options = {});
+	explicit SearchServer(const std::string& stop_words_text, const IndexOptions& options = {});
+
+	// Слова документа с их TF в порядке id терминов (не по алфавиту).
+	// Представление над прямым индексом, действительно до следующего изменения сервера
+	class WordFrequencies {
+	public:
+		class Iterator {
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = std::pair<std::string_view, double>;
+			using difference_type = std::ptrdiff_t;
+			using pointer = void;
+			using reference = value_type;
+
+			Iterator(const ForwardIndex::Entry* entry, const std::string_view* term_words, double inv_word_count)
+				: entry_(entry)
+				, term_words_(term_words)
+				, inv_word_count_(inv_word_count) {
+			}
+
+			value_type operator*() const {
+				return { term_words_[entry_->term_id], entry_->count * inv_word_count_ };
+			}
+
+			Iterator& operator++() {
+				++entry_;
+				return *this;
+			}
+
+			bool operator==(const Iterator& other) const {
+				return entry_ == other.entry_;
+			}
+
+			bool operator!=(const Iterator& other) const {
+				return entry_ != other.entry_;
+			}
+
+		private:
+			const ForwardIndex::Entry* entry_;
+			const std::string_view* term_words_;
+			double inv_word_count_;
+		};
+
+		WordFrequencies(ForwardIndex::Terms terms, const std::string_view* term_words)
+			: terms_(terms)
+			, term_words_(term_words) {
+		}
+
+		Iterator begin() const {
+			return { terms_.begin(), term_words_, GetInvWordCount() };
+		}
+
+		Iterator end() const {
+			return { terms_.end(), term_words_, GetInvWordCount() };
+		}
+
+		size_t size() const {
+			return terms_.size();
+		}
+
+		bool empty() const {
+			return terms_.empty();
+		}
+
+		// Число слов документа без стоп-слов, с повторами
+		uint32_t GetWordCount() const {
+			return terms_.GetWordCount();
+		}
+
+	private:
+		double GetInvWordCount() const {
+			return terms_.empty() ? 0.0 : 1.0 / terms_.GetWordCount();
+		}
+
+		ForwardIndex::Terms terms_;
+		const std::string_view* term_words_;
+	};
+
+	WordFrequencies GetWordFrequencies(int document_id) const;
+
+	const PerfectHashSet& GetStopWords() const {
+		return stop_words_;
+	}
 
-	const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+	// Исходный текст, статус и средний рейтинг документа; out_of_range, если документа нет
+	struct StoredDocument {
+		std::string text;
+		DocumentStatus status;
+		int rating;
+	};
+
+	StoredDocument GetDocument(int document_id) const;
+
+	// Память индекса по частям, в байтах. Контейнеры выделяют память через считающие ресурсы,
+	// так что получение разбивки не обходит индекс
+	struct MemoryUsage {
+		size_t term_dictionary = 0;
+		size_t postings = 0;
+		size_t forward_index = 0;
+		size_t document_text = 0;
+		size_t metadata = 0;
+		size_t caches = 0;
+		// Число выделений памяти контейнерами индекса с создания сервера; в GetTotal не входит
+		size_t allocations = 0;
+
+		size_t GetTotal() const {
+			return term_dictionary + postings + forward_index + document_text + metadata + caches;
+		}
+	};
+
+	MemoryUsage GetMemoryUsage() const;
 
-	std::set<int>::const_iterator  begin() const
+	// Убирает из словаря слова, оставшиеся без документов (например, после отвергнутого добавления),
+	// и пересобирает фильтр словаря по текущему размеру
+	void Compact();
+
+	std::pmr::set<int>::const_iterator begin() const
 	{
 		return document_ids_.begin();
 	}
 
-	std::set<int>::const_iterator end() const
+	std::pmr::set<int>::const_iterator end() const
 	{
 		return document_ids_.end();
 	}
@@ -43,6 +220,26 @@ public:
 
 	void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
 
+	// Документ, уже разобранный на слова. PrepareDocument не меняет индекс и может вызываться
+	// из нескольких потоков одновременно, AddPreparedDocument — только из пишущего
+	struct PreparedDocument {
+		struct Token {
+			uint32_t offset;
+			uint32_t length;
+			uint32_t position;
+		};
+
+		int document_id = 0;
+		DocumentStatus status = DocumentStatus::ACTUAL;
+		int rating = 0;
+		std::string text;
+		// Слова без стоп-слов; position учитывает и стоп-слова
+		std::vector<Token> words;
+	};
+
+	PreparedDocument PrepareDocument(int document_id, std::string text, DocumentStatus status, const std::vector<int>& ratings) const;
+	void AddPreparedDocument(PreparedDocument document);
+
 	template <typename DocumentPredicate>
 	std::vector<Document>FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
 		return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
@@ -52,7 +249,14 @@ public:
 	std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
 
 	template <typename DocumentPredicate, typename ExecutionPolicy>
-	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const;	
+	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+		return FindTopDocuments(policy, raw_query, document_predicate, TfIdfScorer{});
+	}
+
+	// Ранжирование моделью scorer из scoring.h (TfIdfScorer, Bm25Scorer, ConstantScorer или своей с тем же
+	// интерфейсом); остальные перегрузки ранжируют по TF-IDF
+	template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const;
 
 	template <typename ExecutionPolicy>
 	std::vector<Document> FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status) const {
@@ -66,8 +270,158 @@ public:
 		return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
 	}
 
+	// Страница выдачи, следующая за after (или первая). Размер страницы не ограничен MAX_RESULT_DOCUMENT_COUNT,
+	// а отбор ограничен page_size документами, ранжированными после курсора
+	template <typename DocumentPredicate, typename ExecutionPolicy>
+	SearchPage FindPage(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+		const std::optional<SearchCursor>& after, size_t page_size) const;
+
+	template <typename ExecutionPolicy>
+	SearchPage FindPage(ExecutionPolicy& policy, const std::string_view raw_query, DocumentStatus status,
+		const std::optional<SearchCursor>& after, size_t page_size) const {
+		return FindPage(policy, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+			return document_status == status;
+			}, after, page_size);
+	}
+
+	SearchPage FindPage(const std::string_view raw_query, const std::optional<SearchCursor>& after, size_t page_size) const;
+
+	// Выдача FindTopDocuments вместе со сводкой по всем подошедшим документам: числом совпадений,
+	// числом по статусам и гистограммой рейтинга. Сводка копится в том же проходе по постингам,
+	// у каждой параллельной части своя, и части складываются в конце
+	template <typename DocumentPredicate, typename ExecutionPolicy>
+	FacetedSearchResult FindTopDocumentsWithFacets(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+		int rating_bucket_width = 1) const;
+
+	template <typename DocumentPredicate>
+	FacetedSearchResult FindTopDocumentsWithFacets(const std::string_view raw_query, DocumentPredicate document_predicate, int rating_bucket_width = 1) const {
+		return FindTopDocumentsWithFacets(std::execution::seq, raw_query, document_predicate, rating_bucket_width);
+	}
+
+	// Можно ли выполнить запрос через перегрузки с QueryContext: фразы, префиксы, обязательные слова и группы
+	// они не разбирают и отвергают с invalid_argument
+	static bool SupportsQueryContext(const std::string_view raw_query);
+
+	// Результаты пишутся в out (подходит и указатель на массив вызывающего), возвращается итератор за последним
+	template <typename DocumentPredicate, typename OutputIt>
+	OutputIt FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, OutputIt out) const;
+
+	template <typename OutputIt>
+	OutputIt FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentStatus status, OutputIt out) const {
+		return FindTopDocuments(context, raw_query, [status](int document_id, DocumentStatus document_status, int rating) {
+			return document_status == status;
+			}, out);
+	}
+
+	template <typename OutputIt>
+	OutputIt FindTopDocuments(QueryContext& context, const std::string_view raw_query, OutputIt out) const {
+		return FindTopDocuments(context, raw_query, DocumentStatus::ACTUAL, out);
+	}
+
+	// Обход постингов прерывается, когда бюджет исчерпан; слова запроса обходятся от редких к частым,
+	// чтобы неполный результат опирался на самые значимые из них
+	template <typename DocumentPredicate>
+	PartialSearchResult FindTopDocuments(QueryContext& context, const QueryBudget& budget, const std::string_view raw_query, DocumentPredicate document_predicate) const;
+	PartialSearchResult FindTopDocuments(QueryContext& context, const QueryBudget& budget, const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+	// Вычисление по вкладу (score-at-a-time): блоки постингов всех слов запроса обходятся в порядке убывания
+	// верхней границы их вклада, пока top-K не перестанет зависеть от необойдённых блоков. Если раньше будет
+	// просмотрено max_postings постингов (0 — без ограничения), результат неполный. Требует
+	// IndexOptions::store_impacts; фразы и префиксы не поддерживаются
+	template <typename DocumentPredicate>
+	PartialSearchResult FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate, size_t max_postings = 0) const;
+	PartialSearchResult FindTopDocumentsByImpact(const std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL, size_t max_postings = 0) const;
+
+	// Запрос в пуле executor (по умолчанию — в общем пуле процесса), а не в собственном потоке: под нагрузкой
+	// число потоков не растёт. Сервер не должен меняться и разрушаться, пока результат не получен
+	template <typename DocumentPredicate>
+	std::future<PartialSearchResult> FindTopDocumentsAsync(QueryExecutor& executor, std::string raw_query, QueryBudget budget, DocumentPredicate document_predicate) const;
+	std::future<PartialSearchResult> FindTopDocumentsAsync(QueryExecutor& executor, std::string raw_query, QueryBudget budget, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+	template <typename DocumentPredicate>
+	std::future<PartialSearchResult> FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentPredicate document_predicate) const {
+		return FindTopDocumentsAsync(QueryExecutor::GetDefault(), std::move(raw_query), std::move(budget), document_predicate);
+	}
+	std::future<PartialSearchResult> FindTopDocumentsAsync(std::string raw_query, QueryBudget budget, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+	enum class QueryStrategy {
+		// Слова по очереди, вклады копятся в плотном массиве по id документа
+		TERM_AT_A_TIME,
+		// Постинги всех слов сливаются по id, каждый документ досчитывается и проверяется сразу
+		DOCUMENT_AT_A_TIME,
+		// Кандидаты — множество, заданное +словами и группами а|б; каждый проверяется по постингам слов
+		BITMAP_FIRST,
+	};
+
+	// План выполнения запроса. Стоимости — оценки в условных операциях над постингами;
+	// слова ссылаются в словарь сервера и действительны до его изменения
+	struct QueryPlan {
+		struct Term {
+			std::string_view word;
+			size_t document_freq;
+			double weight;
+		};
+
+		QueryStrategy strategy = QueryStrategy::DOCUMENT_AT_A_TIME;
+		// Плюс-слова и раскрытия префиксов от редких к частым
+		std::vector<Term> plus_terms;
+		// Слова с нулевым весом (при TF-IDF — есть во всех документах): их постинги не обходятся,
+		// а документы с ними добавляются с нулевой релевантностью, только если могут попасть в выдачу
+		std::vector<Term> zero_weight_terms;
+		// Минус-слова и раскрытия минус-префиксов от частых к редким
+		std::vector<Term> minus_terms;
+		// Сумма document_freq плюс-терминов
+		size_t posting_count = 0;
+		// Документы, разрешённые +словами и группами, или все документы
+		size_t candidate_count = 0;
+		double term_at_a_time_cost = 0.0;
+		double document_at_a_time_cost = 0.0;
+		// Бесконечность, если в запросе нет +слов и групп
+		double bitmap_first_cost = 0.0;
+
+		double GetEstimatedCost() const;
+	};
+
+	// План, по которому FindTopDocuments выполнил бы запрос с моделью scorer
+	QueryPlan ExplainQuery(const std::string_view raw_query) const;
+
+	template <typename Scorer>
+	QueryPlan ExplainQuery(const std::string_view raw_query, const Scorer& scorer) const;
+
 	int GetDocumentCount() const;
 
+	// Плюс- и минус-слова запроса (без стоп-слов, отсортированы и уникальны) для внешних индексов
+	// с тем же разбором; фразы и префиксы отвергаются
+	struct QueryTerms {
+		std::vector<std::string_view> plus_words;
+		std::vector<std::string_view> minus_words;
+	};
+
+	QueryTerms ParseQueryTerms(const std::string_view raw_query) const;
+
+	// Снимок посэтапной статистики FindTopDocuments; пуст, если сборка без SEARCH_SERVER_STATS
+	static QueryStats GetStats();
+
+	// Фрагмент документа вокруг слов запроса
+	struct Snippet {
+		struct Range {
+			uint32_t offset;
+			uint32_t length;
+		};
+
+		int document_id;
+		std::string text;
+		// Смещение text от начала документа
+		uint32_t offset;
+		// Слова запроса внутри text, смещения отсчитываются от начала text
+		std::vector<Range> highlights;
+	};
+
+	// Для каждого документа выбирает окно из window слов (считая стоп-слова) с наибольшей суммой IDF
+	// различных слов запроса; если слов запроса в документе нет, берётся начало документа.
+	// Документ заново не разбирается: используются смещения, сохранённые при индексации
+	std::vector<Snippet> GetSnippets(const std::string_view raw_query, const std::vector<int>& document_ids, size_t window = 20) const;
+
 	using MatchDocReturn = std::tuple<std::vector<std::string_view>, DocumentStatus>;
 	MatchDocReturn MatchDocument(const std::string_view raw_query, int document_id) const;
 	MatchDocReturn MatchDocument(const std::execution::sequenced_policy&, const std::string_view raw_query, int document_id) const;
@@ -78,19 +432,59 @@ private:
 	struct DocumentData {
 		int rating;
 		DocumentStatus status;
-		std::string text;
+		// Число слов без стоп-слов, с повторами: длина документа для моделей ранжирования
+		uint32_t word_count;
+		// Только при IndexOptions::store_offsets
+		std::pmr::vector<PreparedDocument::Token> tokens;
 	};
-	const std::set<std::string, std::less<>> stop_words_;
-	std::map<std::string_view, std::map<int, double>> word_to_document_freqs_;
-	std::map<int, DocumentData> documents_;
-	std::set<int> document_ids_;
-	std::map<int, std::map<std::string_view, double>> document_to_word_freqs_;
+	const PerfectHashSet stop_words_;
+	const IndexOptions options_;
+	// По ресурсу на каждую часть MemoryUsage; объявлены раньше контейнеров, чтобы пережить их
+	TrackingMemoryResource term_dictionary_memory_{ GetUpstreamResource(options_) };
+	TrackingMemoryResource postings_memory_{ GetUpstreamResource(options_) };
+	TrackingMemoryResource forward_index_memory_{ GetUpstreamResource(options_) };
+	TrackingMemoryResource document_text_memory_{ GetUpstreamResource(options_) };
+	TrackingMemoryResource metadata_memory_{ GetUpstreamResource(options_) };
+	// Ключи индексов ссылаются сюда, а не в текст документа: тексты хранятся сжатыми.
+	// Значение — id термина, по которому слово ищется в term_words_
+	std::pmr::map<std::pmr::string, uint32_t, std::less<>> words_{ &term_dictionary_memory_ };
+	std::pmr::vector<std::string_view> term_words_{ &term_dictionary_memory_ };
+	// id выброшенных слов — их занимают новые слова
+	std::pmr::vector<uint32_t> free_term_ids_{ &term_dictionary_memory_ };
+	std::pmr::map<std::string_view, std::pmr::map<int, double>> word_to_document_freqs_{ &postings_memory_ };
+	std::pmr::map<int, DocumentData> documents_{ &metadata_memory_ };
+	DocumentStore texts_{ options_.text_cache_blocks, &document_text_memory_ };
+	std::pmr::set<int> document_ids_{ &metadata_memory_ };
+	// Сумма word_count всех документов
+	size_t total_word_count_ = 0;
+	ForwardIndex forward_index_{ &forward_index_memory_ };
+	// Те же постинги в виде сжатых множеств документов — для булевых операций запроса
+	std::pmr::map<std::string_view, RoaringBitmap> word_to_document_set_{ &postings_memory_ };
+	PositionalIndex positions_{ &postings_memory_ };
+	ImpactIndex impacts_{ &postings_memory_ };
+	// Размер индекса, после которого мягкий предел снова запустит Compact
+	size_t next_compaction_usage_ = 0;
+	// Все проиндексированные слова (и, до пересборки, слова удалённых документов): позволяет
+	// отбросить незнакомые слова запроса, не обращаясь к словарю
+	BloomFilter vocabulary_filter_;
+
+	using PostingIterator = QueryContext::PostingIterator;
+
+	static std::pmr::memory_resource* GetUpstreamResource(const IndexOptions& options) {
+		return options.memory_resource != nullptr ? options.memory_resource : std::pmr::new_delete_resource();
+	}
 
 	bool IsStopWord(const std::string_view word) const;
 
-	static bool IsValidWord(const std::string_view word);
+	void AddToVocabularyFilter(const std::string_view word);
+	void RebuildVocabularyFilter();
+	// id слова в словаре; новое слово копируется в words_
+	uint32_t GetTermId(const std::string_view word);
+	// Выбрасывает слова из words_, их id занимают новые слова
+	void ReleaseTerms(const std::vector<uint32_t>& term_ids);
+	static constexpr size_t MIN_VOCABULARY_FILTER_CAPACITY = 1024;
 
-	std::vector<std::string_view> SplitIntoWordsNoStop(const std::string_view text) const;
+	static bool IsValidWord(const std::string_view word);
 
 	static int ComputeAverageRating(const std::vector<int>& ratings);
 
@@ -105,24 +499,139 @@ private:
 	struct Query {
 		std::set<std::string_view> plus_words;
 		std::set<std::string_view> minus_words;
+		std::vector<PositionalIndex::Phrase> phrases;
+		std::vector<PositionalIndex::Phrase> minus_phrases;
+		std::vector<std::string_view> plus_prefixes;
+		std::vector<std::string_view> minus_prefixes;
+		// +слово: документ обязан его содержать
+		std::vector<std::string_view> required_words;
+		// а|б|в: документ обязан содержать хотя бы одно слово группы
+		std::vector<std::vector<std::string_view>> any_of_groups;
 	};
 
-	Query ParseQuery(const std::string_view text) const;
+	// Ограничения запроса на множество документов, вычисленные операциями над битовыми картами
+	struct DocumentFilter {
+		// Есть обязательные слова или группы: подходят только allowed (исключённые из него уже вычтены)
+		bool restricted = false;
+		RoaringBitmap allowed;
+		RoaringBitmap excluded;
+
+		bool Allows(int document_id) const {
+			return restricted ? allowed.Contains(document_id) : !excluded.Contains(document_id);
+		}
+	};
+
+	// Незнакомые индексу слова отбрасываются, если skip_unknown_words
+	Query ParseQuery(const std::string_view text, bool skip_unknown_words = true) const;
+
+	// query_weights — IDF слов запроса, отсортированные по слову
+	Snippet BuildSnippet(int document_id, const std::vector<std::pair<std::string_view, double>>& query_weights, size_t window) const;
+
+	// Разбирает +слово или группу а|б (возможно, с минусом) в query
+	void ParseBooleanWord(std::string_view word, Query& query) const;
+
+	const RoaringBitmap& GetDocumentSet(const std::string_view word) const;
+	// Минус-термины объединяются в порядке плана
+	DocumentFilter BuildDocumentFilter(const Query& query, const QueryPlan& plan) const;
+	bool MatchesBooleanConstraints(const Query& query, int document_id) const;
+
+	// Релевантность только документов, прошедших ограничительный фильтр: каждый из них проверяется
+	// по постингам слов запроса, а не наоборот
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranker>
+	std::vector<Document> ScoreCandidates(ExecutionPolicy& policy, const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+		SearchFacets* facets) const;
+
+	// Разбирает фразу, начинающуюся со слова words[first]; возвращает индекс её последнего слова
+	size_t ParsePhrase(const std::vector<std::string_view>& words, size_t first, Query& query) const;
+
+	bool MatchesPhrases(const Query& query, int document_id) const;
+
+	std::vector<PostingIterator> ExpandPrefix(const std::string_view prefix) const;
+
+	bool ContainsMinusPrefix(const Query& query, int document_id) const;
+
+	void AppendPrefixMatches(const Query& query, int document_id, std::vector<std::string_view>& matched_words) const;
+
+	// Разбирает запрос в буферы контекста: термины сведены к итераторам индекса, исключённые id отсортированы
+	void ParseQuery(QueryContext& context, const std::string_view text) const;
+	// Почему запрос нельзя разобрать в QueryContext, или nullptr, если можно
+	static const char* FindContextRestriction(const std::string_view text);
+
+	// Возвращает false, если обход постингов прерван по бюджету
+	template <typename DocumentPredicate, typename OutputIt>
+	bool CollectTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, const QueryBudget* budget, OutputIt& out) const;
 
 	double ComputeWordInverseDocumentFreq(const std::string_view word) const;
 
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const Query& query, DocumentPredicate document_predicate) const {
-		return FindAllDocuments(std::execution::seq, query, document_predicate);
+	CollectionStatistics GetCollectionStatistics() const;
+
+	// Длина документа читается только моделями, которым она нужна
+	template <typename Ranker>
+	uint32_t GetDocumentLength(const DocumentData& document_data) const {
+		if constexpr (Ranker::USES_DOCUMENT_LENGTH) {
+			return document_data.word_count;
+		}
+		else {
+			return 0;
+		}
 	}
 
-	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const std::execution::sequenced_policy&, const Query& query, DocumentPredicate document_predicate) const;	
+	bool DocumentContainsWord(const std::string_view word, int document_id) const;
+
+	const std::pmr::map<int, double>& GetPostings(const std::string_view word) const;
+
+	// Документы, подходящие под запрос, по возрастанию id. Документы, найденные только словами с нулевым весом,
+	// добавляются, лишь если могут попасть в первые result_limit. С AdaptiveExecutionPolicy параллельность
+	// выбирается по стоимости плана и нагрузке. Если facets не nullptr, в них считается каждый подошедший документ
+	template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranker>
+	std::vector<Document> FindAllDocuments(ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate, const Ranker& ranker, size_t result_limit,
+		SearchFacets* facets = nullptr) const;
+
+	// part_count — на сколько частей делится обход; 1 — в вызывающем потоке
+	template <typename DocumentPredicate, typename Ranker>
+	std::vector<Document> ExecutePlan(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+		size_t result_limit, size_t part_count, SearchFacets* facets) const;
+
+	static constexpr size_t PARALLEL_PART_COUNT = 8;
+
+	static size_t GetPartCount(const std::execution::sequenced_policy&) {
+		return 1;
+	}
+
+	static size_t GetPartCount(const std::execution::parallel_policy&) {
+		return PARALLEL_PART_COUNT;
+	}
+
+	// Собирает термины плана, строит фильтр документов и выбирает стратегию
+	template <typename Ranker>
+	QueryPlan PlanQuery(const Query& query, const Ranker& ranker, DocumentFilter& filter) const;
+	void ChooseStrategy(QueryPlan& plan, const DocumentFilter& filter, bool reads_document_length) const;
+
+	// Отрезок id всех документов делится на part_count частей, которые считаются независимо;
+	// score_range(first_id, last_id, part_facets) возвращает документы отрезка по возрастанию id.
+	// Сводка каждой части копится отдельно и добавляется к facets после её завершения
+	template <typename RangeScorer>
+	std::vector<Document> ScoreByDocumentRanges(size_t part_count, SearchFacets* facets, RangeScorer score_range) const;
+
+	// Плюс-слова по очереди на отрезке id [first_id, last_id]: вклады копятся в плотном массиве,
+	// а документ проверяется фильтрами один раз, при сборке
+	template <typename DocumentPredicate, typename Ranker>
+	std::vector<Document> ScoreTermRange(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+		int first_id, int last_id, SearchFacets* facets) const;
+
+	// Слияние постингов плюс-слов на отрезке id [first_id, last_id]
+	template <typename DocumentPredicate, typename Ranker>
+	std::vector<Document> ScoreDocumentRange(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+		int first_id, int last_id, SearchFacets* facets) const;
 
 	template <typename DocumentPredicate>
-	std::vector<Document> FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const;
+	void AppendZeroWeightMatches(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate,
+		size_t result_limit, std::vector<Document>& matched_documents, SearchFacets* facets) const;
 };
 
+std::ostream& operator<<(std::ostream& out, SearchServer::QueryStrategy strategy);
+std::ostream& operator<<(std::ostream& out, const SearchServer::QueryPlan& plan);
+
 template<typename ExecutionPolicy>
 void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
 	auto it = document_ids_.find(document_id);
@@ -130,138 +639,660 @@ void SearchServer::RemoveDocument(ExecutionPolicy&& policy, int document_id) {
 		return;
 	}
 
-	auto& items = document_to_word_freqs_.at(document_id);
+	const auto terms = forward_index_.GetTerms(document_id);
 
-	std::vector< std::string_view> words(items.size());
-	std::transform(policy, items.begin(), items.end(), words.begin(), [](auto& p) { return &p.first; });
+	std::vector< std::string_view> words(terms.size());
+	std::transform(policy, terms.begin(), terms.end(), words.begin(), [this](const ForwardIndex::Entry& entry) { return term_words_[entry.term_id]; });
 
 	std::for_each(policy, words.begin(), words.end(),
 		[&](auto word) {
 			word_to_document_freqs_.at(word).erase(document_id);
 		}
 	);
+	// Слова, которых не осталось ни в одном документе; освобождаются последними, когда на них
+	// уже не ссылаются ни words, ни остальные индексы
+	std::vector<uint32_t> unused_term_ids;
+	for (const auto& entry : terms) {
+		const std::string_view word = term_words_[entry.term_id];
+		const auto set_it = word_to_document_set_.find(word);
+		set_it->second.Remove(document_id);
+		if (set_it->second.empty()) {
+			word_to_document_set_.erase(set_it);
+		}
+		const auto word_it = word_to_document_freqs_.find(word);
+		if (word_it->second.empty()) {
+			word_to_document_freqs_.erase(word_it);
+			unused_term_ids.push_back(entry.term_id);
+		}
+	}
+
+	if (options_.store_positions) {
+		positions_.RemoveDocument(document_id, words);
+	}
+	if (options_.store_impacts) {
+		const double inv_word_count = 1.0 / terms.GetWordCount();
+		for (const auto& entry : terms) {
+			impacts_.RemovePosting(term_words_[entry.term_id], document_id, entry.count * inv_word_count);
+		}
+	}
 
 	document_ids_.erase(document_id);
+	total_word_count_ -= terms.GetWordCount();
 	documents_.erase(document_id);
-	document_to_word_freqs_.erase(document_id);
+	texts_.Remove(document_id);
+	forward_index_.RemoveDocument(document_id);
+	ReleaseTerms(unused_term_ids);
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy, typename Scorer>
+std::vector<Document>SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const {
+	QUERY_COUNTER_ADD(QueryCounter::QUERIES, 1);
+	QUERY_STAGE_TIMER(QueryStage::PARSE);
+	const auto query = ParseQuery(raw_query);
+	QUERY_STAGE_STOP();
+
+	auto matched_documents = FindAllDocuments(policy, query, document_predicate, scorer.Prepare(GetCollectionStatistics()), MAX_RESULT_DOCUMENT_COUNT);
+	QUERY_COUNTER_ADD(QueryCounter::DOCUMENTS_MATCHED, matched_documents.size());
+
+	QUERY_STAGE_SWITCH(QueryStage::TOP_K);
+	const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+	std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), IsRankedBefore);
+	matched_documents.erase(top_end, matched_documents.end());
+	return matched_documents;
 }
 
 template <typename DocumentPredicate, typename ExecutionPolicy>
-std::vector<Document>SearchServer::FindTopDocuments(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+SearchPage SearchServer::FindPage(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+	const std::optional<SearchCursor>& after, size_t page_size) const {
+	if (page_size == 0) {
+		throw std::invalid_argument("Page size must be positive");
+	}
 	const auto query = ParseQuery(raw_query);
+	auto matched_documents = FindAllDocuments(policy, query, document_predicate, TfIdfScorer{}.Prepare(GetCollectionStatistics()),
+		std::numeric_limits<size_t>::max());
+	if (after) {
+		matched_documents.erase(
+			std::remove_if(matched_documents.begin(), matched_documents.end(),
+				[&after](const Document& document) { return !after->IsBefore(document); }),
+			matched_documents.end());
+	}
+
+	SearchPage page;
+	const bool has_next = matched_documents.size() > page_size;
+	const auto page_end = has_next ? matched_documents.begin() + page_size : matched_documents.end();
+	std::partial_sort(matched_documents.begin(), page_end, matched_documents.end(), IsRankedBefore);
+	page.documents.assign(matched_documents.begin(), page_end);
+	if (has_next) {
+		page.next = SearchCursor(page.documents.back());
+	}
+	return page;
+}
+
+template <typename DocumentPredicate, typename ExecutionPolicy>
+FacetedSearchResult SearchServer::FindTopDocumentsWithFacets(ExecutionPolicy& policy, const std::string_view raw_query, DocumentPredicate document_predicate,
+	int rating_bucket_width) const {
+	if (rating_bucket_width <= 0) {
+		throw std::invalid_argument("Rating bucket width must be positive");
+	}
+	QUERY_COUNTER_ADD(QueryCounter::QUERIES, 1);
+	QUERY_STAGE_TIMER(QueryStage::PARSE);
+	const auto query = ParseQuery(raw_query);
+	QUERY_STAGE_STOP();
+
+	FacetedSearchResult result;
+	result.facets.rating_bucket_width = rating_bucket_width;
+	// Сводке нужны все совпадения, в том числе найденные только словами с нулевым весом
+	auto matched_documents = FindAllDocuments(policy, query, document_predicate, TfIdfScorer{}.Prepare(GetCollectionStatistics()),
+		std::numeric_limits<size_t>::max(), &result.facets);
+	QUERY_COUNTER_ADD(QueryCounter::DOCUMENTS_MATCHED, matched_documents.size());
+
+	QUERY_STAGE_SWITCH(QueryStage::TOP_K);
+	const auto top_end = matched_documents.begin() + std::min<size_t>(matched_documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+	std::partial_sort(matched_documents.begin(), top_end, matched_documents.end(), IsRankedBefore);
+	matched_documents.erase(top_end, matched_documents.end());
+	result.documents = std::move(matched_documents);
+	return result;
+}
+
+template <typename DocumentPredicate, typename OutputIt>
+OutputIt SearchServer::FindTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, OutputIt out) const {
+	CollectTopDocuments(context, raw_query, document_predicate, nullptr, out);
+	return out;
+}
+
+template <typename DocumentPredicate>
+PartialSearchResult SearchServer::FindTopDocuments(QueryContext& context, const QueryBudget& budget, const std::string_view raw_query, DocumentPredicate document_predicate) const {
+	PartialSearchResult result;
+	auto out = std::back_inserter(result.documents);
+	result.partial = !CollectTopDocuments(context, raw_query, document_predicate, &budget, out);
+	return result;
+}
 
-	auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename DocumentPredicate>
+PartialSearchResult SearchServer::FindTopDocumentsByImpact(const std::string_view raw_query, DocumentPredicate document_predicate, size_t max_postings) const {
+	if (!options_.store_impacts) {
+		throw std::invalid_argument("Impact-ordered evaluation requires an index with impacts");
+	}
+	QUERY_COUNTER_ADD(QueryCounter::QUERIES, 1);
+	QUERY_STAGE_TIMER(QueryStage::PARSE);
+	const auto query = ParseQueryTerms(raw_query);
 
-	sort(policy, matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-		if (std::abs(lhs.relevance - rhs.relevance) < ERROR_RATE_RELEVANCE) {
-			return lhs.rating > rhs.rating;
+	QUERY_STAGE_SWITCH(QueryStage::MINUS_FILTER);
+	std::vector<int> excluded_ids;
+	for (const std::string_view word : query.minus_words) {
+		const auto it = word_to_document_freqs_.find(word);
+		if (it != word_to_document_freqs_.end()) {
+			QUERY_COUNTER_ADD(QueryCounter::MINUS_POSTINGS_VISITED, it->second.size());
+			for (const auto [document_id, _] : it->second) {
+				excluded_ids.push_back(document_id);
+			}
 		}
-		else {
-			return lhs.relevance > rhs.relevance;
+	}
+	std::sort(excluded_ids.begin(), excluded_ids.end());
+
+	QUERY_STAGE_SWITCH(QueryStage::POSTINGS);
+	struct ImpactBlock {
+		double impact;
+		size_t word_index;
+		const ImpactIndex::Block* block;
+	};
+	std::vector<ImpactBlock> blocks;
+	std::vector<std::string_view> words;
+	std::vector<double> inverse_document_freqs;
+	for (const std::string_view word : query.plus_words) {
+		const auto* word_blocks = impacts_.GetBlocks(word);
+		if (word_blocks == nullptr) {
+			continue;
 		}
+		const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
+		for (const auto& [level, block] : *word_blocks) {
+			blocks.push_back({ block.max_term_freq * inverse_document_freq, words.size(), &block });
+		}
+		words.push_back(word);
+		inverse_document_freqs.push_back(inverse_document_freq);
+	}
+	// Блоки одного слова уже упорядочены по убыванию вклада, устойчивая сортировка это сохраняет
+	std::stable_sort(blocks.begin(), blocks.end(), [](const auto& lhs, const auto& rhs) {
+		return lhs.impact > rhs.impact;
 		});
-	if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-		matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+
+	// Сколько ещё может добавить к релевантности каждое слово: вклад его первого необойдённого блока
+	std::vector<double> word_bounds(words.size(), 0.0);
+	std::vector<double> next_bounds(blocks.size(), 0.0);
+	for (size_t i = blocks.size(); i-- > 0;) {
+		next_bounds[i] = word_bounds[blocks[i].word_index];
+		word_bounds[blocks[i].word_index] = blocks[i].impact;
 	}
-	return matched_documents;
-}
 
-template <typename DocumentPredicate>
-std::vector<Document>SearchServer::FindAllDocuments(const std::execution::sequenced_policy&, const SearchServer::Query& query, DocumentPredicate document_predicate) const {
-	std::map<int, double> document_to_relevance;
-
-	for_each(query.plus_words.begin(), query.plus_words.end(),
-		[this, &document_predicate, &document_to_relevance](const std::string_view& word) {
-			if (word_to_document_freqs_.count(std::string(word)) != 0) {
-				const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-				for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-					const auto& document_data = documents_.at(document_id);
-					if (document_predicate(document_id, document_data.status, document_data.rating)) {
-						document_to_relevance[document_id] += term_freq * inverse_document_freq;
-					}
+	// Для каждого документа запоминаем, чьи слова уже учтены: добавить он может лишь вклады остальных
+	struct Accumulator {
+		double relevance = 0.0;
+		uint64_t counted_words = 0;
+	};
+	std::unordered_map<int, Accumulator> accumulators;
+	std::vector<std::pair<double, double>> bounds;
+	double last_kth_relevance = -1.0;
+	size_t postings_visited = 0;
+	bool budget_spent = false;
+	bool top_stable = false;
+	for (size_t i = 0; i < blocks.size() && !budget_spent && !top_stable; ++i) {
+		const auto& [impact, word_index, block] = blocks[i];
+		const double inverse_document_freq = inverse_document_freqs[word_index];
+		const uint64_t word_bit = word_index < 64 ? uint64_t{ 1 } << word_index : 0;
+		for (const auto [document_id, term_freq] : block->postings) {
+			if (max_postings != 0 && postings_visited == max_postings) {
+				budget_spent = true;
+				break;
+			}
+			++postings_visited;
+			if (std::binary_search(excluded_ids.begin(), excluded_ids.end(), document_id)) {
+				continue;
+			}
+			const auto& document_data = documents_.at(document_id);
+			if (document_predicate(document_id, document_data.status, document_data.rating)) {
+				auto& accumulator = accumulators[document_id];
+				accumulator.relevance += term_freq * inverse_document_freq;
+				accumulator.counted_words |= word_bit;
+			}
+		}
+		word_bounds[word_index] = next_bounds[i];
+
+		// top-K устойчив, если его худший документ уже не ниже верхней границы любого другого,
+		// в том числе ещё не встреченного. Пока остаток больше известного K-го значения, проверяем лишь изредка
+		const double remaining = std::accumulate(word_bounds.begin(), word_bounds.end(), 0.0);
+		if (remaining == 0.0 || accumulators.size() < MAX_RESULT_DOCUMENT_COUNT
+			|| (remaining >= last_kth_relevance && i % 8 != 0)) {
+			continue;
+		}
+		bounds.clear();
+		for (const auto& [document_id, accumulator] : accumulators) {
+			double upper_bound = accumulator.relevance;
+			for (size_t word = 0; word < words.size(); ++word) {
+				if (word >= 64 || (accumulator.counted_words >> word & 1) == 0) {
+					upper_bound += word_bounds[word];
 				}
 			}
+			bounds.push_back({ accumulator.relevance, upper_bound });
+		}
+		const auto kth = bounds.begin() + (MAX_RESULT_DOCUMENT_COUNT - 1);
+		std::nth_element(bounds.begin(), kth, bounds.end(), std::greater<>());
+		last_kth_relevance = kth->first;
+		double outsider_bound = remaining;
+		for (auto it = kth + 1; it != bounds.end(); ++it) {
+			outsider_bound = std::max(outsider_bound, it->second);
+		}
+		top_stable = last_kth_relevance >= outsider_bound;
+	}
+	QUERY_COUNTER_ADD(QueryCounter::POSTINGS_VISITED, postings_visited);
+
+	QUERY_STAGE_SWITCH(QueryStage::TOP_K);
+	PartialSearchResult result;
+	result.partial = budget_spent;
+	auto& documents = result.documents;
+	for (const auto& [document_id, accumulator] : accumulators) {
+		documents.push_back({ document_id, accumulator.relevance, documents_.at(document_id).rating });
+	}
+	auto top_end = documents.begin() + std::min<size_t>(documents.size(), MAX_RESULT_DOCUMENT_COUNT);
+	std::partial_sort(documents.begin(), top_end, documents.end(), IsRankedBefore);
+	documents.erase(top_end, documents.end());
+
+	// Отобранные документы досчитываются точно, в порядке слов запроса, как в FindTopDocuments
+	QUERY_STAGE_SWITCH(QueryStage::ASSEMBLY);
+	for (auto& document : documents) {
+		document.relevance = 0.0;
+		for (size_t i = 0; i < words.size(); ++i) {
+			const auto& postings = word_to_document_freqs_.at(words[i]);
+			const auto posting = postings.find(document.id);
+			if (posting != postings.end()) {
+				document.relevance += posting->second * inverse_document_freqs[i];
+			}
+		}
+	}
+	std::sort(documents.begin(), documents.end(), IsRankedBefore);
+	return result;
+}
+
+template <typename DocumentPredicate>
+std::future<PartialSearchResult> SearchServer::FindTopDocumentsAsync(QueryExecutor& executor, std::string raw_query, QueryBudget budget, DocumentPredicate document_predicate) const {
+	return executor.Submit([this, raw_query = std::move(raw_query), budget = std::move(budget), document_predicate] {
+		QueryContext context;
+		return FindTopDocuments(context, budget, raw_query, document_predicate);
 		});
+}
+
+template <typename DocumentPredicate, typename OutputIt>
+bool SearchServer::CollectTopDocuments(QueryContext& context, const std::string_view raw_query, DocumentPredicate document_predicate, const QueryBudget* budget, OutputIt& out) const {
+	// Столько постингов обходится между проверками бюджета
+	static constexpr size_t POSTING_BLOCK_SIZE = 256;
+
+	QUERY_COUNTER_ADD(QueryCounter::QUERIES, 1);
+	QUERY_STAGE_TIMER(QueryStage::PARSE);
+	ParseQuery(context, raw_query);
+	if (budget) {
+		std::sort(context.plus_terms_.begin(), context.plus_terms_.end(), [](const auto& lhs, const auto& rhs) {
+			return std::pair(lhs->second.size(), lhs->first) < std::pair(rhs->second.size(), rhs->first);
+			});
+	}
 
-	for_each(query.minus_words.begin(), query.minus_words.end(),
-		[this, &document_to_relevance](const std::string_view& word) {
-			if (word_to_document_freqs_.count(std::string(word)) != 0) {
-				for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-					document_to_relevance.erase(document_id);
+	QUERY_STAGE_SWITCH(QueryStage::POSTINGS);
+	auto& accumulators = context.accumulators_;
+	accumulators.clear();
+	const auto& excluded_ids = context.excluded_ids_;
+	bool completed = !(budget && budget->IsExhausted());
+	// Счётчик общий для всех слов: бюджет проверяется и в запросе из многих коротких списков постингов
+	size_t block_left = POSTING_BLOCK_SIZE;
+	for (int term_index = 0; completed && term_index < static_cast<int>(context.plus_terms_.size()); ++term_index) {
+		const auto& postings = context.plus_terms_[term_index]->second;
+		QUERY_COUNTER_ADD(QueryCounter::POSTINGS_VISITED, postings.size());
+		const double inverse_document_freq = log(GetDocumentCount() * 1.0 / postings.size());
+		for (const auto [document_id, term_freq] : postings) {
+			if (budget && --block_left == 0) {
+				if (budget->IsExhausted()) {
+					completed = false;
+					break;
 				}
+				block_left = POSTING_BLOCK_SIZE;
 			}
+			if (std::binary_search(excluded_ids.begin(), excluded_ids.end(), document_id)) {
+				continue;
+			}
+			const auto& document_data = documents_.at(document_id);
+			if (document_predicate(document_id, document_data.status, document_data.rating)) {
+				accumulators.push_back({ document_id, term_index, term_freq * inverse_document_freq });
+			}
+		}
+	}
+
+	QUERY_STAGE_SWITCH(QueryStage::ASSEMBLY);
+	// Слагаемые одного документа суммируются в порядке слов запроса
+	std::sort(accumulators.begin(), accumulators.end(), [](const auto& lhs, const auto& rhs) {
+		return std::pair(lhs.document_id, lhs.term_index) < std::pair(rhs.document_id, rhs.term_index);
 		});
+	auto& results = context.results_;
+	results.clear();
+	for (const auto& accumulator : accumulators) {
+		if (!results.empty() && results.back().id == accumulator.document_id) {
+			results.back().relevance += accumulator.relevance;
+		}
+		else {
+			results.push_back({ accumulator.document_id, accumulator.relevance, documents_.at(accumulator.document_id).rating });
+		}
+	}
+	QUERY_COUNTER_ADD(QueryCounter::DOCUMENTS_MATCHED, results.size());
+
+	QUERY_STAGE_SWITCH(QueryStage::TOP_K);
+	const auto top_end = results.begin() + std::min<size_t>(results.size(), MAX_RESULT_DOCUMENT_COUNT);
+	std::partial_sort(results.begin(), top_end, results.end(), IsRankedBefore);
+	out = std::copy(results.begin(), top_end, out);
+	return completed;
+}
+
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranker>
+std::vector<Document> SearchServer::FindAllDocuments(ExecutionPolicy& policy, const Query& query, DocumentPredicate document_predicate, const Ranker& ranker, size_t result_limit,
+	SearchFacets* facets) const {
+	QUERY_STAGE_TIMER(QueryStage::MINUS_FILTER);
+	DocumentFilter filter;
+	const auto plan = PlanQuery(query, ranker, filter);
+	QUERY_STAGE_STOP();
+	if constexpr (std::is_same_v<std::decay_t<ExecutionPolicy>, AdaptiveExecutionPolicy>) {
+		const auto lease = policy.Acquire(plan.GetEstimatedCost());
+		return ExecutePlan(plan, query, filter, document_predicate, ranker, result_limit, lease.GetParallelism(), facets);
+	}
+	else {
+		return ExecutePlan(plan, query, filter, document_predicate, ranker, result_limit, GetPartCount(policy), facets);
+	}
+}
+
+template <typename DocumentPredicate, typename Ranker>
+std::vector<Document> SearchServer::ExecutePlan(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+	size_t result_limit, size_t part_count, SearchFacets* facets) const {
+	QUERY_STAGE_TIMER(QueryStage::POSTINGS);
+	std::vector<Document> matched_documents;
+	switch (plan.strategy) {
+	case QueryStrategy::TERM_AT_A_TIME:
+		QUERY_COUNTER_ADD(QueryCounter::POSTINGS_VISITED, plan.posting_count);
+		matched_documents = ScoreByDocumentRanges(part_count, facets, [&](int first_id, int last_id, SearchFacets* part_facets) {
+			return ScoreTermRange(plan, query, filter, document_predicate, ranker, first_id, last_id, part_facets);
+			});
+		break;
+	case QueryStrategy::DOCUMENT_AT_A_TIME:
+		QUERY_COUNTER_ADD(QueryCounter::POSTINGS_VISITED, plan.posting_count);
+		matched_documents = ScoreByDocumentRanges(part_count, facets, [&](int first_id, int last_id, SearchFacets* part_facets) {
+			return ScoreDocumentRange(plan, query, filter, document_predicate, ranker, first_id, last_id, part_facets);
+			});
+		break;
+	case QueryStrategy::BITMAP_FIRST:
+		matched_documents = part_count > 1
+			? ScoreCandidates(std::execution::par, plan, query, filter, document_predicate, ranker, facets)
+			: ScoreCandidates(std::execution::seq, plan, query, filter, document_predicate, ranker, facets);
+		break;
+	}
+
+	QUERY_STAGE_SWITCH(QueryStage::ASSEMBLY);
+	AppendZeroWeightMatches(plan, query, filter, document_predicate, result_limit, matched_documents, facets);
+	return matched_documents;
+}
+
+template <typename Ranker>
+SearchServer::QueryPlan SearchServer::PlanQuery(const Query& query, const Ranker& ranker, DocumentFilter& filter) const {
+	QueryPlan plan;
+	const auto add_plus_term = [&plan, &ranker](const std::string_view word, size_t document_freq) {
+		const double weight = ranker.GetTermWeight(document_freq);
+		(weight == 0.0 ? plan.zero_weight_terms : plan.plus_terms).push_back({ word, document_freq, weight });
+	};
+	for (const std::string_view word : query.plus_words) {
+		const auto it = word_to_document_freqs_.find(word);
+		if (it != word_to_document_freqs_.end()) {
+			add_plus_term(it->first, it->second.size());
+		}
+	}
+	for (const std::string_view prefix : query.plus_prefixes) {
+		for (const auto& term : ExpandPrefix(prefix)) {
+			add_plus_term(term->first, term->second.size());
+		}
+	}
+	for (const std::string_view word : query.minus_words) {
+		const auto it = word_to_document_freqs_.find(word);
+		if (it != word_to_document_freqs_.end()) {
+			plan.minus_terms.push_back({ it->first, it->second.size(), 0.0 });
+		}
+	}
+	for (const std::string_view prefix : query.minus_prefixes) {
+		for (const auto& term : ExpandPrefix(prefix)) {
+			plan.minus_terms.push_back({ term->first, term->second.size(), 0.0 });
+		}
+	}
+	filter = BuildDocumentFilter(query, plan);
+	ChooseStrategy(plan, filter, Ranker::USES_DOCUMENT_LENGTH);
+	return plan;
+}
+
+template <typename Scorer>
+SearchServer::QueryPlan SearchServer::ExplainQuery(const std::string_view raw_query, const Scorer& scorer) const {
+	const auto query = ParseQuery(raw_query);
+	DocumentFilter filter;
+	return PlanQuery(query, scorer.Prepare(GetCollectionStatistics()), filter);
+}
 
+template <typename RangeScorer>
+std::vector<Document> SearchServer::ScoreByDocumentRanges(size_t part_count, SearchFacets* facets, RangeScorer score_range) const {
+	if (document_ids_.empty()) {
+		return {};
+	}
+	const int64_t first_id = *document_ids_.begin();
+	const int64_t last_id = *document_ids_.rbegin();
+	if (part_count <= 1) {
+		return score_range(static_cast<int>(first_id), static_cast<int>(last_id), facets);
+	}
+	const int64_t part_length = (last_id - first_id) / static_cast<int64_t>(part_count) + 1;
+	// Частей не больше part_count, так что адреса сводок частей не меняются
+	std::vector<SearchFacets> part_facets;
+	if (facets != nullptr) {
+		SearchFacets empty_facets;
+		empty_facets.rating_bucket_width = facets->rating_bucket_width;
+		part_facets.resize(part_count, empty_facets);
+	}
+	std::vector<std::future<std::vector<Document>>> futures;
+	for (int64_t part_first = first_id; part_first <= last_id; part_first += part_length) {
+		const int64_t part_last = std::min(part_first + part_length - 1, last_id);
+		SearchFacets* const facets_of_part = facets != nullptr ? &part_facets[futures.size()] : nullptr;
+		futures.push_back(std::async([&score_range, part_first, part_last, facets_of_part] {
+			return score_range(static_cast<int>(part_first), static_cast<int>(part_last), facets_of_part);
+			}));
+	}
 	std::vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance) {
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+	for (size_t i = 0; i < futures.size(); ++i) {
+		const auto part_documents = futures[i].get();
+		matched_documents.insert(matched_documents.end(), part_documents.begin(), part_documents.end());
+		if (facets != nullptr) {
+			facets->Merge(part_facets[i]);
+		}
 	}
 	return matched_documents;
 }
 
-template <typename DocumentPredicate>
-std::vector<Document>SearchServer::FindAllDocuments(const std::execution::parallel_policy&, const Query& query, DocumentPredicate document_predicate) const {
-	static constexpr int MINUS_LOCK_COUNT = 8;
-	ConcurrentMap<int, int> minus_ids(MINUS_LOCK_COUNT);
-	for_each(
-		std::execution::par,
-		query.minus_words.begin(),
-		query.minus_words.end(),
-		[this, &minus_ids](const std::string_view word) {
-			if (word_to_document_freqs_.count(std::string(word))) {
-				for (const auto& document_freqs : word_to_document_freqs_.at(std::string(word))) {
-					minus_ids[document_freqs.first];
-				}
+template <typename DocumentPredicate, typename Ranker>
+std::vector<Document> SearchServer::ScoreTermRange(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+	int first_id, int last_id, SearchFacets* facets) const {
+	std::vector<double> relevances(static_cast<size_t>(static_cast<int64_t>(last_id) - first_id) + 1);
+	std::vector<bool> is_matched(relevances.size());
+	for (const auto& term : plan.plus_terms) {
+		const auto& postings = GetPostings(term.word);
+		const auto end = postings.upper_bound(last_id);
+		for (auto it = postings.lower_bound(first_id); it != end; ++it) {
+			const auto [document_id, term_freq] = *it;
+			uint32_t document_length = 0;
+			if constexpr (Ranker::USES_DOCUMENT_LENGTH) {
+				document_length = documents_.at(document_id).word_count;
 			}
+			relevances[document_id - first_id] += ranker.Score(term.weight, term_freq, document_length);
+			is_matched[document_id - first_id] = true;
 		}
-	);
+	}
 
-	auto minus = minus_ids.BuildOrdinaryMap();
-
-	static constexpr int PLUS_LOCK_COUNT = 100;
-	ConcurrentMap<int, double> document_to_relevance(PLUS_LOCK_COUNT);
-	static constexpr int PART_COUNT = 8;
-	const auto part_length = query.plus_words.size() / PART_COUNT;
-	auto part_begin = query.plus_words.begin();
-	auto part_end = next(part_begin, part_length);
-
-	std::vector<std::future<void>> futures;
-	for (int i = 0;
-		i < PART_COUNT;
-		++i, part_begin = part_end, part_end = (i == PART_COUNT - 1 ? query.plus_words.end() : next(part_begin, part_length))
-		) {
-		futures.push_back(std::async([this, part_begin, part_end, &document_predicate, &document_to_relevance, &minus] {
-			for_each(std::execution::par, part_begin, part_end, [this, &document_predicate, &document_to_relevance, &minus](std::string_view word)
-				{
-					if (word_to_document_freqs_.count(std::string(word))) {
-						const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-						for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-							const auto& document_data = documents_.at(document_id);
-							if (document_predicate(document_id, document_data.status, document_data.rating) && (minus.count(document_id) == 0)) {
-								document_to_relevance[document_id].ref_to_value += term_freq * inverse_document_freq;
-							}
-						}
-					}
-				});
-			}));
+	std::vector<Document> matched_documents;
+	for (size_t i = 0; i < relevances.size(); ++i) {
+		const int document_id = first_id + static_cast<int>(i);
+		if (!is_matched[i] || !filter.Allows(document_id)) {
+			continue;
+		}
+		const auto& document_data = documents_.at(document_id);
+		if (document_predicate(document_id, document_data.status, document_data.rating) && MatchesPhrases(query, document_id)) {
+			matched_documents.push_back({ document_id, relevances[i], document_data.rating });
+			if (facets != nullptr) {
+				facets->Add(document_data.status, document_data.rating);
+			}
+		}
 	}
+	return matched_documents;
+}
 
-	for (auto& stage : futures) {
-		stage.get();
+template <typename DocumentPredicate, typename Ranker>
+std::vector<Document> SearchServer::ScoreDocumentRange(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+	int first_id, int last_id, SearchFacets* facets) const {
+	using DocumentCursor = std::pmr::map<int, double>::const_iterator;
+	std::vector<DocumentCursor> cursors;
+	std::vector<DocumentCursor> ends;
+	std::vector<double> term_weights;
+	std::priority_queue<std::pair<int, size_t>, std::vector<std::pair<int, size_t>>, std::greater<>> heads;
+	for (const auto& term : plan.plus_terms) {
+		const auto& postings = GetPostings(term.word);
+		const auto begin = postings.lower_bound(first_id);
+		const auto end = postings.upper_bound(last_id);
+		if (begin != end) {
+			heads.push({ begin->first, cursors.size() });
+			cursors.push_back(begin);
+			ends.push_back(end);
+			term_weights.push_back(term.weight);
+		}
 	}
 
 	std::vector<Document> matched_documents;
-	for (const auto [document_id, relevance] : document_to_relevance.BuildOrdinaryMap()) {
-		matched_documents.push_back({ document_id, relevance, documents_.at(document_id).rating });
+	while (!heads.empty()) {
+		const int document_id = heads.top().first;
+		// Документ проверяется один раз, сколько бы слов запроса в нём ни было
+		const DocumentData* document_data = nullptr;
+		if (filter.Allows(document_id)) {
+			const auto& data = documents_.at(document_id);
+			if (document_predicate(document_id, data.status, data.rating) && MatchesPhrases(query, document_id)) {
+				document_data = &data;
+			}
+		}
+		double relevance = 0.0;
+		while (!heads.empty() && heads.top().first == document_id) {
+			const size_t index = heads.top().second;
+			heads.pop();
+			if (document_data != nullptr) {
+				relevance += ranker.Score(term_weights[index], cursors[index]->second, GetDocumentLength<Ranker>(*document_data));
+			}
+			if (++cursors[index] != ends[index]) {
+				heads.push({ cursors[index]->first, index });
+			}
+		}
+		if (document_data != nullptr) {
+			matched_documents.push_back({ document_id, relevance, document_data->rating });
+			if (facets != nullptr) {
+				facets->Add(document_data->status, document_data->rating);
+			}
+		}
 	}
 	return matched_documents;
 }
 
+template <typename ExecutionPolicy, typename DocumentPredicate, typename Ranker>
+std::vector<Document> SearchServer::ScoreCandidates(ExecutionPolicy& policy, const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate, const Ranker& ranker,
+	SearchFacets* facets) const {
+	std::vector<const std::pmr::map<int, double>*> postings;
+	for (const auto& term : plan.plus_terms) {
+		postings.push_back(&GetPostings(term.word));
+	}
+
+	std::vector<int> candidates;
+	filter.allowed.ForEach([&candidates](uint32_t document_id) {
+		candidates.push_back(static_cast<int>(document_id));
+		});
+	QUERY_COUNTER_ADD(QueryCounter::POSTINGS_VISITED, candidates.size() * postings.size());
+	// Отрицательная релевантность — документ отвергнут фильтром пользователя или фразами
+	std::vector<double> relevances(candidates.size());
+	std::transform(policy, candidates.begin(), candidates.end(), relevances.begin(), [&](int document_id) {
+		const auto& document_data = documents_.at(document_id);
+		if (!document_predicate(document_id, document_data.status, document_data.rating) || !MatchesPhrases(query, document_id)) {
+			return -1.0;
+		}
+		const uint32_t document_length = GetDocumentLength<Ranker>(document_data);
+		double relevance = 0.0;
+		for (size_t i = 0; i < postings.size(); ++i) {
+			const auto posting = postings[i]->find(document_id);
+			if (posting != postings[i]->end()) {
+				relevance += ranker.Score(plan.plus_terms[i].weight, posting->second, document_length);
+			}
+		}
+		return relevance;
+		});
+
+	std::vector<Document> matched_documents;
+	for (size_t i = 0; i < candidates.size(); ++i) {
+		if (relevances[i] >= 0.0) {
+			const auto& document_data = documents_.at(candidates[i]);
+			matched_documents.push_back({ candidates[i], relevances[i], document_data.rating });
+			if (facets != nullptr) {
+				facets->Add(document_data.status, document_data.rating);
+			}
+		}
+	}
+	return matched_documents;
+}
+
+template <typename DocumentPredicate>
+void SearchServer::AppendZeroWeightMatches(const QueryPlan& plan, const Query& query, const DocumentFilter& filter, DocumentPredicate document_predicate,
+	size_t result_limit, std::vector<Document>& matched_documents, SearchFacets* facets) const {
+	if (plan.zero_weight_terms.empty()) {
+		return;
+	}
+	// Документ с нулевой релевантностью уступает любому с релевантностью не меньше ERROR_RATE_RELEVANCE
+	const size_t relevant_count = std::count_if(matched_documents.begin(), matched_documents.end(), [](const Document& document) {
+		return document.relevance >= ERROR_RATE_RELEVANCE;
+		});
+	if (relevant_count >= result_limit) {
+		return;
+	}
+	RoaringBitmap documents;
+	for (const auto& term : plan.zero_weight_terms) {
+		documents |= GetDocumentSet(term.word);
+	}
+	const size_t scored_count = matched_documents.size();
+	size_t scored_index = 0;
+	documents.ForEach([&](uint32_t id) {
+		const int document_id = static_cast<int>(id);
+		while (scored_index < scored_count && matched_documents[scored_index].id < document_id) {
+			++scored_index;
+		}
+		if ((scored_index < scored_count && matched_documents[scored_index].id == document_id) || !filter.Allows(document_id)) {
+			return;
+		}
+		const auto& document_data = documents_.at(document_id);
+		if (document_predicate(document_id, document_data.status, document_data.rating) && MatchesPhrases(query, document_id)) {
+			matched_documents.push_back({ document_id, 0.0, document_data.rating });
+			if (facets != nullptr) {
+				facets->Add(document_data.status, document_data.rating);
+			}
+		}
+		});
+	std::inplace_merge(matched_documents.begin(), matched_documents.begin() + scored_count, matched_documents.end(),
+		[](const Document& lhs, const Document& rhs) {
+			return lhs.id < rhs.id;
+		});
+}
+
 template <typename StringContainer>
-SearchServer::SearchServer(const StringContainer& stop_words)
+SearchServer::SearchServer(const StringContainer& stop_words, const IndexOptions& options)
 	: stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+	, options_(options)
 {
 	if (!all_of(stop_words_.begin(), stop_words_.end(), IsValidWord)) {
 		throw std::invalid_argument("Some of stop words are invalid");
 	}
+	if (options_.hard_memory_limit != 0 && options_.soft_memory_limit > options_.hard_memory_limit) {
+		throw std::invalid_argument("Soft memory limit exceeds hard memory limit");
+	}
 }
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "segmented_search_server.h"
+
+#include <map>
+#include <mutex>
+
+using namespace std;
+
+SegmentedSearchServer::SegmentedSearchServer(const string& stop_words_text, const SegmentedIndexOptions& options)
+    : tokenizer_(stop_words_text)
+    , options_(options) {
+    Validate();
+    Start();
+}
+
+SegmentedSearchServer::~SegmentedSearchServer() {
+    {
+        lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    merge_cv_.notify_all();
+    if (merge_thread_.joinable()) {
+        merge_thread_.join();
+    }
+}
+
+void SegmentedSearchServer::Validate() const {
+    if (options_.memtable_max_documents == 0) {
+        throw invalid_argument("Memtable size must be positive");
+    }
+    if (options_.merge_factor < 2) {
+        throw invalid_argument("Merge factor must be at least 2");
+    }
+}
+
+void SegmentedSearchServer::Start() {
+    if (options_.background_merge) {
+        merge_thread_ = thread([this] { RunMerges(); });
+    }
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const string_view document, DocumentStatus status, const vector<int>& ratings) {
+    // Разбор — без блокировки, чтобы не задерживать запросы
+    const auto prepared = tokenizer_.PrepareDocument(document_id, string{ document }, status, ratings);
+    map<string_view, double> word_freqs;
+    const double inv_word_count = 1.0 / prepared.words.size();
+    for (const auto& token : prepared.words) {
+        word_freqs[string_view(prepared.text).substr(token.offset, token.length)] += inv_word_count;
+    }
+
+    unique_lock lock(mutex_);
+    if (document_ids_.count(document_id) > 0) {
+        throw invalid_argument("Invalid document_id");
+    }
+    memtable_.AddDocument({ document_id, prepared.rating, prepared.status, { word_freqs.begin(), word_freqs.end() } });
+    document_ids_.insert(document_id);
+    if (memtable_.GetDocumentCount() >= options_.memtable_max_documents) {
+        FreezeMemtable();
+        lock.unlock();
+        merge_cv_.notify_all();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id) {
+    unique_lock lock(mutex_);
+    if (document_ids_.erase(document_id) == 0) {
+        return;
+    }
+    if (memtable_.RemoveDocument(document_id)) {
+        return;
+    }
+    for (const auto& segment : segments_) {
+        if (segment->RemoveDocument(document_id)) {
+            if (find(merging_segments_.begin(), merging_segments_.end(), segment) != merging_segments_.end()) {
+                merging_deletions_.push_back(document_id);
+            }
+            break;
+        }
+    }
+    lock.unlock();
+    merge_cv_.notify_all();
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+    });
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+int SegmentedSearchServer::GetDocumentCount() const {
+    shared_lock lock(mutex_);
+    return static_cast<int>(document_ids_.size());
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const {
+    shared_lock lock(mutex_);
+    return segments_.size();
+}
+
+void SegmentedSearchServer::Flush() {
+    {
+        lock_guard lock(mutex_);
+        FreezeMemtable();
+    }
+    merge_cv_.notify_all();
+}
+
+void SegmentedSearchServer::WaitForMerges() {
+    unique_lock lock(mutex_);
+    if (options_.background_merge) {
+        merge_cv_.wait(lock, [this] {
+            return merging_segments_.empty() && SelectMergeCandidates().empty();
+        });
+        return;
+    }
+    while (true) {
+        merge_cv_.wait(lock, [this] {
+            return merging_segments_.empty();
+        });
+        auto candidates = SelectMergeCandidates();
+        if (candidates.empty()) {
+            return;
+        }
+        MergeSegments(lock, move(candidates));
+        merge_cv_.notify_all();
+    }
+}
+
+void SegmentedSearchServer::FreezeMemtable() {
+    if (memtable_.GetDocumentCount() == 0) {
+        return;
+    }
+    segments_.push_back(make_shared<FrozenSegment>(memtable_.GetLiveDocuments()));
+    memtable_ = MutableSegment{};
+}
+
+vector<SegmentedSearchServer::SegmentPtr> SegmentedSearchServer::SelectMergeCandidates() const {
+    // Сначала — сегменты, где накопилось много удалённых документов
+    for (const auto& segment : segments_) {
+        if (segment->GetDeletedDocumentCount() > segment->GetDocumentCount() * options_.max_deleted_ratio) {
+            return { segment };
+        }
+    }
+    // Уровень сегмента — логарифм его размера в памяти по основанию merge_factor; сливаем
+    // merge_factor сегментов самого мелкого заполненного уровня, так что каждый документ
+    // переписывается лишь логарифмическое число раз
+    map<int, vector<SegmentPtr>> levels;
+    for (const auto& segment : segments_) {
+        const double size = max<double>(1.0, segment->GetLiveDocumentCount() * 1.0 / options_.memtable_max_documents);
+        auto& level = levels[static_cast<int>(log(size) / log(options_.merge_factor))];
+        level.push_back(segment);
+        if (level.size() == options_.merge_factor) {
+            return level;
+        }
+    }
+    return {};
+}
+
+void SegmentedSearchServer::MergeSegments(unique_lock<shared_mutex>& lock, vector<SegmentPtr> candidates) {
+    merging_segments_ = candidates;
+    merging_deletions_.clear();
+    lock.unlock();
+
+    // Сегменты не меняются, кроме отметок об удалении, поэтому собираем новый без блокировки.
+    // string_view слов указывают в словари старых сегментов, которые живы, пока есть candidates
+    vector<SegmentDocument> documents;
+    for (const auto& segment : candidates) {
+        auto segment_documents = segment->GetLiveDocuments();
+        move(segment_documents.begin(), segment_documents.end(), back_inserter(documents));
+    }
+    auto merged = make_shared<FrozenSegment>(move(documents));
+
+    lock.lock();
+    for (const int document_id : merging_deletions_) {
+        merged->RemoveDocument(document_id);
+    }
+    segments_.erase(remove_if(segments_.begin(), segments_.end(), [&candidates](const SegmentPtr& segment) {
+        return find(candidates.begin(), candidates.end(), segment) != candidates.end();
+    }), segments_.end());
+    if (merged->GetLiveDocumentCount() > 0) {
+        segments_.push_back(move(merged));
+    }
+    merging_segments_.clear();
+    merging_deletions_.clear();
+}
+
+void SegmentedSearchServer::RunMerges() {
+    unique_lock lock(mutex_);
+    while (true) {
+        vector<SegmentPtr> candidates;
+        merge_cv_.wait(lock, [this, &candidates] {
+            if (stopping_) {
+                return true;
+            }
+            candidates = SelectMergeCandidates();
+            return !candidates.empty();
+        });
+        if (stopping_) {
+            return;
+        }
+        MergeSegments(lock, move(candidates));
+        merge_cv_.notify_all();
+    }
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "document.h"
+#include "index_segment.h"
+#include "search_cursor.h"
+#include "search_server.h"
+
+struct SegmentedIndexOptions {
+    // Сколько документов накапливается в изменяемом сегменте, прежде чем он будет заморожен
+    size_t memtable_max_documents = 10000;
+    // Сколько неизменяемых сегментов одного уровня размера сливается за раз
+    size_t merge_factor = 4;
+    // Сегмент, в котором удалено больше этой доли документов, переписывается без них
+    double max_deleted_ratio = 0.3;
+    // Сливать сегменты в фоновом потоке; иначе — только в WaitForMerges
+    bool background_merge = true;
+};
+
+// Индекс из небольшого изменяемого сегмента и неизменяемых сегментов с плоской раскладкой.
+// Запись дешёвая и идёт только в изменяемый сегмент, удаление из неизменяемых — отметкой.
+// Запрос обходит все сегменты с общими IDF и сливает результаты. Разбор документов и запросов
+// тот же, что у SearchServer; фразы и префиксные запросы не поддерживаются
+class SegmentedSearchServer {
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer& stop_words, const SegmentedIndexOptions& options = {});
+    explicit SegmentedSearchServer(const std::string& stop_words_text, const SegmentedIndexOptions& options = {});
+
+    SegmentedSearchServer(const SegmentedSearchServer&) = delete;
+    SegmentedSearchServer& operator=(const SegmentedSearchServer&) = delete;
+
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, const std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    void RemoveDocument(int document_id);
+
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+    // Число неизменяемых сегментов
+    size_t GetSegmentCount() const;
+
+    // Замораживает изменяемый сегмент, даже если он не заполнен
+    void Flush();
+    // Дожидается, пока не останется сегментов для слияния; без фонового потока сливает их сам
+    void WaitForMerges();
+
+private:
+    using SegmentPtr = std::shared_ptr<FrozenSegment>;
+
+    template <typename Callback>
+    void ForEachPosting(std::string_view word, Callback callback) const;
+
+    // Вызываются под уникальной блокировкой
+    void Validate() const;
+    void Start();
+    void FreezeMemtable();
+    std::vector<SegmentPtr> SelectMergeCandidates() const;
+    void MergeSegments(std::unique_lock<std::shared_mutex>& lock, std::vector<SegmentPtr> candidates);
+    void RunMerges();
+
+    const SearchServer tokenizer_;
+    const SegmentedIndexOptions options_;
+
+    mutable std::shared_mutex mutex_;
+    std::condition_variable_any merge_cv_;
+    MutableSegment memtable_;
+    std::vector<SegmentPtr> segments_;
+    std::set<int> document_ids_;
+
+    // Сегменты, которые сейчас сливаются, и удаления из них, случившиеся во время слияния
+    std::vector<SegmentPtr> merging_segments_;
+    std::vector<int> merging_deletions_;
+    bool stopping_ = false;
+    std::thread merge_thread_;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer& stop_words, const SegmentedIndexOptions& options)
+    : tokenizer_(stop_words)
+    , options_(options) {
+    Validate();
+    Start();
+}
+
+template <typename Callback>
+void SegmentedSearchServer::ForEachPosting(std::string_view word, Callback callback) const {
+    memtable_.ForEachPosting(word, callback);
+    for (const auto& segment : segments_) {
+        segment->ForEachPosting(word, callback);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate) const {
+    const auto query = tokenizer_.ParseQueryTerms(raw_query);
+
+    std::shared_lock lock(mutex_);
+    std::unordered_set<int> excluded_ids;
+    for (const std::string_view word : query.minus_words) {
+        ForEachPosting(word, [&excluded_ids](int document_id, double, DocumentStatus, int) {
+            excluded_ids.insert(document_id);
+        });
+    }
+
+    std::unordered_map<int, Document> matched_documents;
+    for (const std::string_view word : query.plus_words) {
+        size_t document_freq = memtable_.GetDocumentFreq(word);
+        for (const auto& segment : segments_) {
+            document_freq += segment->GetDocumentFreq(word);
+        }
+        if (document_freq == 0) {
+            continue;
+        }
+        const double inverse_document_freq = std::log(document_ids_.size() * 1.0 / document_freq);
+        ForEachPosting(word, [&](int document_id, double term_freq, DocumentStatus status, int rating) {
+            if (excluded_ids.count(document_id) > 0 || !document_predicate(document_id, status, rating)) {
+                return;
+            }
+            auto& document = matched_documents[document_id];
+            document.id = document_id;
+            document.rating = rating;
+            document.relevance += term_freq * inverse_document_freq;
+        });
+    }
+    lock.unlock();
+
+    std::vector<Document> results;
+    results.reserve(matched_documents.size());
+    for (const auto& [document_id, document] : matched_documents) {
+        results.push_back(document);
+    }
+    const auto top_end = results.begin() + std::min<size_t>(results.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(results.begin(), top_end, results.end(), IsRankedBefore);
+    results.erase(top_end, results.end());
+    return results;
+}
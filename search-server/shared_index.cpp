@@ -0,0 +1,282 @@
+#include "shared_index.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <system_error>
+
+#include "write_ahead_log.h"
+
+using namespace std;
+
+namespace {
+    // Смещение от начала образа и число элементов
+    struct Section {
+        uint64_t offset;
+        uint64_t size;
+    };
+
+    // Расположение образа. Порядок байтов — родной: образ читают процессы того же хоста.
+    // Сигнатура включает версию формата
+    struct Header {
+        char magic[8];
+        uint64_t image_size;
+        uint64_t document_count;
+        uint64_t total_word_count;
+        // uint64: начало каждого стоп-слова в stop_word_data и общий конец
+        Section stop_word_offsets;
+        Section stop_word_data;
+        // Слова по возрастанию, так же, как term_offsets
+        Section term_offsets;
+        Section term_data;
+        // uint64: начало постингов каждого слова и общий конец
+        Section posting_offsets;
+        // uint32: номер документа в массивах документов
+        Section posting_documents;
+        // uint32: сколько раз слово встречается в документе
+        Section posting_counts;
+        // Документы по возрастанию id
+        Section document_ids;
+        Section document_ratings;
+        Section document_statuses;
+        Section document_lengths;
+    };
+
+    const char SHARED_INDEX_MAGIC[8] = { 'S', 'S', 'H', 'I', 'D', 'X', '0', '1' };
+
+    template <typename T>
+    Section AppendSection(string& image, const vector<T>& values) {
+        // Все секции выровнены по 8 байт, отображение — по границе страницы
+        image.resize((image.size() + 7) / 8 * 8);
+        const Section section{ image.size(), values.size() };
+        image.append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+        return section;
+    }
+
+    template <typename T>
+    const T* GetSection(const void* image, size_t image_size, const Section& section, size_t expected_size) {
+        if (section.size != expected_size || section.offset % alignof(T) != 0 || section.offset > image_size
+            || section.size > (image_size - section.offset) / sizeof(T)) {
+            throw invalid_argument("Corrupted shared index section");
+        }
+        return reinterpret_cast<const T*>(static_cast<const char*>(image) + section.offset);
+    }
+
+    // Смещения должны возрастать от 0 до конца данных, иначе чтение выйдет за секцию
+    void CheckOffsets(const uint64_t* offsets, size_t count, uint64_t data_size) {
+        if (offsets[0] != 0 || offsets[count] != data_size || !is_sorted(offsets, offsets + count + 1)) {
+            throw invalid_argument("Corrupted shared index offsets");
+        }
+    }
+}
+
+void PublishSharedIndex(const SearchServer& server, const string& path) {
+    vector<uint64_t> stop_word_offsets{ 0 };
+    string stop_word_data;
+    for (const string& stop_word : server.GetStopWords()) {
+        stop_word_data += stop_word;
+        stop_word_offsets.push_back(stop_word_data.size());
+    }
+
+    // Номер документа в образе — его место по возрастанию id
+    vector<int32_t> document_ids;
+    vector<int32_t> document_ratings;
+    vector<uint8_t> document_statuses;
+    vector<uint32_t> document_lengths;
+    uint64_t total_word_count = 0;
+    map<string_view, vector<pair<uint32_t, uint32_t>>> word_postings;
+    for (const int document_id : server) {
+        const auto document_index = static_cast<uint32_t>(document_ids.size());
+        const auto document = server.GetDocument(document_id);
+        const auto word_freqs = server.GetWordFrequencies(document_id);
+        const uint32_t word_count = word_freqs.GetWordCount();
+        document_ids.push_back(document_id);
+        document_ratings.push_back(document.rating);
+        document_statuses.push_back(static_cast<uint8_t>(document.status));
+        document_lengths.push_back(word_count);
+        total_word_count += word_count;
+        for (const auto& [word, term_freq] : word_freqs) {
+            word_postings[word].emplace_back(document_index, static_cast<uint32_t>(lround(term_freq * word_count)));
+        }
+    }
+
+    vector<uint64_t> term_offsets{ 0 };
+    string term_data;
+    vector<uint64_t> posting_offsets{ 0 };
+    vector<uint32_t> posting_documents;
+    vector<uint32_t> posting_counts;
+    for (const auto& [word, postings] : word_postings) {
+        term_data += word;
+        term_offsets.push_back(term_data.size());
+        for (const auto& [document_index, count] : postings) {
+            posting_documents.push_back(document_index);
+            posting_counts.push_back(count);
+        }
+        posting_offsets.push_back(posting_documents.size());
+    }
+
+    Header header{};
+    memcpy(header.magic, SHARED_INDEX_MAGIC, sizeof(header.magic));
+    header.document_count = document_ids.size();
+    header.total_word_count = total_word_count;
+    string image(sizeof(Header), '\0');
+    header.stop_word_offsets = AppendSection(image, stop_word_offsets);
+    header.stop_word_data = AppendSection(image, vector<char>(stop_word_data.begin(), stop_word_data.end()));
+    header.term_offsets = AppendSection(image, term_offsets);
+    header.term_data = AppendSection(image, vector<char>(term_data.begin(), term_data.end()));
+    header.posting_offsets = AppendSection(image, posting_offsets);
+    header.posting_documents = AppendSection(image, posting_documents);
+    header.posting_counts = AppendSection(image, posting_counts);
+    header.document_ids = AppendSection(image, document_ids);
+    header.document_ratings = AppendSection(image, document_ratings);
+    header.document_statuses = AppendSection(image, document_statuses);
+    header.document_lengths = AppendSection(image, document_lengths);
+    header.image_size = image.size();
+    memcpy(image.data(), &header, sizeof(Header));
+
+    // Переименование атомарно: уже отображённая версия остаётся у своих читателей
+    ReplaceFile(path, image);
+}
+
+SharedIndex::SharedIndex(const string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Cannot open " + path);
+    }
+    struct stat file_stat {};
+    if (fstat(fd, &file_stat) != 0) {
+        const int error = errno;
+        close(fd);
+        throw system_error(error, generic_category(), "Cannot stat " + path);
+    }
+    image_size_ = static_cast<size_t>(file_stat.st_size);
+    device_ = file_stat.st_dev;
+    inode_ = file_stat.st_ino;
+    if (image_size_ < sizeof(Header)) {
+        close(fd);
+        throw invalid_argument("Not a shared index: " + path);
+    }
+    void* image = mmap(nullptr, image_size_, PROT_READ, MAP_SHARED, fd, 0);
+    const int error = errno;
+    // Отображение держит файл само
+    close(fd);
+    if (image == MAP_FAILED) {
+        throw system_error(error, generic_category(), "Cannot map " + path);
+    }
+    image_ = image;
+
+    try {
+        Header header;
+        memcpy(&header, image_, sizeof(Header));
+        if (memcmp(header.magic, SHARED_INDEX_MAGIC, sizeof(header.magic)) != 0 || header.image_size != image_size_
+            || header.term_offsets.size == 0 || header.stop_word_offsets.size == 0) {
+            throw invalid_argument("Not a shared index: " + path);
+        }
+        document_count_ = header.document_count;
+        total_word_count_ = header.total_word_count;
+        term_count_ = header.term_offsets.size - 1;
+
+        const size_t stop_word_count = header.stop_word_offsets.size - 1;
+        const auto* stop_word_offsets = GetSection<uint64_t>(image_, image_size_, header.stop_word_offsets, stop_word_count + 1);
+        const auto* stop_word_data = GetSection<char>(image_, image_size_, header.stop_word_data, header.stop_word_data.size);
+        CheckOffsets(stop_word_offsets, stop_word_count, header.stop_word_data.size);
+
+        term_offsets_ = GetSection<uint64_t>(image_, image_size_, header.term_offsets, term_count_ + 1);
+        term_data_ = GetSection<char>(image_, image_size_, header.term_data, header.term_data.size);
+        CheckOffsets(term_offsets_, term_count_, header.term_data.size);
+
+        const size_t posting_count = header.posting_documents.size;
+        posting_offsets_ = GetSection<uint64_t>(image_, image_size_, header.posting_offsets, term_count_ + 1);
+        posting_documents_ = GetSection<uint32_t>(image_, image_size_, header.posting_documents, posting_count);
+        posting_counts_ = GetSection<uint32_t>(image_, image_size_, header.posting_counts, posting_count);
+        CheckOffsets(posting_offsets_, term_count_, posting_count);
+
+        document_ids_ = GetSection<int32_t>(image_, image_size_, header.document_ids, document_count_);
+        document_ratings_ = GetSection<int32_t>(image_, image_size_, header.document_ratings, document_count_);
+        document_statuses_ = GetSection<uint8_t>(image_, image_size_, header.document_statuses, document_count_);
+        document_lengths_ = GetSection<uint32_t>(image_, image_size_, header.document_lengths, document_count_);
+        // Номера документов в постингах индексируют массивы документов без проверок
+        if (any_of(posting_documents_, posting_documents_ + posting_count, [this](uint32_t document) { return document >= document_count_; })) {
+            throw invalid_argument("Corrupted shared index postings");
+        }
+
+        vector<string_view> stop_words;
+        for (size_t i = 0; i < stop_word_count; ++i) {
+            stop_words.emplace_back(stop_word_data + stop_word_offsets[i], stop_word_offsets[i + 1] - stop_word_offsets[i]);
+        }
+        tokenizer_ = make_unique<const SearchServer>(stop_words);
+    }
+    catch (...) {
+        munmap(const_cast<void*>(image_), image_size_);
+        throw;
+    }
+}
+
+SharedIndex::~SharedIndex() {
+    munmap(const_cast<void*>(image_), image_size_);
+}
+
+bool SharedIndex::IsStale(const string& path) const {
+    struct stat file_stat {};
+    if (stat(path.c_str(), &file_stat) != 0) {
+        return true;
+    }
+    return static_cast<uint64_t>(file_stat.st_dev) != device_ || static_cast<uint64_t>(file_stat.st_ino) != inode_;
+}
+
+vector<Document> SharedIndex::FindTopDocuments(string_view raw_query, DocumentStatus status) const {
+    return FindTopDocuments(raw_query, [status](int, DocumentStatus document_status, int) {
+        return document_status == status;
+        });
+}
+
+SharedIndex::Postings SharedIndex::FindPostings(string_view word) const {
+    // Двоичный поиск по номерам слов: сами слова лежат подряд в term_data_
+    const auto term_at = [this](size_t term) {
+        return string_view(term_data_ + term_offsets_[term], term_offsets_[term + 1] - term_offsets_[term]);
+    };
+    size_t first = 0;
+    size_t last = term_count_;
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (term_at(middle) < word) {
+            first = middle + 1;
+        }
+        else {
+            last = middle;
+        }
+    }
+    if (first == term_count_ || term_at(first) != word) {
+        return {};
+    }
+    const uint64_t begin = posting_offsets_[first];
+    return { posting_documents_ + begin, posting_counts_ + begin, posting_offsets_[first + 1] - begin };
+}
+
+SharedIndexReader::SharedIndexReader(string path)
+    : path_(move(path))
+    , index_(make_shared<const SharedIndex>(path_)) {
+}
+
+bool SharedIndexReader::Refresh() {
+    if (!Get()->IsStale(path_)) {
+        return false;
+    }
+    // Отображение и проверка новой версии — без блокировки: Get в это время отдаёт прежнюю
+    auto index = make_shared<const SharedIndex>(path_);
+    lock_guard lock(mutex_);
+    index_.swap(index);
+    return true;
+}
+
+shared_ptr<const SharedIndex> SharedIndexReader::Get() const {
+    lock_guard lock(mutex_);
+    return index_;
+}
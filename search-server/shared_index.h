@@ -0,0 +1,142 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "document.h"
+#include "scoring.h"
+#include "search_cursor.h"
+#include "search_server.h"
+
+// Замороженный индекс, общий для процессов одного хоста. PublishSharedIndex раскладывает индекс в плоский
+// образ без указателей — все ссылки внутри заданы смещениями от начала — и атомарно подменяет им файл
+// по path. SharedIndex отображает файл в память только для чтения (MAP_SHARED): страницы образа лежат
+// в страничном кэше ОС в одном экземпляре, сколько бы процессов его ни открыли, и адрес отображения
+// в каждом процессе может быть своим. Файл в /dev/shm живёт в разделяемой памяти, без диска
+void PublishSharedIndex(const SearchServer& server, const std::string& path);
+
+class SharedIndex {
+public:
+    // system_error, если файл не открыть; invalid_argument, если это не образ индекса или он повреждён
+    explicit SharedIndex(const std::string& path);
+
+    SharedIndex(const SharedIndex&) = delete;
+    SharedIndex& operator=(const SharedIndex&) = delete;
+
+    ~SharedIndex();
+
+    size_t GetDocumentCount() const {
+        return document_count_;
+    }
+
+    size_t GetImageSize() const {
+        return image_size_;
+    }
+
+    // Файл по path заменён новой версией (или удалён) после того, как этот был отображён
+    bool IsStale(const std::string& path) const;
+
+    // Запрос из плюс- и минус-слов, как у SegmentedSearchServer
+    template <typename DocumentPredicate, typename Scorer = TfIdfScorer>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer = {}) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status = DocumentStatus::ACTUAL) const;
+
+private:
+    // Постинги слова отсортированы по номеру документа в образе
+    struct Postings {
+        const uint32_t* documents = nullptr;
+        const uint32_t* counts = nullptr;
+        size_t size = 0;
+    };
+
+    Postings FindPostings(std::string_view word) const;
+
+    const void* image_ = nullptr;
+    size_t image_size_ = 0;
+    uint64_t device_ = 0;
+    uint64_t inode_ = 0;
+
+    size_t document_count_ = 0;
+    uint64_t total_word_count_ = 0;
+    size_t term_count_ = 0;
+    const uint64_t* term_offsets_ = nullptr;
+    const char* term_data_ = nullptr;
+    const uint64_t* posting_offsets_ = nullptr;
+    const uint32_t* posting_documents_ = nullptr;
+    const uint32_t* posting_counts_ = nullptr;
+    const int32_t* document_ids_ = nullptr;
+    const int32_t* document_ratings_ = nullptr;
+    const uint8_t* document_statuses_ = nullptr;
+    const uint32_t* document_lengths_ = nullptr;
+
+    // Разбор запроса со стоп-словами из образа; сами документы в нём не хранятся
+    std::unique_ptr<const SearchServer> tokenizer_;
+};
+
+// Последняя опубликованная версия образа. Refresh отображает новую, если файл подменили; запросы,
+// успевшие взять прежнюю через Get, дочитывают её, и она остаётся отображённой, пока они её держат
+class SharedIndexReader {
+public:
+    explicit SharedIndexReader(std::string path);
+
+    // true, если подхвачена новая версия
+    bool Refresh();
+
+    std::shared_ptr<const SharedIndex> Get() const;
+
+private:
+    const std::string path_;
+    mutable std::mutex mutex_;
+    std::shared_ptr<const SharedIndex> index_;
+};
+
+template <typename DocumentPredicate, typename Scorer>
+std::vector<Document> SharedIndex::FindTopDocuments(std::string_view raw_query, DocumentPredicate document_predicate, const Scorer& scorer) const {
+    const auto query = tokenizer_->ParseQueryTerms(raw_query);
+    const auto ranker = scorer.Prepare({ document_count_, document_count_ == 0 ? 0.0 : total_word_count_ * 1.0 / document_count_ });
+
+    std::unordered_map<uint32_t, double> relevances;
+    for (const std::string_view word : query.plus_words) {
+        const Postings postings = FindPostings(word);
+        if (postings.size == 0) {
+            continue;
+        }
+        const double term_weight = ranker.GetTermWeight(postings.size);
+        for (size_t i = 0; i < postings.size; ++i) {
+            const uint32_t document = postings.documents[i];
+            const uint32_t length = document_lengths_[document];
+            relevances[document] += ranker.Score(term_weight, postings.counts[i] * (1.0 / length), length);
+        }
+    }
+
+    // Минус-слова проверяются двоичным поиском только для найденных документов
+    std::vector<Postings> minus_postings;
+    for (const std::string_view word : query.minus_words) {
+        const Postings postings = FindPostings(word);
+        if (postings.size > 0) {
+            minus_postings.push_back(postings);
+        }
+    }
+
+    std::vector<Document> results;
+    for (const auto [document, relevance] : relevances) {
+        const bool excluded = std::any_of(minus_postings.begin(), minus_postings.end(), [document = document](const Postings& postings) {
+            return std::binary_search(postings.documents, postings.documents + postings.size, document);
+            });
+        const int document_id = document_ids_[document];
+        const int rating = document_ratings_[document];
+        if (!excluded && document_predicate(document_id, static_cast<DocumentStatus>(document_statuses_[document]), rating)) {
+            results.emplace_back(document_id, relevance, rating);
+        }
+    }
+    const auto top_end = results.begin() + std::min<size_t>(results.size(), MAX_RESULT_DOCUMENT_COUNT);
+    std::partial_sort(results.begin(), top_end, results.end(), IsRankedBefore);
+    results.erase(top_end, results.end());
+    return results;
+}
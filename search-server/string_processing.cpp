@@ -4,12 +4,17 @@ using namespace std;
 
 vector<string_view> SplitIntoWords(string_view str) {
     vector<string_view> result;
+    SplitIntoWords(str, result);
+    return result;
+}
+
+void SplitIntoWords(string_view str, vector<string_view>& words) {
     int64_t pos = 0;
 
     const int64_t pos_end = str.npos;
     while (true) {
         int64_t space = str.find(' ', pos);
-        result.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
+        words.push_back(space == pos_end ? str.substr(pos) : str.substr(pos, space - pos));
         if (space == pos_end) {
             break;
         }
@@ -17,6 +22,4 @@ vector<string_view> SplitIntoWords(string_view str) {
             str.remove_prefix(space + 1);
         }
     }
-
-    return result;
 }
\ No newline at end of file
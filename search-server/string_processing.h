@@ -6,6 +6,9 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view str);
 
+// Дописывает слова в words, не выделяя память сверх уже зарезервированной ёмкости
+void SplitIntoWords(std::string_view str, std::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings{};
@@ -0,0 +1,217 @@
+#include "test_document_store.h"
+
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "block_codec.h"
+#include "document_store.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t BLOCK_SIZE = 32 * 1024;
+
+// Сжимает и распаковывает текст; возвращает размер сжатых данных
+size_t AssertRoundTrip(const string& text, const string& hint) {
+    pmr::vector<uint8_t> data;
+    CompressBlock(text, data);
+    ASSERT_HINT(DecompressBlock(data, text.size()) == text, hint);
+    return data.size();
+}
+
+string RandomText(mt19937& generator, size_t size, char first = 'a', char last = 'z') {
+    uniform_int_distribution<int> letter(first, last);
+    string text;
+    for (size_t i = 0; i < size; ++i) {
+        text += static_cast<char>(letter(generator));
+    }
+    return text;
+}
+
+// Повторяет period случайных символов до длины size: совпадения со смещением period
+string PeriodicText(mt19937& generator, size_t period, size_t size) {
+    const string pattern = RandomText(generator, period);
+    string text;
+    while (text.size() < size) {
+        text += pattern;
+    }
+    text.resize(size);
+    return text;
+}
+
+void TestShortBlocks() {
+    AssertRoundTrip("", "empty text");
+    AssertRoundTrip("a", "one byte");
+    AssertRoundTrip("abc", "shorter than MIN_MATCH");
+    AssertRoundTrip("abcd", "exactly MIN_MATCH");
+    AssertRoundTrip("aaaa", "MIN_MATCH equal bytes");
+    AssertRoundTrip("aaaaa", "match right after the first byte");
+    AssertRoundTrip("abcdabcd", "single match at the end");
+    AssertRoundTrip("abcdabc", "match candidate cut by the end");
+}
+
+void TestNearMatches() {
+    mt19937 generator(1);
+    // Литералы длиной около WILD_COPY перед совпадением и в конце блока
+    for (size_t literal_length = 0; literal_length <= 40; ++literal_length) {
+        const string literals = RandomText(generator, literal_length, 'A', 'Z');
+        const string repeated = RandomText(generator, 20);
+        AssertRoundTrip(literals, "only literals, " + to_string(literal_length));
+        AssertRoundTrip(literals + repeated + repeated, "literals before a match, " + to_string(literal_length));
+        AssertRoundTrip(repeated + repeated + literals, "literals after a match, " + to_string(literal_length));
+    }
+}
+
+void TestSelfOverlappingMatches() {
+    mt19937 generator(2);
+    // Смещение меньше WILD_COPY: совпадение перекрывается с самим собой и копируется побайтно
+    for (size_t period = 1; period < 16; ++period) {
+        for (const size_t size : { period + 4, period + 17, size_t{ 1000 } }) {
+            const string text = PeriodicText(generator, period, size);
+            const size_t compressed = AssertRoundTrip(text, "period " + to_string(period) + ", size " + to_string(size));
+            if (size == 1000) {
+                ASSERT_HINT(compressed < 100, "period " + to_string(period));
+            }
+        }
+    }
+}
+
+void TestLongOffsetMatches() {
+    mt19937 generator(3);
+    // Смещение от WILD_COPY: копирование кусками по 16 байт, в том числе с хвостом короче куска
+    for (const size_t period : { 16, 17, 31, 32, 33, 100, 1000 }) {
+        for (const size_t match_length : { 4, 15, 16, 17, 33, 5000 }) {
+            const string text = PeriodicText(generator, period, period + match_length) + RandomText(generator, 5);
+            AssertRoundTrip(text, "period " + to_string(period) + ", match " + to_string(match_length));
+        }
+    }
+    // Смещения у границы 16-битного поля
+    const string head = RandomText(generator, 100);
+    for (const size_t gap : { 65000, 65435, 65436, 70000 }) {
+        const string text = head + RandomText(generator, gap, '0', '9') + head;
+        AssertRoundTrip(text, "gap " + to_string(gap));
+    }
+}
+
+void TestRandomBlocks() {
+    mt19937 generator(4);
+    const vector<string> words = { "cat", "dog", "white", "fluffy", "groomed", "tail", "starling", "eugene" };
+    for (int trial = 0; trial < 20; ++trial) {
+        string text;
+        while (text.size() < BLOCK_SIZE + trial * 1000) {
+            if (generator() % 4 == 0) {
+                text += RandomText(generator, generator() % 40);
+            }
+            else {
+                text += words[generator() % words.size()];
+            }
+            text += ' ';
+        }
+        AssertRoundTrip(text, "trial " + to_string(trial));
+    }
+}
+
+void AssertStoreContents(const DocumentStore& store, const map<int, string>& expected, const string& hint) {
+    size_t text_size = 0;
+    for (const auto& [document_id, text] : expected) {
+        ASSERT_HINT(store.Get(document_id) == text, hint + ", document " + to_string(document_id));
+        text_size += text.size();
+    }
+    ASSERT_EQUAL_HINT(store.GetTextSize(), text_size, hint);
+}
+
+void AssertMissing(const DocumentStore& store, int document_id) {
+    try {
+        store.Get(document_id);
+        ASSERT_HINT(false, "document " + to_string(document_id) + " must be missing");
+    }
+    catch (const out_of_range&) {
+    }
+}
+
+void TestStoreBlockBoundary() {
+    mt19937 generator(5);
+    for (const size_t cache_blocks : { 0, 1, 4 }) {
+        DocumentStore store(cache_blocks);
+        map<int, string> expected;
+        const auto add = [&](int document_id, string text) {
+            store.Add(document_id, text);
+            expected[document_id] = move(text);
+        };
+        add(0, "");
+        // Документ, заканчивающийся за границей блока, и пустой документ сразу после закрытия блока
+        add(1, RandomText(generator, BLOCK_SIZE - 10));
+        add(2, RandomText(generator, 100));
+        add(3, "");
+        add(4, "abc");
+        // Документ длиннее целого блока
+        add(5, PeriodicText(generator, 7, BLOCK_SIZE * 3));
+        add(6, RandomText(generator, 10));
+        AssertStoreContents(store, expected, "cache " + to_string(cache_blocks));
+        // Повторное чтение идёт через кеш блоков
+        AssertStoreContents(store, expected, "cache " + to_string(cache_blocks) + ", second read");
+        AssertMissing(store, 7);
+    }
+}
+
+void TestStoreRemoveAndCompact() {
+    mt19937 generator(6);
+    DocumentStore store(2);
+    map<int, string> expected;
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        string text = RandomText(generator, generator() % 200, 'a', 'f');
+        store.Add(document_id, text);
+        expected[document_id] = move(text);
+    }
+    AssertStoreContents(store, expected, "before removal");
+
+    // В первой половине удаляем почти всё, во второй — каждый десятый документ
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        if (document_id < 1000 ? document_id % 5 != 0 : document_id % 10 == 0) {
+            store.Remove(document_id);
+            expected.erase(document_id);
+            AssertMissing(store, document_id);
+        }
+    }
+    store.Remove(100000);
+    AssertStoreContents(store, expected, "after removal");
+
+    store.Compact();
+    AssertStoreContents(store, expected, "after compaction");
+    for (int document_id = 0; document_id < 2000; ++document_id) {
+        if (expected.count(document_id) == 0) {
+            AssertMissing(store, document_id);
+        }
+    }
+
+    // Перенесённые документы можно снова удалить и дописать после них новые
+    for (int document_id = 0; document_id < 1000; document_id += 10) {
+        store.Remove(document_id);
+        expected.erase(document_id);
+    }
+    for (int document_id = 2000; document_id < 2500; ++document_id) {
+        string text = RandomText(generator, generator() % 200);
+        store.Add(document_id, text);
+        expected[document_id] = move(text);
+    }
+    store.Compact();
+    AssertStoreContents(store, expected, "after second compaction");
+}
+
+} // namespace
+
+void TestDocumentStore() {
+    RUN_TEST(TestShortBlocks);
+    RUN_TEST(TestNearMatches);
+    RUN_TEST(TestSelfOverlappingMatches);
+    RUN_TEST(TestLongOffsetMatches);
+    RUN_TEST(TestRandomBlocks);
+    RUN_TEST(TestStoreBlockBoundary);
+    RUN_TEST(TestStoreRemoveAndCompact);
+}
@@ -0,0 +1,185 @@
+#include "test_ingestion.h"
+
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <system_error>
+
+#include "ingestion.h"
+#include "search_server.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+// Блоки меньше записи: почти каждая запись разрезана, а хвосты переносятся через несколько блоков
+IngestionOptions SmallChunks() {
+    IngestionOptions options;
+    options.chunk_size = 16;
+    options.queue_capacity = 2;
+    options.parser_threads = 4;
+    return options;
+}
+
+struct ExpectedDocument {
+    string text;
+    DocumentStatus status;
+    int rating;
+};
+
+// Корпус с некорректными записями, пустыми строками, \r\n и повторами id. Повтор id отвергается сервером,
+// поэтому в индексе остаётся первая по порядку запись — только если блоки индексируются в исходном порядке
+struct Corpus {
+    string input;
+    size_t records = 0;
+    size_t errors = 0;
+    map<int, ExpectedDocument> documents;
+};
+
+Corpus MakeCorpus() {
+    Corpus corpus;
+    const auto add_line = [&corpus](const string& line, bool crlf) {
+        corpus.input += line + (crlf ? "\r\n" : "\n");
+        ++corpus.records;
+    };
+    for (int id = 0; id < 300; ++id) {
+        const string text = "doc" + to_string(id) + " common" + (id % 10 == 0 ? " long tail of words past one chunk" : "");
+        const DocumentStatus status = id % 3 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        add_line(to_string(id) + '\t' + (status == DocumentStatus::BANNED ? "BANNED" : "0") + '\t' + to_string(id % 7) + " "
+            + to_string(id % 7 + 2) + '\t' + text, id % 2 == 1);
+        corpus.documents[id] = { text, status, id % 7 + 1 };
+
+        if (id % 5 == 4) {
+            add_line(to_string(id - 4) + "\tACTUAL\t9\tduplicate" + to_string(id), id % 4 == 1);
+            ++corpus.errors;
+        }
+        if (id % 11 == 0) {
+            corpus.input += id % 2 == 0 ? "\n" : "\r\n";
+        }
+        if (id % 13 == 0) {
+            add_line("bad\tACTUAL\t1\tnot a number", false);
+            add_line(to_string(1000 + id) + "\tUNKNOWN\t1\tbad status", true);
+            add_line(to_string(2000 + id) + "\tACTUAL\tx\tbad rating", false);
+            add_line(to_string(3000 + id) + "\tACTUAL", true);
+            add_line(to_string(4000 + id) + "\tACTUAL\t1\tcontrol\x01word", false);
+            corpus.errors += 5;
+        }
+    }
+    // Последняя запись без перевода строки
+    corpus.input += "500\tIRRELEVANT\t\tlast record";
+    ++corpus.records;
+    corpus.documents[500] = { "last record", DocumentStatus::IRRELEVANT, 0 };
+    return corpus;
+}
+
+void AssertIndexed(const SearchServer& server, const Corpus& corpus, const IngestionStats& stats) {
+    ASSERT_EQUAL(stats.bytes_read, corpus.input.size());
+    ASSERT_EQUAL(stats.records, corpus.records);
+    ASSERT_EQUAL(stats.errors, corpus.errors);
+    ASSERT_EQUAL(stats.documents_added, corpus.documents.size());
+    ASSERT_EQUAL(static_cast<size_t>(server.GetDocumentCount()), corpus.documents.size());
+    for (const auto& [id, expected] : corpus.documents) {
+        const auto document = server.GetDocument(id);
+        // У записей с \r\n он отрезан вместе с переводом строки
+        ASSERT_EQUAL_HINT(document.text, expected.text, to_string(id));
+        ASSERT_HINT(document.status == expected.status, to_string(id));
+        ASSERT_EQUAL_HINT(document.rating, expected.rating, to_string(id));
+    }
+}
+
+void TestSmallChunks() {
+    const Corpus corpus = MakeCorpus();
+    SearchServer server(""s);
+    istringstream input(corpus.input);
+    AssertIndexed(server, corpus, IngestDocuments(server, input, SmallChunks()));
+}
+
+void TestChunkSizes() {
+    const Corpus corpus = MakeCorpus();
+    for (const size_t chunk_size : { size_t{ 1 }, size_t{ 7 }, size_t{ 64 }, corpus.input.size(), corpus.input.size() * 2 }) {
+        IngestionOptions options = SmallChunks();
+        options.chunk_size = chunk_size;
+        SearchServer server(""s);
+        istringstream input(corpus.input);
+        AssertIndexed(server, corpus, IngestDocuments(server, input, options));
+    }
+}
+
+void TestIngestFile() {
+    const Corpus corpus = MakeCorpus();
+    TemporaryDirectory directory;
+    const string path = directory.GetPath("corpus.tsv");
+    {
+        ofstream output(path, ios::binary);
+        output << corpus.input;
+    }
+    SearchServer server(""s);
+    AssertIndexed(server, corpus, IngestFile(server, path, SmallChunks()));
+
+    try {
+        IngestFile(server, directory.GetPath("missing.tsv"));
+        ASSERT_HINT(false, "missing file ingested");
+    }
+    catch (const system_error&) {
+    }
+}
+
+void TestInvalidOptions() {
+    for (size_t IngestionOptions::*field : { &IngestionOptions::chunk_size, &IngestionOptions::queue_capacity, &IngestionOptions::parser_threads }) {
+        IngestionOptions options = SmallChunks();
+        options.*field = 0;
+        SearchServer server(""s);
+        istringstream input("1\tACTUAL\t1\tcat\n");
+        try {
+            IngestDocuments(server, input, options);
+            ASSERT_HINT(false, "zero option accepted");
+        }
+        catch (const invalid_argument&) {
+        }
+        ASSERT_EQUAL(server.GetDocumentCount(), 0);
+    }
+}
+
+// Поток, который отдаёт начало корпуса и затем падает при чтении
+class FailingBuffer : public streambuf {
+public:
+    explicit FailingBuffer(string data)
+        : data_(move(data)) {
+        setg(data_.data(), data_.data(), data_.data() + data_.size());
+    }
+
+protected:
+    int_type underflow() override {
+        throw runtime_error("read failed");
+    }
+
+private:
+    string data_;
+};
+
+void TestReadFailure() {
+    FailingBuffer buffer(MakeCorpus().input.substr(0, 500));
+    istream input(&buffer);
+    input.exceptions(ios::badbit);
+    SearchServer server(""s);
+    try {
+        IngestDocuments(server, input, SmallChunks());
+        ASSERT_HINT(false, "read failure ignored");
+    }
+    catch (const exception&) {
+    }
+}
+
+}  // namespace
+
+void TestIngestion() {
+    RUN_TEST(TestSmallChunks);
+    RUN_TEST(TestChunkSizes);
+    RUN_TEST(TestIngestFile);
+    RUN_TEST(TestInvalidOptions);
+    RUN_TEST(TestReadFailure);
+}
@@ -0,0 +1,23 @@
+#include "test_document_store.h"
+#include "test_ingestion.h"
+#include "test_query_replay.h"
+#include "test_query_server.h"
+#include "test_roaring_bitmap.h"
+#include "test_search_server.h"
+#include "test_shared_index.h"
+#include "test_write_ahead_log.h"
+
+#include <iostream>
+
+// Модульные тесты компонентов, которые не покрываются прогоном бенчмарка
+int main() {
+    TestDocumentStore();
+    TestIngestion();
+    TestQueryReplay();
+    TestQueryServer();
+    TestRoaringBitmap();
+    TestSearchServer();
+    TestSharedIndex();
+    TestWriteAheadLog();
+    std::cerr << "All tests passed" << std::endl;
+}
@@ -0,0 +1,101 @@
+#include "test_query_replay.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "query_replay.h"
+#include "search_server.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+IndexOptions WithPositions() {
+    IndexOptions options;
+    options.store_positions = true;
+    return options;
+}
+
+void AddDocuments(SearchServer& server) {
+    server.AddDocument(1, "white cat and fluffy tail", DocumentStatus::ACTUAL, { 5 });
+    server.AddDocument(2, "black dog and long tail", DocumentStatus::ACTUAL, { 3 });
+    server.AddDocument(3, "white starling", DocumentStatus::ACTUAL, { 4 });
+}
+
+// SupportsQueryContext совпадает с тем, что перегрузка с QueryContext действительно принимает
+void TestSupportsQueryContext() {
+    SearchServer server("and"s, WithPositions());
+    AddDocuments(server);
+    const vector<pair<string, bool>> queries = {
+        { "white cat", true },
+        { "white -cat", true },
+        { "cat+", true },
+        { "a|", false },
+        { "\"white cat\"", false },
+        { "whi*", false },
+        { "whi* cat", false },
+        { "+white cat", false },
+        { "cat +white", false },
+        { "cat|dog tail", false },
+    };
+    for (const auto& [query, supported] : queries) {
+        ASSERT_EQUAL_HINT(SearchServer::SupportsQueryContext(query), supported, query);
+        SearchServer::QueryContext context;
+        Document results[MAX_RESULT_DOCUMENT_COUNT];
+        bool accepted = true;
+        try {
+            server.FindTopDocuments(context, query, results);
+        }
+        catch (const invalid_argument&) {
+            accepted = false;
+        }
+        ASSERT_EQUAL_HINT(accepted, supported, query);
+    }
+}
+
+void TestReplayCountsPathsAndErrors() {
+    SearchServer server("and"s, WithPositions());
+    AddDocuments(server);
+    const vector<string> queries = { "white cat", "\"white cat\"", "whi*", "+white cat", "cat|dog tail", "--cat", "tail -dog" };
+    for (const size_t client_count : { 1, 3 }) {
+        ReplayOptions options;
+        options.client_count = client_count;
+        const ReplayStats stats = ReplayQueries(server, queries, options);
+        ASSERT_EQUAL(stats.queries, queries.size());
+        ASSERT_EQUAL(stats.full_parser_queries, 4u);
+        // Отвергнут только запрос с неверным минус-словом
+        ASSERT_EQUAL(stats.errors, 1u);
+        ASSERT(stats.elapsed_seconds > 0.0);
+        ASSERT(stats.p50_ns <= stats.p99_ns && stats.p99_ns <= stats.max_ns);
+    }
+
+    ReplayOptions invalid;
+    invalid.client_count = 0;
+    try {
+        ReplayQueries(server, queries, invalid);
+        ASSERT_HINT(false, "zero clients must be rejected");
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+void TestQueryLogRoundTrip() {
+    istringstream input("white cat\r\n\n\"white cat\"\nwhi*\n");
+    const vector<string> queries = ReadQueryLog(input);
+    ASSERT(queries == vector<string>({ "white cat", "\"white cat\"", "whi*" }));
+    ostringstream output;
+    WriteQueryLog(output, queries);
+    istringstream again(output.str());
+    ASSERT(ReadQueryLog(again) == queries);
+}
+
+} // namespace
+
+void TestQueryReplay() {
+    RUN_TEST(TestSupportsQueryContext);
+    RUN_TEST(TestReplayCountsPathsAndErrors);
+    RUN_TEST(TestQueryLogRoundTrip);
+}
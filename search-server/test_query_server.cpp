@@ -0,0 +1,302 @@
+#include "test_query_server.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "query_server.h"
+#include "search_server.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+// Блокирующий клиент по loopback; чтение ждёт не дольше 10 секунд, чтобы зависший сервер ронял тест, а не вешал его
+class Client {
+public:
+    explicit Client(uint16_t port, int receive_buffer_size = 0) {
+        fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        ASSERT(fd_ >= 0);
+        if (receive_buffer_size != 0) {
+            setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &receive_buffer_size, sizeof(receive_buffer_size));
+        }
+        const timeval timeout{ 10, 0 };
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+        ASSERT(connect(fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0);
+    }
+
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    ~Client() {
+        close(fd_);
+    }
+
+    void Send(const string& data) {
+        for (size_t sent = 0; sent < data.size();) {
+            const ssize_t size = send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            ASSERT_HINT(size > 0, "send failed");
+            sent += size;
+        }
+    }
+
+    void ShutdownWrite() {
+        shutdown(fd_, SHUT_WR);
+    }
+
+    // Следующая строка без '\n'; false, если сервер закрыл соединение
+    bool ReadLine(string& line) {
+        size_t end;
+        while ((end = buffer_.find('\n')) == string::npos) {
+            char chunk[4096];
+            const ssize_t size = read(fd_, chunk, sizeof(chunk));
+            ASSERT_HINT(size >= 0 || errno == ECONNRESET, "read timed out");
+            if (size <= 0) {
+                return false;
+            }
+            buffer_.append(chunk, size);
+        }
+        line = buffer_.substr(0, end);
+        buffer_.erase(0, end + 1);
+        return true;
+    }
+
+    string ReadLine() {
+        string line;
+        ASSERT_HINT(ReadLine(line), "connection closed");
+        return line;
+    }
+
+private:
+    int fd_ = -1;
+    string buffer_;
+};
+
+void AddDocuments(SearchServer& server) {
+    server.AddDocument(1, "white cat and fancy collar", DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail", DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes", DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(4, "groomed starling eugene", DocumentStatus::BANNED, { 9 });
+    server.AddDocument(5, "cat and dog", DocumentStatus::ACTUAL, { 1 });
+}
+
+// Ожидаемый ответ без релевантностей: "OK <n> <id>..." или "ERROR"
+string DescribeExpected(const SearchServer& server, const string& query) {
+    try {
+        ostringstream out;
+        const auto documents = server.FindTopDocuments(query);
+        out << "OK " << documents.size();
+        for (const Document& document : documents) {
+            out << ' ' << document.id << ':' << document.rating;
+        }
+        return out.str();
+    }
+    catch (const invalid_argument&) {
+        return "ERROR";
+    }
+}
+
+string DescribeResponse(const string& response) {
+    if (response.rfind("ERROR ", 0) == 0) {
+        return "ERROR";
+    }
+    istringstream in(response);
+    string status;
+    size_t count = 0;
+    in >> status >> count;
+    ostringstream out;
+    out << status << ' ' << count;
+    for (size_t i = 0; i < count; ++i) {
+        int id = 0;
+        double relevance = 0.0;
+        int rating = 0;
+        in >> id >> relevance >> rating;
+        out << ' ' << id << ':' << rating;
+    }
+    return out.str();
+}
+
+void TestPipelinedRequests() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServer server(search_server);
+    const vector<string> queries = { "cat", "fluffy groomed -dog", "cat --dog", "", "starling", "dog -", "eyes tail collar" };
+
+    Client client(server.GetPort());
+    // Все запросы одним пакетом, не дожидаясь ответов; \r\n тоже принимается
+    string requests;
+    vector<string> expected;
+    for (int round = 0; round < 30; ++round) {
+        for (const string& query : queries) {
+            requests += query + (round % 2 == 0 ? "\n" : "\r\n");
+            expected.push_back(DescribeExpected(search_server, query));
+        }
+    }
+    client.Send(requests);
+    size_t errors = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        const string response = client.ReadLine();
+        ASSERT_EQUAL_HINT(DescribeResponse(response), expected[i], "response " + to_string(i) + ": " + response);
+        errors += expected[i] == "ERROR";
+    }
+    ASSERT(errors > 0);
+
+    const QueryServerStats stats = server.GetStats();
+    ASSERT_EQUAL(stats.connections_accepted, 1u);
+    ASSERT_EQUAL(stats.open_connections, 1u);
+    ASSERT_EQUAL(stats.requests, expected.size());
+    ASSERT_EQUAL(stats.errors, errors);
+}
+
+void TestSeveralConnections() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServer server(search_server);
+    Client first(server.GetPort());
+    Client second(server.GetPort());
+    // Запросы соединений перемешаны в общих пачках, но ответы приходят каждому в своём порядке
+    for (int i = 0; i < 20; ++i) {
+        first.Send("cat\n");
+        second.Send("groomed\n");
+    }
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_EQUAL(DescribeResponse(first.ReadLine()), DescribeExpected(search_server, "cat"));
+        ASSERT_EQUAL(DescribeResponse(second.ReadLine()), DescribeExpected(search_server, "groomed"));
+    }
+}
+
+void TestHalfCloseAnswersPendingRequests() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServer server(search_server);
+    Client client(server.GetPort());
+    string requests;
+    for (int i = 0; i < 50; ++i) {
+        requests += "cat\n";
+    }
+    // Неполная последняя строка при закрытии отбрасывается
+    client.Send(requests + "dog");
+    client.ShutdownWrite();
+    size_t responses = 0;
+    for (string line; client.ReadLine(line);) {
+        ++responses;
+    }
+    ASSERT_EQUAL(responses, 50u);
+    // Счётчик обновляется сразу после close, который клиент уже увидел
+    for (int attempt = 0; attempt < 100 && server.GetStats().open_connections != 0; ++attempt) {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    ASSERT_EQUAL(server.GetStats().open_connections, 0u);
+}
+
+void TestOversizedRequestClosesConnection() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServerOptions options;
+    options.max_request_size = 16;
+    QueryServer server(search_server, options);
+    Client client(server.GetPort());
+    client.Send("cat\n");
+    ASSERT_EQUAL(DescribeResponse(client.ReadLine()), DescribeExpected(search_server, "cat"));
+    client.Send(string(100, 'x'));
+    string line;
+    ASSERT(!client.ReadLine(line));
+}
+
+// Ждёт, пока число выполненных запросов перестанет расти
+uint64_t WaitForStableRequestCount(const QueryServer& server) {
+    uint64_t requests = server.GetStats().requests;
+    for (int unchanged = 0, attempt = 0; unchanged < 3 && attempt < 100; ++attempt) {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        const uint64_t current = server.GetStats().requests;
+        unchanged = current == requests ? unchanged + 1 : 0;
+        requests = current;
+    }
+    return requests;
+}
+
+void TestOverloadedConnectionIsNotRead() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServerOptions options;
+    options.max_pending_requests = 4;
+    options.max_output_size = 1024;
+    QueryServer server(search_server, options);
+
+    // Клиент не читает ответы: как только буферы сокетов заполнятся, сервер должен перестать читать запросы
+    constexpr size_t REQUEST_COUNT = 100'000;
+    Client client(server.GetPort(), 4096);
+    thread writer([&client] {
+        string requests;
+        for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+            requests += i % 2 == 0 ? "cat\n" : "groomed\n";
+        }
+        client.Send(requests);
+    });
+    const uint64_t executed = WaitForStableRequestCount(server);
+    ASSERT_HINT(executed < REQUEST_COUNT, "server kept reading an overloaded connection");
+
+    // Клиент забирает ответы — чтение возобновляется, и все ответы приходят по порядку
+    const string cat = DescribeExpected(search_server, "cat");
+    const string groomed = DescribeExpected(search_server, "groomed");
+    for (size_t i = 0; i < REQUEST_COUNT; ++i) {
+        ASSERT_EQUAL_HINT(DescribeResponse(client.ReadLine()), i % 2 == 0 ? cat : groomed, "response " + to_string(i));
+    }
+    writer.join();
+    ASSERT_EQUAL(server.GetStats().requests, REQUEST_COUNT);
+}
+
+void TestStopWithOpenConnections() {
+    SearchServer search_server("and"s);
+    AddDocuments(search_server);
+    QueryServerOptions options;
+    options.max_pending_requests = 4;
+    options.max_output_size = 1024;
+    QueryServer server(search_server, options);
+    Client idle(server.GetPort());
+    idle.Send("cat\n");
+    ASSERT_EQUAL(DescribeResponse(idle.ReadLine()), DescribeExpected(search_server, "cat"));
+    // Второе соединение перегружено: ответы не прочитаны, часть запросов ещё в буфере
+    Client busy(server.GetPort(), 4096);
+    string requests;
+    for (int i = 0; i < 2'000; ++i) {
+        requests += "cat\n";
+    }
+    busy.Send(requests);
+    WaitForStableRequestCount(server);
+    ASSERT_EQUAL(server.GetStats().open_connections, 2u);
+
+    server.Stop();
+    ASSERT_EQUAL(server.GetStats().open_connections, 0u);
+    string line;
+    ASSERT(!idle.ReadLine(line));
+    while (busy.ReadLine(line)) {
+    }
+    // Повторный вызов ничего не делает
+    server.Stop();
+}
+
+} // namespace
+
+void TestQueryServer() {
+    RUN_TEST(TestPipelinedRequests);
+    RUN_TEST(TestSeveralConnections);
+    RUN_TEST(TestHalfCloseAnswersPendingRequests);
+    RUN_TEST(TestOversizedRequestClosesConnection);
+    RUN_TEST(TestOverloadedConnectionIsNotRead);
+    RUN_TEST(TestStopWithOpenConnections);
+}
@@ -0,0 +1,207 @@
+#include "test_roaring_bitmap.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "roaring_bitmap.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t CONTAINER_SIZE = 1 << 16;
+constexpr size_t ARRAY_LIMIT = 4096;
+
+// Сверяет содержимое с эталоном: обход по возрастанию, мощность и Contains
+void AssertSameElements(const RoaringBitmap& bitmap, const set<uint32_t>& expected, const string& hint) {
+    vector<uint32_t> elements;
+    bitmap.ForEach([&elements](uint32_t value) {
+        elements.push_back(value);
+    });
+    ASSERT_HINT(elements == vector<uint32_t>(expected.begin(), expected.end()), hint);
+    ASSERT_EQUAL_HINT(bitmap.Cardinality(), expected.size(), hint);
+    ASSERT_EQUAL_HINT(bitmap.empty(), expected.empty(), hint);
+    for (const uint32_t value : expected) {
+        ASSERT_HINT(bitmap.Contains(value), hint);
+        ASSERT_HINT(!bitmap.Contains(value + 1) || expected.count(value + 1) > 0, hint);
+    }
+}
+
+// Вид контейнера, который должен получиться после заполнения
+enum class ContainerKind {
+    EMPTY,
+    ARRAY,
+    BITMAP,
+    BOUNDARY,
+};
+
+struct TestSet {
+    RoaringBitmap bitmap;
+    set<uint32_t> expected;
+};
+
+TestSet MakeSet(mt19937& generator, const vector<pair<uint16_t, ContainerKind>>& containers) {
+    TestSet result;
+    for (const auto& [key, kind] : containers) {
+        size_t size = 0;
+        switch (kind) {
+        case ContainerKind::EMPTY:
+            break;
+        case ContainerKind::ARRAY:
+            size = uniform_int_distribution<size_t>(1, ARRAY_LIMIT / 2)(generator);
+            break;
+        case ContainerKind::BITMAP:
+            size = uniform_int_distribution<size_t>(ARRAY_LIMIT * 2, ARRAY_LIMIT * 4)(generator);
+            break;
+        case ContainerKind::BOUNDARY:
+            size = uniform_int_distribution<size_t>(ARRAY_LIMIT - 8, ARRAY_LIMIT + 8)(generator);
+            break;
+        }
+        // Младшие биты из половины контейнера, чтобы множества пересекались
+        uniform_int_distribution<uint32_t> low(0, CONTAINER_SIZE / 2 - 1);
+        const uint32_t high = static_cast<uint32_t>(key) << 16;
+        const size_t target = result.expected.size() + size;
+        while (result.expected.size() < target) {
+            const uint32_t value = high | low(generator);
+            result.bitmap.Add(value);
+            result.expected.insert(value);
+        }
+    }
+    return result;
+}
+
+void TestArrayBitmapBoundary() {
+    RoaringBitmap bitmap;
+    set<uint32_t> expected;
+    // Шаг 3, чтобы элементы не шли подряд и занимали разные слова карты
+    for (uint32_t i = 0; i < ARRAY_LIMIT; ++i) {
+        bitmap.Add(i * 3);
+        expected.insert(i * 3);
+    }
+    AssertSameElements(bitmap, expected, "array of ARRAY_LIMIT elements");
+
+    // Повторное добавление не меняет мощность и не переводит массив в карту
+    bitmap.Add(0);
+    bitmap.Add((ARRAY_LIMIT - 1) * 3);
+    AssertSameElements(bitmap, expected, "array after duplicate adds");
+
+    bitmap.Add(1);
+    expected.insert(1);
+    AssertSameElements(bitmap, expected, "bitmap after crossing ARRAY_LIMIT");
+
+    bitmap.Add(1);
+    AssertSameElements(bitmap, expected, "bitmap after duplicate add");
+
+    // Удаление отсутствующего элемента не меняет мощность
+    bitmap.Remove(2);
+    AssertSameElements(bitmap, expected, "bitmap after removing absent value");
+
+    bitmap.Remove(1);
+    expected.erase(1);
+    AssertSameElements(bitmap, expected, "array after dropping back to ARRAY_LIMIT");
+
+    bitmap.Add(CONTAINER_SIZE - 1);
+    expected.insert(CONTAINER_SIZE - 1);
+    AssertSameElements(bitmap, expected, "bitmap after crossing ARRAY_LIMIT again");
+
+    // Удаляем вперемешку до пустого множества, проходя границу сверху вниз
+    vector<uint32_t> order(expected.begin(), expected.end());
+    shuffle(order.begin(), order.end(), mt19937(42));
+    for (size_t i = 0; i < order.size(); ++i) {
+        bitmap.Remove(order[i]);
+        expected.erase(order[i]);
+        if (expected.size() + 2 >= ARRAY_LIMIT && expected.size() <= ARRAY_LIMIT + 2) {
+            AssertSameElements(bitmap, expected, "removing around ARRAY_LIMIT, " + to_string(expected.size()) + " left");
+        }
+    }
+    AssertSameElements(bitmap, expected, "after removing everything");
+
+    // Снова вверх через границу после удаления всего контейнера
+    for (uint32_t i = 0; i <= ARRAY_LIMIT; ++i) {
+        bitmap.Add(CONTAINER_SIZE - 1 - i * 7);
+        expected.insert(CONTAINER_SIZE - 1 - i * 7);
+    }
+    AssertSameElements(bitmap, expected, "bitmap refilled from the top");
+}
+
+void TestSetOperations() {
+    const vector<ContainerKind> kinds = { ContainerKind::EMPTY, ContainerKind::ARRAY, ContainerKind::BITMAP,
+        ContainerKind::BOUNDARY };
+    mt19937 generator(2024);
+    for (const ContainerKind lhs_kind : kinds) {
+        for (const ContainerKind rhs_kind : kinds) {
+            for (int trial = 0; trial < 3; ++trial) {
+                const string hint = "kinds " + to_string(static_cast<int>(lhs_kind)) + " and " + to_string(static_cast<int>(rhs_kind))
+                    + ", trial " + to_string(trial);
+                // Общий ключ 1 сочетает выбранные виды; ключи 0 и 3 есть только у одного из множеств
+                const TestSet lhs = MakeSet(generator, { { 0, ContainerKind::ARRAY }, { 1, lhs_kind }, { 2, rhs_kind } });
+                const TestSet rhs = MakeSet(generator, { { 1, rhs_kind }, { 2, lhs_kind }, { 3, ContainerKind::BITMAP } });
+
+                set<uint32_t> expected;
+                RoaringBitmap intersection = lhs.bitmap;
+                intersection &= rhs.bitmap;
+                set_intersection(lhs.expected.begin(), lhs.expected.end(), rhs.expected.begin(), rhs.expected.end(),
+                    inserter(expected, expected.end()));
+                AssertSameElements(intersection, expected, "And, " + hint);
+
+                expected.clear();
+                RoaringBitmap united = lhs.bitmap;
+                united |= rhs.bitmap;
+                set_union(lhs.expected.begin(), lhs.expected.end(), rhs.expected.begin(), rhs.expected.end(),
+                    inserter(expected, expected.end()));
+                AssertSameElements(united, expected, "Or, " + hint);
+
+                expected.clear();
+                RoaringBitmap difference = lhs.bitmap;
+                difference -= rhs.bitmap;
+                set_difference(lhs.expected.begin(), lhs.expected.end(), rhs.expected.begin(), rhs.expected.end(),
+                    inserter(expected, expected.end()));
+                AssertSameElements(difference, expected, "AndNot, " + hint);
+
+                // Результаты операций остаются корректными контейнерами для дальнейших изменений
+                for (const uint32_t value : lhs.expected) {
+                    difference.Add(value);
+                    expected.insert(value);
+                }
+                AssertSameElements(difference, expected, "Add after AndNot, " + hint);
+                for (const uint32_t value : rhs.expected) {
+                    difference.Remove(value);
+                    expected.erase(value);
+                }
+                AssertSameElements(difference, expected, "Remove after Add, " + hint);
+            }
+        }
+    }
+}
+
+void TestOperationsDropEmptyContainers() {
+    RoaringBitmap lhs;
+    RoaringBitmap rhs;
+    for (uint32_t i = 0; i < ARRAY_LIMIT * 2; ++i) {
+        lhs.Add(i * 2);
+        rhs.Add(i * 2 + 1);
+    }
+    RoaringBitmap intersection = lhs;
+    intersection &= rhs;
+    AssertSameElements(intersection, {}, "disjoint bitmaps");
+    ASSERT(intersection.empty());
+
+    RoaringBitmap difference = lhs;
+    difference -= lhs;
+    AssertSameElements(difference, {}, "difference with itself");
+    ASSERT(difference.empty());
+}
+
+} // namespace
+
+void TestRoaringBitmap() {
+    RUN_TEST(TestArrayBitmapBoundary);
+    RUN_TEST(TestSetOperations);
+    RUN_TEST(TestOperationsDropEmptyContainers);
+}
@@ -0,0 +1,194 @@
+#include "test_search_server.h"
+
+#include <algorithm>
+#include <execution>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "search_cursor.h"
+#include "search_server.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+IndexOptions WithOffsets() {
+    IndexOptions options;
+    options.store_offsets = true;
+    return options;
+}
+
+// Ожидаемая подсветка: где слово стоит в тексте фрагмента
+SearchServer::Snippet::Range RangeOf(const string& snippet_text, const string& word, size_t from = 0) {
+    const size_t offset = snippet_text.find(word, from);
+    ASSERT_HINT(offset != string::npos, word);
+    return { static_cast<uint32_t>(offset), static_cast<uint32_t>(word.size()) };
+}
+
+void AssertHighlights(const SearchServer::Snippet& snippet, const vector<SearchServer::Snippet::Range>& expected) {
+    ASSERT_EQUAL_HINT(snippet.highlights.size(), expected.size(), snippet.text);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(snippet.highlights[i].offset, expected[i].offset, snippet.text);
+        ASSERT_EQUAL_HINT(snippet.highlights[i].length, expected[i].length, snippet.text);
+    }
+}
+
+// Документы без слов запроса, чтобы у слов запроса была ненулевая IDF; fox встречается чаще dog
+void AddBackground(SearchServer& server) {
+    server.AddDocument(100, "fox alpha", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(101, "fox beta", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(102, "gamma delta", DocumentStatus::ACTUAL, { 1 });
+}
+
+string RepeatWord(const string& word, size_t count) {
+    string text;
+    for (size_t i = 0; i < count; ++i) {
+        text += (i == 0 ? "" : " ") + word;
+    }
+    return text;
+}
+
+void AssertSameDocuments(const vector<Document>& actual, const vector<Document>& expected, const string& hint) {
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+    }
+}
+
+void TestNearTiesRankedAlike() {
+    IndexOptions options;
+    options.store_impacts = true;
+    SearchServer server("and"s, options);
+    server.AddDocument(100, "dog", DocumentStatus::ACTUAL, { 1 });
+    // Релевантности cat отличаются меньше чем на ERROR_RATE_RELEVANCE, а рейтинги растут в обратном порядке:
+    // сравнение с допуском поставило бы документы по рейтингу, точное — по релевантности
+    for (int i = 0; i < 4; ++i) {
+        server.AddDocument(i + 1, "cat " + RepeatWord("filler", 2000 + i), DocumentStatus::ACTUAL, { i });
+    }
+    const vector<Document> expected = server.FindTopDocuments("cat");
+    ASSERT_EQUAL(expected.size(), 4u);
+    ASSERT(expected.front().relevance - expected.back().relevance < ERROR_RATE_RELEVANCE);
+    ASSERT(is_sorted(expected.begin(), expected.end(), IsRankedBefore));
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_EQUAL(expected[i].id, i + 1);
+    }
+
+    AssertSameDocuments(server.FindTopDocuments(execution::par, "cat"), expected, "parallel");
+    AssertSameDocuments(server.FindPage("cat", nullopt, 5).documents, expected, "FindPage");
+    AssertSameDocuments(server.FindTopDocumentsWithFacets("cat", [](int, DocumentStatus status, int) {
+        return status == DocumentStatus::ACTUAL;
+        }).documents, expected, "facets");
+    AssertSameDocuments(server.FindTopDocumentsByImpact("cat").documents, expected, "impact");
+    SearchServer::QueryContext context;
+    Document results[MAX_RESULT_DOCUMENT_COUNT];
+    const auto results_end = server.FindTopDocuments(context, "cat", results);
+    AssertSameDocuments(vector<Document>(results, results_end), expected, "QueryContext");
+}
+
+void TestSnippetWindowChoice() {
+    SearchServer server("the"s, WithOffsets());
+    AddBackground(server);
+    const string text = "fox a b c d e f g h fox dog i j";
+    server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+    // Окно с двумя разными словами запроса лучше окна с одним
+    const auto snippets = server.GetSnippets("fox dog", { 1 }, 3);
+    ASSERT_EQUAL(snippets.size(), 1u);
+    const auto& snippet = snippets[0];
+    ASSERT_EQUAL(snippet.document_id, 1);
+    ASSERT_EQUAL(snippet.text, "fox dog i"s);
+    ASSERT_EQUAL(snippet.offset, text.find("fox dog"));
+    AssertHighlights(snippet, { RangeOf(snippet.text, "fox"), RangeOf(snippet.text, "dog") });
+
+    // Из двух окон с одним словом выбирается слово с большей IDF
+    server.AddDocument(2, "dog k l m n o p q fox r s", DocumentStatus::ACTUAL, { 1 });
+    const auto rare_word = server.GetSnippets("fox dog", { 2 }, 1);
+    ASSERT_EQUAL(rare_word[0].text, "dog"s);
+    AssertHighlights(rare_word[0], { { 0, 3 } });
+}
+
+void TestSnippetCentering() {
+    SearchServer server("the"s, WithOffsets());
+    AddBackground(server);
+    // Стоп-слова занимают позиции и попадают в текст фрагмента, но не подсвечиваются
+    const string text = "a b c the dog the d e f";
+    server.AddDocument(1, text, DocumentStatus::ACTUAL, { 1 });
+    const auto centered = server.GetSnippets("dog", { 1 }, 5);
+    ASSERT_EQUAL(centered[0].text, "c the dog the d"s);
+    ASSERT_EQUAL(centered[0].offset, text.find("c the"));
+    AssertHighlights(centered[0], { RangeOf(centered[0].text, "dog") });
+
+    // У края документа окно сдвигается внутрь, а не обрезается
+    server.AddDocument(2, "dog a b c d e", DocumentStatus::ACTUAL, { 1 });
+    const auto at_start = server.GetSnippets("dog", { 2 }, 3);
+    ASSERT_EQUAL(at_start[0].text, "dog a b"s);
+    server.AddDocument(3, "a b c d e dog", DocumentStatus::ACTUAL, { 1 });
+    const auto at_end = server.GetSnippets("dog", { 3 }, 3);
+    ASSERT_EQUAL(at_end[0].text, "d e dog"s);
+    AssertHighlights(at_end[0], { { 4, 3 } });
+
+    // Окно шире документа — весь документ, с исходными пробелами
+    const string spaced = "dog   a  fox";
+    server.AddDocument(4, spaced, DocumentStatus::ACTUAL, { 1 });
+    const auto whole = server.GetSnippets("fox dog -cat", { 4 }, 20);
+    ASSERT_EQUAL(whole[0].text, spaced);
+    ASSERT_EQUAL(whole[0].offset, 0u);
+    AssertHighlights(whole[0], { RangeOf(spaced, "dog"), RangeOf(spaced, "fox") });
+
+    // Повторы слова в окне подсвечиваются все
+    server.AddDocument(5, "dog dog a dog", DocumentStatus::ACTUAL, { 1 });
+    const auto repeated = server.GetSnippets("dog", { 5 }, 4);
+    AssertHighlights(repeated[0], { { 0, 3 }, { 4, 3 }, { 10, 3 } });
+}
+
+void TestSnippetWithoutHits() {
+    SearchServer server("the"s, WithOffsets());
+    AddBackground(server);
+    server.AddDocument(1, "a the b c d", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(2, "", DocumentStatus::ACTUAL, { 1 });
+    // Слов запроса нет в документе (или во всём индексе) — берётся начало документа без подсветки
+    for (const string query : { "fox", "unknown", "the" }) {
+        const auto snippets = server.GetSnippets(query, { 1, 2 }, 3);
+        ASSERT_EQUAL(snippets.size(), 2u);
+        ASSERT_EQUAL_HINT(snippets[0].text, "a the b"s, query);
+        ASSERT_EQUAL(snippets[0].offset, 0u);
+        ASSERT(snippets[0].highlights.empty());
+        ASSERT_EQUAL(snippets[1].document_id, 2);
+        ASSERT(snippets[1].text.empty());
+        ASSERT(snippets[1].highlights.empty());
+    }
+}
+
+void TestSnippetErrors() {
+    SearchServer server("the"s, WithOffsets());
+    server.AddDocument(1, "fox dog", DocumentStatus::ACTUAL, { 1 });
+    const auto throws = [](auto function) {
+        try {
+            function();
+        }
+        catch (const invalid_argument&) {
+            return "invalid_argument"s;
+        }
+        catch (const out_of_range&) {
+            return "out_of_range"s;
+        }
+        return "nothing"s;
+    };
+    ASSERT_EQUAL(throws([&] { server.GetSnippets("fox", { 1 }, 0); }), "invalid_argument"s);
+    ASSERT_EQUAL(throws([&] { server.GetSnippets("fox", { 2 }); }), "out_of_range"s);
+
+    SearchServer without_offsets("the"s);
+    without_offsets.AddDocument(1, "fox dog", DocumentStatus::ACTUAL, { 1 });
+    ASSERT_EQUAL(throws([&] { without_offsets.GetSnippets("fox", { 1 }); }), "invalid_argument"s);
+}
+
+} // namespace
+
+void TestSearchServer() {
+    RUN_TEST(TestNearTiesRankedAlike);
+    RUN_TEST(TestSnippetWindowChoice);
+    RUN_TEST(TestSnippetCentering);
+    RUN_TEST(TestSnippetWithoutHits);
+    RUN_TEST(TestSnippetErrors);
+}
@@ -0,0 +1,304 @@
+#include "test_shared_index.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <execution>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "scoring.h"
+#include "search_server.h"
+#include "shared_index.h"
+#include "testlib.h"
+
+using namespace std;
+
+namespace {
+
+// Раскладка заголовка повторяет Header из shared_index.cpp: сигнатура, image_size, document_count,
+// total_word_count и секции {offset, size} по 8 байт на поле
+const size_t DOCUMENT_COUNT_FIELD = 16;
+const size_t FIRST_SECTION_FIELD = 32;
+const size_t SECTION_COUNT = 11;
+const size_t TERM_OFFSETS_SECTION = 2;
+const size_t POSTING_DOCUMENTS_SECTION = 5;
+
+const vector<string> QUERIES = {
+    "cat", "dog", "cat dog", "cat -dog", "big -cat", "curly cat -collar", "the cat", "and", "unknown",
+    "cat -unknown", "in the city", "-cat",
+};
+
+void AddDocuments(SearchServer& server) {
+    server.AddDocument(1, "white cat and fashionable collar", DocumentStatus::ACTUAL, { 8, -3 });
+    server.AddDocument(2, "fluffy cat fluffy tail", DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(3, "groomed dog expressive eyes", DocumentStatus::ACTUAL, { 5, -12, 2, 1 });
+    server.AddDocument(4, "groomed starling eugene", DocumentStatus::BANNED, { 9 });
+    server.AddDocument(5, "big dog in the city", DocumentStatus::IRRELEVANT, { 1, 2 });
+    server.AddDocument(6, "curly cat curly tail", DocumentStatus::ACTUAL, { 7, 2, 7 });
+    server.AddDocument(7, "removed cat", DocumentStatus::ACTUAL, { 1 });
+    server.AddDocument(8, "big cat and big dog", DocumentStatus::BANNED, { 4 });
+    server.AddDocument(10, "cat cat cat dog", DocumentStatus::ACTUAL, { -2 });
+    // Номера документов в образе идут подряд, id — с пропусками
+    server.RemoveDocument(7);
+}
+
+void AssertSameResults(const vector<Document>& actual, const vector<Document>& expected, const string& hint) {
+    ASSERT_EQUAL_HINT(actual.size(), expected.size(), hint);
+    for (size_t i = 0; i < expected.size(); ++i) {
+        ASSERT_EQUAL_HINT(actual[i].id, expected[i].id, hint);
+        ASSERT_EQUAL_HINT(actual[i].rating, expected[i].rating, hint);
+        ASSERT_HINT(abs(actual[i].relevance - expected[i].relevance) < ERROR_RATE_RELEVANCE, hint);
+    }
+}
+
+void AssertSameAsServer(const SharedIndex& index, const SearchServer& server) {
+    ASSERT_EQUAL(index.GetDocumentCount(), static_cast<size_t>(server.GetDocumentCount()));
+    for (const string& query : QUERIES) {
+        for (const auto status : { DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT, DocumentStatus::BANNED, DocumentStatus::REMOVED }) {
+            AssertSameResults(index.FindTopDocuments(query, status), server.FindTopDocuments(query, status),
+                query + " status " + to_string(static_cast<int>(status)));
+        }
+        const auto even_rating = [](int, DocumentStatus, int rating) {
+            return rating % 2 == 0;
+        };
+        AssertSameResults(index.FindTopDocuments(query, even_rating), server.FindTopDocuments(query, even_rating), query + " predicate");
+        const auto any_document = [](int, DocumentStatus, int) {
+            return true;
+        };
+        AssertSameResults(index.FindTopDocuments(query, any_document, Bm25Scorer{}),
+            server.FindTopDocuments(execution::seq, query, any_document, Bm25Scorer{}), query + " bm25");
+    }
+}
+
+string ReadImage(const string& path) {
+    ifstream input(path, ios::binary);
+    return string(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+}
+
+void WriteImage(const string& path, const string& image) {
+    ofstream output(path, ios::binary | ios::trunc);
+    output.write(image.data(), static_cast<streamsize>(image.size()));
+    ASSERT(output.good());
+}
+
+uint64_t ReadField(const string& image, size_t offset) {
+    uint64_t value = 0;
+    memcpy(&value, image.data() + offset, sizeof(value));
+    return value;
+}
+
+void WriteField(string& image, size_t offset, uint64_t value) {
+    memcpy(image.data() + offset, &value, sizeof(value));
+}
+
+void AssertRejected(const string& path, const string& image, const string& hint) {
+    WriteImage(path, image);
+    try {
+        SharedIndex index(path);
+        ASSERT_HINT(false, "corrupted image accepted: " + hint);
+    }
+    catch (const invalid_argument&) {
+    }
+}
+
+void TestRoundTrip() {
+    TemporaryDirectory directory;
+    const string path = directory.GetPath("index");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, path);
+
+    const SharedIndex index(path);
+    ASSERT(!index.IsStale(path));
+    AssertSameAsServer(index, server);
+}
+
+void TestEmptyIndex() {
+    TemporaryDirectory directory;
+    const string path = directory.GetPath("index");
+    const SearchServer server(""s);
+    PublishSharedIndex(server, path);
+
+    const SharedIndex index(path);
+    ASSERT_EQUAL(index.GetDocumentCount(), 0u);
+    ASSERT(index.FindTopDocuments("cat").empty());
+}
+
+void TestReaderRefresh() {
+    TemporaryDirectory directory;
+    const string path = directory.GetPath("index");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, path);
+
+    SharedIndexReader reader(path);
+    ASSERT(!reader.Refresh());
+    const auto old_index = reader.Get();
+    const auto old_results = old_index->FindTopDocuments("cat");
+
+    server.AddDocument(20, "black cat", DocumentStatus::ACTUAL, { 3 });
+    server.RemoveDocument(10);
+    PublishSharedIndex(server, path);
+    ASSERT(old_index->IsStale(path));
+    // До Refresh запросы видят прежнюю версию
+    ASSERT_EQUAL(reader.Get(), old_index);
+
+    ASSERT(reader.Refresh());
+    const auto new_index = reader.Get();
+    ASSERT(new_index != old_index);
+    ASSERT(!new_index->IsStale(path));
+    AssertSameAsServer(*new_index, server);
+    ASSERT(!reader.Refresh());
+    ASSERT_EQUAL(reader.Get(), new_index);
+
+    // Взятая раньше версия остаётся отображённой и отвечает как прежде
+    AssertSameResults(old_index->FindTopDocuments("cat"), old_results, "old version");
+}
+
+void TestMissingFile() {
+    TemporaryDirectory directory;
+    try {
+        SharedIndex index(directory.GetPath("missing"));
+        ASSERT_HINT(false, "missing file opened");
+    }
+    catch (const system_error&) {
+    }
+}
+
+void TestTruncatedImage() {
+    TemporaryDirectory directory;
+    const string valid_path = directory.GetPath("index");
+    const string path = directory.GetPath("corrupted");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, valid_path);
+    const string image = ReadImage(valid_path);
+    const size_t header_size = FIRST_SECTION_FIELD + SECTION_COUNT * 16;
+    ASSERT(image.size() > header_size);
+
+    for (const size_t size : { size_t{ 0 }, size_t{ 7 }, header_size - 1, header_size, image.size() / 2, image.size() - 1 }) {
+        AssertRejected(path, image.substr(0, size), "truncated to " + to_string(size));
+    }
+    AssertRejected(path, image + string(8, '\0'), "trailing bytes");
+
+    string bad_magic = image;
+    bad_magic[0] = 'X';
+    AssertRejected(path, bad_magic, "magic");
+}
+
+void TestCorruptedHeader() {
+    TemporaryDirectory directory;
+    const string valid_path = directory.GetPath("index");
+    const string path = directory.GetPath("corrupted");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, valid_path);
+    const string image = ReadImage(valid_path);
+
+    // Старший байт поля выводит смещение или размер секции далеко за образ
+    vector<size_t> fields = { DOCUMENT_COUNT_FIELD };
+    for (size_t field = FIRST_SECTION_FIELD; field < FIRST_SECTION_FIELD + SECTION_COUNT * 16; field += 8) {
+        fields.push_back(field);
+    }
+    for (const size_t field : fields) {
+        string corrupted = image;
+        corrupted[field + 7] = 0x40;
+        AssertRejected(path, corrupted, "header field at " + to_string(field));
+    }
+
+    // Секция, сдвинутая с выравнивания своего типа
+    string misaligned = image;
+    const size_t term_offsets_field = FIRST_SECTION_FIELD + TERM_OFFSETS_SECTION * 16;
+    WriteField(misaligned, term_offsets_field, ReadField(image, term_offsets_field) + 1);
+    AssertRejected(path, misaligned, "misaligned section");
+}
+
+void TestCorruptedSections() {
+    TemporaryDirectory directory;
+    const string valid_path = directory.GetPath("index");
+    const string path = directory.GetPath("corrupted");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, valid_path);
+    const string image = ReadImage(valid_path);
+
+    const size_t term_offsets_field = FIRST_SECTION_FIELD + TERM_OFFSETS_SECTION * 16;
+    const uint64_t term_offsets = ReadField(image, term_offsets_field);
+    const uint64_t term_offset_count = ReadField(image, term_offsets_field + 8);
+    ASSERT(term_offset_count > 2);
+    {
+        string corrupted = image;
+        const size_t last = term_offsets + (term_offset_count - 1) * 8;
+        WriteField(corrupted, last, ReadField(image, last) + 1);
+        AssertRejected(path, corrupted, "term data end");
+    }
+    {
+        string corrupted = image;
+        WriteField(corrupted, term_offsets + 8, ~uint64_t{ 0 });
+        AssertRejected(path, corrupted, "decreasing term offsets");
+    }
+    {
+        string corrupted = image;
+        WriteField(corrupted, term_offsets, 1);
+        AssertRejected(path, corrupted, "first term offset");
+    }
+
+    const size_t posting_documents_field = FIRST_SECTION_FIELD + POSTING_DOCUMENTS_SECTION * 16;
+    const uint64_t posting_documents = ReadField(image, posting_documents_field);
+    {
+        string corrupted = image;
+        const uint32_t document = static_cast<uint32_t>(ReadField(image, DOCUMENT_COUNT_FIELD));
+        memcpy(corrupted.data() + posting_documents, &document, sizeof(document));
+        AssertRejected(path, corrupted, "posting document out of range");
+    }
+}
+
+// Повреждение любого байта образа либо отвергается, либо даёт индекс, который отвечает на запросы
+// без чтения за пределами образа (это ловит сборка с санитайзерами)
+void TestRandomCorruption() {
+    TemporaryDirectory directory;
+    const string valid_path = directory.GetPath("index");
+    const string path = directory.GetPath("corrupted");
+    SearchServer server("and in on the"s);
+    AddDocuments(server);
+    PublishSharedIndex(server, valid_path);
+    const string image = ReadImage(valid_path);
+
+    mt19937 generator(42);
+    uniform_int_distribution<size_t> position(0, image.size() - 1);
+    uniform_int_distribution<int> byte(0, 255);
+    for (int i = 0; i < 1000; ++i) {
+        string corrupted = image;
+        corrupted[position(generator)] = static_cast<char>(byte(generator));
+        WriteImage(path, corrupted);
+        try {
+            const SharedIndex index(path);
+            for (const string& query : QUERIES) {
+                index.FindTopDocuments(query, [](int, DocumentStatus, int) {
+                    return true;
+                    });
+            }
+        }
+        catch (const invalid_argument&) {
+        }
+    }
+}
+
+}  // namespace
+
+void TestSharedIndex() {
+    RUN_TEST(TestRoundTrip);
+    RUN_TEST(TestEmptyIndex);
+    RUN_TEST(TestReaderRefresh);
+    RUN_TEST(TestMissingFile);
+    RUN_TEST(TestTruncatedImage);
+    RUN_TEST(TestCorruptedHeader);
+    RUN_TEST(TestCorruptedSections);
+    RUN_TEST(TestRandomCorruption);
+}
@@ -0,0 +1,240 @@
+#include "test_write_ahead_log.h"
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "testlib.h"
+#include "write_ahead_log.h"
+
+using namespace std;
+
+namespace {
+
+// Документы сервера построчно: id, статус, рейтинг и текст
+vector<string> DescribeDocuments(const SearchServer& server) {
+    vector<string> documents;
+    for (const int document_id : server) {
+        const auto document = server.GetDocument(document_id);
+        documents.push_back(to_string(document_id) + ' ' + to_string(static_cast<int>(document.status)) + ' '
+            + to_string(document.rating) + ' ' + document.text);
+    }
+    return documents;
+}
+
+// Изменения идут в журнал и в эталонный сервер, как у пишущего потока
+class LoggedServer {
+public:
+    LoggedServer(WriteAheadLog& log, SearchServer& server)
+        : log_(log)
+        , server_(server) {
+    }
+
+    uint64_t Add(int document_id, const string& text, DocumentStatus status = DocumentStatus::ACTUAL, vector<int> ratings = { 1 }) {
+        const uint64_t sequence = log_.AppendAddDocument(document_id, text, status, ratings);
+        try {
+            server_.AddDocument(document_id, text, status, ratings);
+        }
+        catch (const invalid_argument&) {
+        }
+        log_.Commit(sequence);
+        return sequence;
+    }
+
+    uint64_t Remove(int document_id) {
+        const uint64_t sequence = log_.AppendRemoveDocument(document_id);
+        server_.RemoveDocument(document_id);
+        log_.Commit(sequence);
+        return sequence;
+    }
+
+private:
+    WriteAheadLog& log_;
+    SearchServer& server_;
+};
+
+void TestRecoveryFromSnapshotAndLog() {
+    TemporaryDirectory directory;
+    const string log_path = directory.GetPath("wal");
+    const string snapshot_path = directory.GetPath("snapshot");
+    SearchServer expected("and"s);
+    {
+        WriteAheadLog log(log_path);
+        LoggedServer server(log, expected);
+        server.Add(1, "white cat and collar", DocumentStatus::ACTUAL, { 8, -3 });
+        server.Add(2, "fluffy cat fluffy tail");
+        server.Add(3, "groomed dog expressive eyes", DocumentStatus::BANNED, { 5 });
+        server.Add(4, "groomed starling", DocumentStatus::IRRELEVANT, { 9 });
+        server.Remove(2);
+        log.Checkpoint(expected, snapshot_path);
+
+        server.Add(5, "white dog", DocumentStatus::ACTUAL, { 2, 4 });
+        server.Add(6, "bad\x01word");
+        server.Remove(3);
+        ASSERT_EQUAL(server.Remove(42), 9u);
+    }
+
+    SearchServer recovered("and"s);
+    const RecoveryStats stats = RecoverSearchServer(recovered, log_path, snapshot_path);
+    ASSERT_EQUAL(stats.snapshot_sequence, 5u);
+    ASSERT_EQUAL(stats.snapshot_documents, 3u);
+    ASSERT_EQUAL(stats.last_sequence, 9u);
+    ASSERT_EQUAL(stats.replayed_records, 4u);
+    ASSERT_EQUAL(stats.rejected_records, 1u);
+    ASSERT(!stats.truncated_tail);
+    ASSERT(DescribeDocuments(recovered) == DescribeDocuments(expected));
+
+    WriteAheadLog log(log_path);
+    ASSERT_EQUAL(log.GetLastSequence(), 9u);
+    ASSERT_EQUAL(log.AppendRemoveDocument(1), 10u);
+}
+
+void TestRecoveryFromTruncatedTail() {
+    TemporaryDirectory directory;
+    const string log_path = directory.GetPath("wal");
+    SearchServer expected(""s);
+    uintmax_t valid_size = 0;
+    {
+        WriteAheadLog log(log_path);
+        LoggedServer server(log, expected);
+        for (int document_id = 1; document_id <= 4; ++document_id) {
+            server.Add(document_id, "document number " + to_string(document_id));
+        }
+        valid_size = filesystem::file_size(log_path);
+        SearchServer lost(""s);
+        LoggedServer(log, lost).Add(5, "document that is cut in the middle");
+    }
+    // Падение посреди записи последнего документа
+    filesystem::resize_file(log_path, valid_size + 7);
+
+    SearchServer recovered(""s);
+    RecoveryStats stats = RecoverSearchServer(recovered, log_path);
+    ASSERT_EQUAL(stats.last_sequence, 4u);
+    ASSERT(stats.truncated_tail);
+    ASSERT(DescribeDocuments(recovered) == DescribeDocuments(expected));
+
+    {
+        // Открытие журнала отрезает оборванную запись, нумерация продолжается за последней целой
+        WriteAheadLog log(log_path);
+        ASSERT_EQUAL(filesystem::file_size(log_path), valid_size);
+        ASSERT_EQUAL(log.GetLastSequence(), 4u);
+        ASSERT_EQUAL(LoggedServer(log, expected).Add(6, "written after recovery"), 5u);
+    }
+    SearchServer recovered_again(""s);
+    stats = RecoverSearchServer(recovered_again, log_path);
+    ASSERT_EQUAL(stats.last_sequence, 5u);
+    ASSERT(!stats.truncated_tail);
+    ASSERT(DescribeDocuments(recovered_again) == DescribeDocuments(expected));
+}
+
+void TestRecoveryFromTornRecord() {
+    TemporaryDirectory directory;
+    const string log_path = directory.GetPath("wal");
+    SearchServer expected(""s);
+    uintmax_t valid_size = 0;
+    uintmax_t torn_size = 0;
+    {
+        WriteAheadLog log(log_path);
+        LoggedServer server(log, expected);
+        server.Add(1, "first document");
+        server.Add(2, "second document");
+        valid_size = filesystem::file_size(log_path);
+        SearchServer lost(""s);
+        LoggedServer lost_server(log, lost);
+        lost_server.Add(3, "third document with a damaged byte");
+        torn_size = filesystem::file_size(log_path);
+        lost_server.Add(4, "fourth document after the damage");
+    }
+    {
+        // Портим байт в теле третьей записи: CRC не сойдётся, и всё после неё отбрасывается
+        fstream file(log_path, ios::in | ios::out | ios::binary);
+        const auto offset = static_cast<streamoff>((valid_size + torn_size) / 2);
+        file.seekg(offset);
+        const char byte = static_cast<char>(file.get() ^ 0x5a);
+        file.seekp(offset);
+        file.put(byte);
+    }
+
+    SearchServer recovered(""s);
+    const RecoveryStats stats = RecoverSearchServer(recovered, log_path);
+    ASSERT_EQUAL(stats.last_sequence, 2u);
+    ASSERT_EQUAL(stats.replayed_records, 2u);
+    ASSERT(stats.truncated_tail);
+    ASSERT(DescribeDocuments(recovered) == DescribeDocuments(expected));
+
+    WriteAheadLog log(log_path);
+    ASSERT_EQUAL(filesystem::file_size(log_path), valid_size);
+    ASSERT_EQUAL(log.GetLastSequence(), 2u);
+}
+
+template <typename Operation>
+bool ThrowsSystemError(Operation operation) {
+    try {
+        operation();
+    }
+    catch (const system_error&) {
+        return true;
+    }
+    return false;
+}
+
+void TestFailedWrite() {
+    TemporaryDirectory directory;
+    const string log_path = directory.GetPath("wal");
+    SearchServer expected(""s);
+    {
+        WriteAheadLog log(log_path, { FsyncPolicy::NEVER });
+        LoggedServer server(log, expected);
+        for (int document_id = 1; document_id <= 3; ++document_id) {
+            server.Add(document_id, "committed document " + to_string(document_id));
+        }
+
+        // Предел размера файла: write() пачки обрывается на середине с EFBIG
+        const auto old_handler = signal(SIGXFSZ, SIG_IGN);
+        rlimit old_limit{};
+        getrlimit(RLIMIT_FSIZE, &old_limit);
+        rlimit limit = old_limit;
+        limit.rlim_cur = filesystem::file_size(log_path) + 40;
+        setrlimit(RLIMIT_FSIZE, &limit);
+
+        uint64_t last_sequence = 0;
+        for (int document_id = 4; document_id <= 6; ++document_id) {
+            last_sequence = log.AppendAddDocument(document_id, "document that never reaches the disk", DocumentStatus::ACTUAL, { 1 });
+        }
+        const bool commit_failed = ThrowsSystemError([&] { log.Commit(last_sequence); });
+        setrlimit(RLIMIT_FSIZE, &old_limit);
+        signal(SIGXFSZ, old_handler);
+        ASSERT(commit_failed);
+
+        // Журнал остаётся сломанным и после того, как запись снова возможна
+        ASSERT(ThrowsSystemError([&] { log.Commit(last_sequence); }));
+        ASSERT(ThrowsSystemError([&] { log.AppendRemoveDocument(1); }));
+        ASSERT(ThrowsSystemError([&] { log.Sync(); }));
+        ASSERT(ThrowsSystemError([&] { log.Checkpoint(expected, directory.GetPath("snapshot")); }));
+    }
+
+    SearchServer recovered(""s);
+    const RecoveryStats stats = RecoverSearchServer(recovered, log_path);
+    ASSERT_EQUAL(stats.last_sequence, 3u);
+    ASSERT(stats.truncated_tail);
+    ASSERT(DescribeDocuments(recovered) == DescribeDocuments(expected));
+
+    WriteAheadLog log(log_path);
+    ASSERT_EQUAL(log.GetLastSequence(), 3u);
+    ASSERT_EQUAL(LoggedServer(log, expected).Remove(2), 4u);
+}
+
+} // namespace
+
+void TestWriteAheadLog() {
+    RUN_TEST(TestRecoveryFromSnapshotAndLog);
+    RUN_TEST(TestRecoveryFromTruncatedTail);
+    RUN_TEST(TestRecoveryFromTornRecord);
+    RUN_TEST(TestFailedWrite);
+}
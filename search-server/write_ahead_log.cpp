@@ -0,0 +1,547 @@
+#include "write_ahead_log.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <execution>
+#include <optional>
+#include <stdexcept>
+#include <system_error>
+
+using namespace std;
+
+namespace {
+
+const char LOG_MAGIC[8] = { 'S', 'S', 'W', 'A', 'L', '0', '0', '1' };
+const char SNAPSHOT_MAGIC[8] = { 'S', 'S', 'S', 'N', 'A', 'P', '0', '1' };
+const size_t FILE_HEADER_SIZE = sizeof(LOG_MAGIC) + sizeof(uint64_t);
+const size_t RECORD_HEADER_SIZE = 2 * sizeof(uint32_t);
+// Защита от мусора в поле длины повреждённой записи
+const uint32_t MAX_RECORD_SIZE = 1u << 30;
+
+enum class RecordType : uint8_t {
+    ADD = 1,
+    REMOVE = 2,
+};
+
+struct LogRecord {
+    uint64_t sequence = 0;
+    RecordType type = RecordType::ADD;
+    int document_id = 0;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    vector<int> ratings;
+    string text;
+};
+
+array<uint32_t, 256> MakeCrcTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t value = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            value = (value & 1) ? (value >> 1) ^ 0xEDB88320u : value >> 1;
+        }
+        table[i] = value;
+    }
+    return table;
+}
+
+uint32_t ComputeCrc32(string_view data) {
+    static const array<uint32_t, 256> table = MakeCrcTable();
+    uint32_t crc = 0xFFFFFFFFu;
+    for (const char c : data) {
+        crc = table[(crc ^ static_cast<uint8_t>(c)) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// Числа пишутся в порядке байт машины: журнал не переносится между архитектурами
+template <typename T>
+void Put(string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+bool Get(string_view& data, T& value) {
+    if (data.size() < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, data.data(), sizeof(value));
+    data.remove_prefix(sizeof(value));
+    return true;
+}
+
+string MakeFileHeader(const char (&magic)[8], uint64_t base_sequence) {
+    string header(magic, sizeof(magic));
+    Put(header, base_sequence);
+    return header;
+}
+
+// Дописывает запись: длина и CRC32 тела, затем само тело
+template <typename BodyWriter>
+void AppendRecord(string& out, uint64_t sequence, RecordType type, int document_id, BodyWriter write_body) {
+    const size_t header_offset = out.size();
+    out.resize(out.size() + RECORD_HEADER_SIZE);
+    const size_t body_offset = out.size();
+    Put(out, sequence);
+    Put(out, static_cast<uint8_t>(type));
+    Put(out, static_cast<int32_t>(document_id));
+    write_body(out);
+    const auto size = static_cast<uint32_t>(out.size() - body_offset);
+    const uint32_t crc = ComputeCrc32(string_view(out).substr(body_offset));
+    memcpy(&out[header_offset], &size, sizeof(size));
+    memcpy(&out[header_offset + sizeof(size)], &crc, sizeof(crc));
+}
+
+void AppendAddRecord(string& out, uint64_t sequence, int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    AppendRecord(out, sequence, RecordType::ADD, document_id, [&](string& body) {
+        Put(body, static_cast<uint8_t>(status));
+        Put(body, static_cast<uint32_t>(ratings.size()));
+        for (const int rating : ratings) {
+            Put(body, static_cast<int32_t>(rating));
+        }
+        Put(body, static_cast<uint32_t>(document.size()));
+        body.append(document);
+    });
+}
+
+bool ParseRecord(string_view body, LogRecord& record) {
+    uint8_t type = 0;
+    int32_t document_id = 0;
+    if (!Get(body, record.sequence) || !Get(body, type) || !Get(body, document_id)) {
+        return false;
+    }
+    record.document_id = document_id;
+    if (type == static_cast<uint8_t>(RecordType::REMOVE)) {
+        record.type = RecordType::REMOVE;
+        return body.empty();
+    }
+    if (type != static_cast<uint8_t>(RecordType::ADD)) {
+        return false;
+    }
+    record.type = RecordType::ADD;
+    uint8_t status = 0;
+    uint32_t rating_count = 0;
+    if (!Get(body, status) || status > static_cast<uint8_t>(DocumentStatus::REMOVED) || !Get(body, rating_count)
+        || rating_count > body.size() / sizeof(int32_t)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(rating_count);
+    for (int& rating : record.ratings) {
+        int32_t value = 0;
+        Get(body, value);
+        rating = value;
+    }
+    uint32_t text_size = 0;
+    if (!Get(body, text_size) || text_size != body.size()) {
+        return false;
+    }
+    record.text.assign(body);
+    return true;
+}
+
+void WriteAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const ssize_t count = write(fd, data, size);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw system_error(errno, generic_category(), "Write failed");
+        }
+        data += count;
+        size -= count;
+    }
+}
+
+void SyncFile(int fd) {
+    if (fdatasync(fd) != 0) {
+        throw system_error(errno, generic_category(), "fdatasync failed");
+    }
+}
+
+// После rename нужно синхронизировать каталог, иначе переименование может потеряться
+void SyncParentDirectory(const string& path) {
+    const size_t slash = path.rfind('/');
+    const string directory = slash == string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    const int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Cannot open " + directory);
+    }
+    fsync(fd);
+    close(fd);
+}
+
+// Последовательное чтение записей крупными блоками. Останавливается на первой
+// недописанной или повреждённой записи
+class RecordReader {
+public:
+    RecordReader(const string& path, const char (&magic)[8]) {
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            if (errno == ENOENT) {
+                return;
+            }
+            throw system_error(errno, generic_category(), "Cannot open " + path);
+        }
+        posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+        if (!Fill(FILE_HEADER_SIZE)) {
+            // Пустой файл — как отсутствующий
+            if (end_ != 0) {
+                close(fd_);
+                throw runtime_error("Truncated header in " + path);
+            }
+            return;
+        }
+        if (memcmp(buffer_.data(), magic, sizeof(magic)) != 0) {
+            close(fd_);
+            throw runtime_error("Unexpected file format: " + path);
+        }
+        memcpy(&base_sequence_, buffer_.data() + sizeof(magic), sizeof(base_sequence_));
+        begin_ = FILE_HEADER_SIZE;
+        valid_size_ = FILE_HEADER_SIZE;
+    }
+
+    RecordReader(const RecordReader&) = delete;
+    RecordReader& operator=(const RecordReader&) = delete;
+
+    ~RecordReader() {
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    bool Exists() const {
+        return valid_size_ > 0;
+    }
+
+    uint64_t GetBaseSequence() const {
+        return base_sequence_;
+    }
+
+    // Смещение сразу за последней целой записью
+    uint64_t GetValidSize() const {
+        return valid_size_;
+    }
+
+    bool IsCorrupted() const {
+        return corrupted_;
+    }
+
+    bool Next(LogRecord& record) {
+        if (!Exists() || corrupted_) {
+            return false;
+        }
+        if (!Fill(RECORD_HEADER_SIZE)) {
+            corrupted_ = end_ > begin_;
+            return false;
+        }
+        uint32_t size = 0;
+        uint32_t crc = 0;
+        memcpy(&size, buffer_.data() + begin_, sizeof(size));
+        memcpy(&crc, buffer_.data() + begin_ + sizeof(size), sizeof(crc));
+        if (size > MAX_RECORD_SIZE || !Fill(RECORD_HEADER_SIZE + size)) {
+            corrupted_ = true;
+            return false;
+        }
+        const string_view body(buffer_.data() + begin_ + RECORD_HEADER_SIZE, size);
+        if (ComputeCrc32(body) != crc || !ParseRecord(body, record)) {
+            corrupted_ = true;
+            return false;
+        }
+        begin_ += RECORD_HEADER_SIZE + size;
+        valid_size_ += RECORD_HEADER_SIZE + size;
+        return true;
+    }
+
+private:
+    static constexpr size_t CHUNK_SIZE = 1 << 20;
+
+    // Дочитывает файл, пока в буфере не окажется size непрочитанных байт
+    bool Fill(size_t size) {
+        if (end_ - begin_ >= size) {
+            return true;
+        }
+        if (fd_ < 0) {
+            return false;
+        }
+        buffer_.erase(buffer_.begin(), buffer_.begin() + begin_);
+        end_ -= begin_;
+        begin_ = 0;
+        while (end_ < size) {
+            buffer_.resize(max(end_ + CHUNK_SIZE, size));
+            const ssize_t count = read(fd_, buffer_.data() + end_, buffer_.size() - end_);
+            if (count < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw system_error(errno, generic_category(), "Read failed");
+            }
+            if (count == 0) {
+                break;
+            }
+            end_ += count;
+        }
+        buffer_.resize(end_);
+        return end_ >= size;
+    }
+
+    int fd_ = -1;
+    vector<char> buffer_;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    uint64_t base_sequence_ = 0;
+    uint64_t valid_size_ = 0;
+    bool corrupted_ = false;
+};
+
+// Применяет пачку по порядку; документы разбираются параллельно заранее
+void ApplyBatch(SearchServer& search_server, vector<LogRecord>& batch, RecoveryStats& stats) {
+    vector<optional<SearchServer::PreparedDocument>> prepared(batch.size());
+    transform(execution::par, batch.begin(), batch.end(), prepared.begin(), [&search_server](LogRecord& record)
+        -> optional<SearchServer::PreparedDocument> {
+        if (record.type != RecordType::ADD) {
+            return nullopt;
+        }
+        try {
+            return search_server.PrepareDocument(record.document_id, move(record.text), record.status, record.ratings);
+        }
+        catch (const invalid_argument&) {
+            return nullopt;
+        }
+    });
+    for (size_t i = 0; i < batch.size(); ++i) {
+        ++stats.replayed_records;
+        if (batch[i].type == RecordType::REMOVE) {
+            search_server.RemoveDocument(batch[i].document_id);
+            continue;
+        }
+        if (!prepared[i]) {
+            ++stats.rejected_records;
+            continue;
+        }
+        try {
+            search_server.AddPreparedDocument(move(*prepared[i]));
+        }
+        catch (const invalid_argument&) {
+            ++stats.rejected_records;
+        }
+    }
+    batch.clear();
+}
+
+} // namespace
+
+void ReplaceFile(const string& path, const string& content) {
+    const string temporary_path = path + ".tmp";
+    const int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw system_error(errno, generic_category(), "Cannot create " + temporary_path);
+    }
+    try {
+        WriteAll(fd, content.data(), content.size());
+        SyncFile(fd);
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+    close(fd);
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw system_error(errno, generic_category(), "Cannot rename " + temporary_path);
+    }
+    SyncParentDirectory(path);
+}
+
+WriteAheadLog::WriteAheadLog(const string& path, const WriteAheadLogOptions& options)
+    : path_(path)
+    , options_(options) {
+    uint64_t valid_size = 0;
+    {
+        RecordReader reader(path_, LOG_MAGIC);
+        if (reader.Exists()) {
+            last_sequence_ = reader.GetBaseSequence();
+            LogRecord record;
+            while (reader.Next(record)) {
+                last_sequence_ = record.sequence;
+            }
+            valid_size = reader.GetValidSize();
+        }
+    }
+    if (valid_size == 0) {
+        ReplaceFile(path_, MakeFileHeader(LOG_MAGIC, 0));
+        valid_size = FILE_HEADER_SIZE;
+    }
+    committed_sequence_ = last_sequence_;
+    Open();
+    if (ftruncate(fd_, static_cast<off_t>(valid_size)) != 0) {
+        close(fd_);
+        throw system_error(errno, generic_category(), "Cannot truncate " + path_);
+    }
+    last_sync_ = chrono::steady_clock::now();
+}
+
+WriteAheadLog::~WriteAheadLog() {
+    try {
+        Sync();
+    }
+    catch (...) {
+    }
+    close(fd_);
+}
+
+void WriteAheadLog::Open() {
+    fd_ = open(path_.c_str(), O_WRONLY | O_APPEND);
+    if (fd_ < 0) {
+        throw system_error(errno, generic_category(), "Cannot open " + path_);
+    }
+}
+
+uint64_t WriteAheadLog::AppendAddDocument(int document_id, string_view document, DocumentStatus status, const vector<int>& ratings) {
+    lock_guard lock(mutex_);
+    ThrowIfFailed();
+    AppendAddRecord(pending_, ++last_sequence_, document_id, document, status, ratings);
+    return last_sequence_;
+}
+
+uint64_t WriteAheadLog::AppendRemoveDocument(int document_id) {
+    lock_guard lock(mutex_);
+    ThrowIfFailed();
+    AppendRecord(pending_, ++last_sequence_, RecordType::REMOVE, document_id, [](string&) {});
+    return last_sequence_;
+}
+
+void WriteAheadLog::Commit(uint64_t sequence) {
+    unique_lock lock(mutex_);
+    ThrowIfFailed();
+    while (committed_sequence_ < sequence) {
+        if (flushing_) {
+            flushed_.wait(lock);
+            // Пачку с этой записью мог писать другой поток, и запись не удалась
+            ThrowIfFailed();
+            continue;
+        }
+        WriteBatch(lock, false);
+    }
+}
+
+void WriteAheadLog::Sync() {
+    unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] { return !flushing_; });
+    ThrowIfFailed();
+    WriteBatch(lock, true);
+}
+
+void WriteAheadLog::ThrowIfFailed() const {
+    if (failure_) {
+        rethrow_exception(failure_);
+    }
+}
+
+uint64_t WriteAheadLog::GetLastSequence() const {
+    lock_guard lock(mutex_);
+    return last_sequence_;
+}
+
+// Становится ведущим: пишет всё накопленное вне блокировки и будит ожидающих
+void WriteAheadLog::WriteBatch(unique_lock<mutex>& lock, bool force_sync) {
+    flushing_ = true;
+    string batch;
+    batch.swap(pending_);
+    const uint64_t batch_sequence = last_sequence_;
+    lock.unlock();
+    try {
+        WriteAll(fd_, batch.data(), batch.size());
+        const auto now = chrono::steady_clock::now();
+        if (force_sync || options_.fsync_policy == FsyncPolicy::EVERY_COMMIT
+            || (options_.fsync_policy == FsyncPolicy::INTERVAL && now - last_sync_ >= options_.fsync_interval)) {
+            SyncFile(fd_);
+            last_sync_ = now;
+        }
+    }
+    catch (...) {
+        // committed_sequence_ не сдвигается: записи пачки не считаются сохранёнными
+        lock.lock();
+        flushing_ = false;
+        failure_ = current_exception();
+        flushed_.notify_all();
+        throw;
+    }
+    lock.lock();
+    flushing_ = false;
+    committed_sequence_ = batch_sequence;
+    flushed_.notify_all();
+}
+
+void WriteAheadLog::Checkpoint(const SearchServer& server, const string& snapshot_path) {
+    unique_lock lock(mutex_);
+    flushed_.wait(lock, [this] { return !flushing_; });
+    ThrowIfFailed();
+    const uint64_t sequence = last_sequence_;
+
+    string snapshot = MakeFileHeader(SNAPSHOT_MAGIC, sequence);
+    for (const int document_id : server) {
+        const auto document = server.GetDocument(document_id);
+        AppendAddRecord(snapshot, sequence, document_id, document.text, document.status, { document.rating });
+    }
+    ReplaceFile(snapshot_path, snapshot);
+
+    // Если упасть до замены журнала, записи до sequence при восстановлении пропустятся
+    ReplaceFile(path_, MakeFileHeader(LOG_MAGIC, sequence));
+    close(fd_);
+    Open();
+    pending_.clear();
+    committed_sequence_ = sequence;
+    last_sync_ = chrono::steady_clock::now();
+    flushed_.notify_all();
+}
+
+RecoveryStats RecoverSearchServer(SearchServer& search_server, const string& log_path, const string& snapshot_path, const RecoveryOptions& options) {
+    if (options.batch_size == 0) {
+        throw invalid_argument("Invalid recovery options");
+    }
+    RecoveryStats stats;
+    vector<LogRecord> batch;
+    batch.reserve(options.batch_size);
+    LogRecord record;
+
+    if (!snapshot_path.empty()) {
+        RecordReader reader(snapshot_path, SNAPSHOT_MAGIC);
+        stats.snapshot_sequence = reader.GetBaseSequence();
+        while (reader.Next(record)) {
+            batch.push_back(move(record));
+            if (batch.size() == options.batch_size) {
+                ApplyBatch(search_server, batch, stats);
+            }
+        }
+        // Снимок пишется целиком и переименовывается, поэтому повреждение — не обрыв записи
+        if (reader.IsCorrupted()) {
+            throw runtime_error("Corrupted snapshot " + snapshot_path);
+        }
+        ApplyBatch(search_server, batch, stats);
+        stats.snapshot_documents = stats.replayed_records - stats.rejected_records;
+        stats.replayed_records = 0;
+        stats.rejected_records = 0;
+    }
+
+    stats.last_sequence = stats.snapshot_sequence;
+    RecordReader reader(log_path, LOG_MAGIC);
+    while (reader.Next(record)) {
+        if (record.sequence <= stats.snapshot_sequence) {
+            continue;
+        }
+        stats.last_sequence = record.sequence;
+        batch.push_back(move(record));
+        if (batch.size() == options.batch_size) {
+            ApplyBatch(search_server, batch, stats);
+        }
+    }
+    ApplyBatch(search_server, batch, stats);
+    stats.truncated_tail = reader.IsCorrupted();
+    return stats;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "search_server.h"
+
+// Журнал изменений индекса. Файл начинается с заголовка (сигнатура и номер, с которого
+// продолжается нумерация), за ним идут записи: длина, CRC32 и тело с порядковым номером.
+// Снимок индекса хранится в том же формате, но содержит только добавления
+enum class FsyncPolicy {
+    // Только write(): записи переживают падение процесса, но не ОС
+    NEVER,
+    // fdatasync не чаще раза в fsync_interval
+    INTERVAL,
+    // Каждая группа записей синхронизируется до возврата из Commit
+    EVERY_COMMIT,
+};
+
+struct WriteAheadLogOptions {
+    FsyncPolicy fsync_policy = FsyncPolicy::EVERY_COMMIT;
+    std::chrono::milliseconds fsync_interval{ 100 };
+};
+
+// Append* только кладёт запись в буфер и возвращает её номер. Commit(номер) ждёт, пока запись
+// окажется на диске: первый пришедший поток пишет и синхронизирует сразу всё накопленное,
+// остальные ждут его — так параллельные писатели делят одну синхронизацию (group commit).
+// Порядок записей должен совпадать с порядком изменений сервера, поэтому Append и изменение
+// делаются под одной блокировкой писателя, а Commit — уже вне её.
+// Первая ошибка записи или синхронизации переводит журнал в сломанное состояние: неизвестно, какая
+// часть пачки дошла до диска, и в файле может остаться оборванная запись. Эту ошибку получают все
+// ждущие Commit и все последующие Append*, Commit, Sync и Checkpoint; журнал нужно открыть заново
+// и восстановить сервер по нему
+class WriteAheadLog {
+public:
+    // Открывает журнал или создаёт пустой; недописанный хвост после сбоя отрезается
+    explicit WriteAheadLog(const std::string& path, const WriteAheadLogOptions& options = {});
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    ~WriteAheadLog();
+
+    uint64_t AppendAddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+    uint64_t AppendRemoveDocument(int document_id);
+
+    void Commit(uint64_t sequence);
+    // Записывает всё накопленное и синхронизирует независимо от политики
+    void Sync();
+
+    uint64_t GetLastSequence() const;
+
+    // Атомарно сохраняет снимок сервера по всем записям журнала и начинает журнал заново.
+    // Вызывается под блокировкой писателя, когда server соответствует GetLastSequence()
+    void Checkpoint(const SearchServer& server, const std::string& snapshot_path);
+
+private:
+    void Open();
+    void WriteBatch(std::unique_lock<std::mutex>& lock, bool force_sync);
+    // Бросает ошибку, сломавшую журнал; вызывается под mutex_
+    void ThrowIfFailed() const;
+
+    const std::string path_;
+    const WriteAheadLogOptions options_;
+    int fd_ = -1;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flushed_;
+    std::string pending_;
+    uint64_t last_sequence_ = 0;
+    uint64_t committed_sequence_ = 0;
+    bool flushing_ = false;
+    std::exception_ptr failure_;
+    std::chrono::steady_clock::time_point last_sync_;
+};
+
+struct RecoveryOptions {
+    // Документы пачки разбираются параллельно, затем применяются по порядку
+    size_t batch_size = 4096;
+};
+
+struct RecoveryStats {
+    uint64_t snapshot_sequence = 0;
+    uint64_t last_sequence = 0;
+    size_t snapshot_documents = 0;
+    size_t replayed_records = 0;
+    // Записи, которые сервер отверг и при исходном выполнении
+    size_t rejected_records = 0;
+    // Журнал обрывается недописанной или повреждённой записью
+    bool truncated_tail = false;
+};
+
+// Восстанавливает server (обычно пустой) из снимка, если он есть, и из записей журнала после него.
+// Отсутствующие файлы считаются пустыми
+RecoveryStats RecoverSearchServer(SearchServer& server, const std::string& log_path, const std::string& snapshot_path = {},
+    const RecoveryOptions& options = {});
+
+// Пишет content во временный файл рядом с path, синхронизирует и переименовывает поверх path:
+// читатели видят либо старый файл, либо новый целиком
+void ReplaceFile(const std::string& path, const std::string& content);